@@ -0,0 +1,539 @@
+/**
+ * @file steps.cpp
+ * @author Alex Laing (livingearthcompany@gmail.com)
+ * @brief bench_steps: an end-to-end scaling benchmark of the simulation step,
+ * and a regression gate against a stored baseline.
+ *
+ * Each run loads the scenario, builds a World, and then steps a synthetic
+ * energy balance model on a lats x lons grid with its own Tasker:
+ * 1. forcing: the insolation from all of the World's stars, and a field of
+ * Philox noise;
+ * 2. physics: the temperature update, a task per band of rows;
+ * 3. diagnostics: the zonal mean, by conservative regridding; and
+ * 4. statistics: FieldStats of the temperature.
+ * Runs sweep the grid sizes and worker counts of the scenario's [bench]
+ * section, and are reported as JSON: throughput, strong and weak scaling
+ * efficiency, peak RSS and the time spent in each phase.
+ *
+ * Usage:
+ *   bench_steps SCENARIO [--out FILE] [--baseline FILE]
+ *               [--write-baseline FILE] [--threshold FRACTION]
+ *
+ * With --baseline, exits 1 if any run's throughput is more than threshold
+ * below the baseline's for the same lats and workers, and 2 if the baseline
+ * was measured with other lons.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <circular/config_map.hpp>
+#include <circular/field_stats.hpp>
+#include <circular/tasker.hpp>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <optional>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../src/stat/insolation.hpp"
+#include "../src/stat/philox.hpp"
+#include "../src/stat/regrid.hpp"
+#include "../src/stat/world.hpp"
+
+using namespace circular;
+
+namespace {
+using Clock = std::chrono::steady_clock;
+
+constexpr char BenchSection[] = "bench";
+
+/// @brief The sweep, and the model's few constants, from [bench].
+struct BenchOptions {
+  std::vector<int> lats{45, 90};
+  int lons = 180;
+  std::vector<int> workers{1, 2};
+  int steps = 24;
+  int warmupSteps = 1;
+  int repeats = 1;
+  int grain = 16;             // rows per task
+  double timeStep = 1800.0;   // [s]
+  double axialTilt = 0.4091;  // [rad]
+  double heatCapacity = 1e7;  // of the surface layer [J / m^2 K]
+  double noiseAmplitude = 5.; // [W / m^2]
+  int seed = 1;
+  double threshold = 0.1; // the fraction of throughput which may be lost
+};
+
+/// @brief Wall-clock seconds spent in each phase of a run.
+struct PhaseTimes {
+  double config = 0.0;
+  double world = 0.0;
+  double setup = 0.0;
+  double forcing = 0.0;
+  double physics = 0.0;
+  double diagnostics = 0.0;
+  double statistics = 0.0;
+};
+
+struct RunResult {
+  int lats = 0;
+  int lons = 0;
+  int workers = 0;
+  int steps = 0;
+  double seconds = 0.0;    // of the timed steps
+  double throughput = 0.0; // [cell-steps / s]
+  double strongEfficiency = std::numeric_limits<double>::quiet_NaN();
+  double weakEfficiency = std::numeric_limits<double>::quiet_NaN();
+  long peakRssKb = -1;
+  double meanTemperature = 0.0;
+  PhaseTimes phases{};
+
+  size_t cells() const { return static_cast<size_t>(lats) * lons; }
+  std::string key() const {
+    return "lats_" + std::to_string(lats) + "_workers_" +
+           std::to_string(workers);
+  }
+};
+
+struct Regression {
+  std::string key;
+  double throughput;
+  double baseline;
+};
+
+double since(Clock::time_point start) {
+  return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+/// @brief [bench] key, as a list of ints, from either a list or one int.
+std::vector<int> intList(const ConfigMap &config, const std::string &key,
+                         std::vector<int> fallback) {
+  if (!config.has_section_key(BenchSection, key)) {
+    return fallback;
+  }
+  const auto value = config.get_value(BenchSection, key);
+  if (const auto *one = std::get_if<int>(&value)) {
+    return {*one};
+  }
+  std::vector<int> list{};
+  for (const auto &item : std::get<VariantList>(value)) {
+    list.push_back(std::get<int>(item));
+  }
+  return list;
+}
+
+BenchOptions readOptions(const ConfigMap &config) {
+  BenchOptions o{};
+  const auto getInt = [&](const std::string &key, int fallback) {
+    return std::get<int>(config.get_value(BenchSection, key, fallback));
+  };
+  const auto getDouble = [&](const std::string &key, double fallback) {
+    return std::get<double>(config.get_value(BenchSection, key, fallback));
+  };
+  o.lats = intList(config, "lats", o.lats);
+  o.lons = getInt("lons", o.lons);
+  o.workers = intList(config, "workers", o.workers);
+  o.steps = getInt("steps", o.steps);
+  o.warmupSteps = getInt("warmup_steps", o.warmupSteps);
+  o.repeats = getInt("repeats", o.repeats);
+  o.grain = getInt("grain", o.grain);
+  o.timeStep = getDouble("time_step", o.timeStep);
+  o.axialTilt = getDouble("axial_tilt", o.axialTilt);
+  o.heatCapacity = getDouble("heat_capacity", o.heatCapacity);
+  o.noiseAmplitude = getDouble("noise_amplitude", o.noiseAmplitude);
+  o.seed = getInt("seed", o.seed);
+  o.threshold = getDouble("threshold", o.threshold);
+
+  const auto positive = [](int x) { return x > 0; };
+  if (o.lats.empty() || o.workers.empty() ||
+      !std::all_of(o.lats.begin(), o.lats.end(), positive) ||
+      !std::all_of(o.workers.begin(), o.workers.end(), positive) ||
+      o.lons <= 0 || o.steps <= 0 || o.warmupSteps < 0 || o.repeats <= 0 ||
+      o.grain <= 0 || !(o.timeStep > 0.0) || !(o.heatCapacity > 0.0)) {
+    throw std::invalid_argument{"bench_steps: bad [bench] options"};
+  }
+  return o;
+}
+
+#ifdef __linux__
+/// @brief Reset the peak RSS to the current RSS, so that each run reports its
+/// own peak. Best effort: if it fails, the peak is the process's so far.
+void resetPeakRss() { std::ofstream{"/proc/self/clear_refs"} << "5"; }
+
+/// @brief The peak resident set size in KiB, or -1 if it is unknown.
+long peakRssKb() {
+  std::ifstream status{"/proc/self/status"};
+  std::string line;
+  while (std::getline(status, line)) {
+    if (line.rfind("VmHWM:", 0) == 0) {
+      return std::strtol(line.c_str() + 6, nullptr, 10);
+    }
+  }
+  return -1;
+}
+#else
+void resetPeakRss() {}
+long peakRssKb() { return -1; }
+#endif
+
+/// @brief The centre of each cell along one axis, from its edges.
+std::vector<double> centres(const std::vector<double> &edges) {
+  std::vector<double> c(edges.size() - 1);
+  for (size_t i = 0; i < c.size(); ++i) {
+    c[i] = 0.5 * (edges[i] + edges[i + 1]);
+  }
+  return c;
+}
+
+/// @brief Futures for f(firstRow, rows) over bands of grain rows, on tasker.
+/// Each task has its own copy of f, which may be a temporary.
+template <typename F>
+std::vector<Future<>> forBands(size_t lats, size_t grain, Tasker &tasker,
+                               const F &f) {
+  std::vector<Future<>> parts{};
+  for (size_t first = 0; first < lats; first += grain) {
+    const auto rows = std::min(grain, lats - first);
+    parts.push_back(tasker.Submit([f, first, rows]() { f(first, rows); }));
+  }
+  return parts;
+}
+
+RunResult runOnce(const std::string &scenario, const BenchOptions &o,
+                  int lats, int workers) {
+  resetPeakRss();
+  RunResult r{.lats = lats, .lons = o.lons, .workers = workers,
+              .steps = o.steps};
+  auto start = Clock::now();
+  const auto config = ConfigMap::parse_from_file(scenario);
+  r.phases.config = since(start);
+
+  start = Clock::now();
+  const World world{config};
+  r.phases.world = since(start);
+
+  start = Clock::now();
+  Tasker tasker{{.frameWorkers = static_cast<size_t>(workers),
+                 .backgroundWorkers = 1}};
+  const auto grid = grid::LatLonGrid::uniform(lats, o.lons);
+  const grid::Regridder zonal{grid, grid::LatLonGrid::uniform(lats, 1), world};
+  const auto latitudes = centres(grid.latEdges());
+  const auto longitudes = centres(grid.lonEdges());
+  const auto stars = world.getStars();
+  const auto year = astro::orbitalPeriod(world.getOrbitRadius(),
+                                         astro::sunMass(world.getSunSize()));
+  const auto dayLength = std::abs(world.getBodyPeriod());
+  const rng::Philox noiseRng{static_cast<uint64_t>(o.seed)};
+  const size_t lons = o.lons;
+  const size_t grain = o.grain;
+
+  std::vector<double> flux(grid.size());
+  std::vector<double> noise(grid.size());
+  std::vector<double> temperature(grid.size(),
+                                  world.getPlanetaryBalanceTemperature());
+  std::vector<double> zonalMean(lats);
+  r.phases.setup = since(start);
+
+  const auto absorbed = 1.0 - should_be_defines::BondAlbedo;
+  const auto emitted =
+      should_be_defines::Emissivity * param::StefanBoltzmannConst;
+  const auto perCapacity = o.timeStep / o.heatCapacity;
+
+  PhaseTimes timed{};
+  const auto step = [&](uint64_t n) {
+    auto phase = Clock::now();
+    const auto t = static_cast<double>(n) * o.timeStep;
+    const auto timeInYear = std::fmod(t / year, 1.0);
+    const astro::InsolationSlice slice{
+        t, t + o.timeStep,
+        astro::calcDeclination(
+            o.axialTilt,
+            astro::calcTrueAnomaly(world.getEccentricity().at(t), timeInYear),
+            timeInYear)};
+    auto forcing =
+        forBands(lats, grain, tasker, [&](size_t first, size_t rows) {
+          noiseRng.normal(n, first * lons,
+                          std::span{noise}.subspan(first * lons, rows * lons));
+        });
+    forcing.push_back(astro::calcInsolationAsync<math::Fast>(
+        latitudes, longitudes, std::span{&slice, 1}, dayLength, stars, flux,
+        grain, tasker));
+    when_all(std::move(forcing)).get();
+    timed.forcing += since(phase);
+
+    phase = Clock::now();
+    when_all(forBands(lats, grain, tasker, [&](size_t first, size_t rows) {
+      for (size_t i = first * lons; i < (first + rows) * lons; ++i) {
+        const auto T = temperature[i];
+        const auto net = absorbed * flux[i] + o.noiseAmplitude * noise[i] -
+                         emitted * T * T * T * T;
+        temperature[i] = T + perCapacity * net;
+      }
+    })).get();
+    timed.physics += since(phase);
+
+    phase = Clock::now();
+    zonal.applyAsync(temperature, zonalMean, tasker).get();
+    timed.diagnostics += since(phase);
+
+    phase = Clock::now();
+    const auto stats = FieldStats::computeAsync(
+                           temperature,
+                           {.histogramBins = 64,
+                            .histogramMin = 150.0,
+                            .histogramMax = 350.0},
+                           grain * lons, tasker)
+                           .get();
+    r.meanTemperature = stats.mean();
+    timed.statistics += since(phase);
+  };
+
+  // Impl: warm-up steps fault in the fields and wake the workers, untimed
+  for (int n = 0; n < o.warmupSteps; ++n) {
+    step(static_cast<uint64_t>(n));
+  }
+  timed = {};
+  start = Clock::now();
+  for (int n = 0; n < o.steps; ++n) {
+    step(static_cast<uint64_t>(o.warmupSteps + n));
+  }
+  r.seconds = since(start);
+
+  r.phases.forcing = timed.forcing;
+  r.phases.physics = timed.physics;
+  r.phases.diagnostics = timed.diagnostics;
+  r.phases.statistics = timed.statistics;
+  r.throughput = static_cast<double>(r.cells()) * o.steps / r.seconds;
+  r.peakRssKb = peakRssKb();
+  // Impl: work on the default Tasker would run on threads beyond workers,
+  // and skew every efficiency; nothing here should ever create it
+  if (Tasker::HasDefault()) {
+    throw std::logic_error{"bench_steps: " + r.key() +
+                           " ran work on the default Tasker"};
+  }
+  return r;
+}
+
+/// @brief The fastest of o.repeats runs, which is the least disturbed by the
+/// rest of the machine.
+RunResult run(const std::string &scenario, const BenchOptions &o, int lats,
+              int workers) {
+  auto best = runOnce(scenario, o, lats, workers);
+  for (int i = 1; i < o.repeats; ++i) {
+    auto again = runOnce(scenario, o, lats, workers);
+    if (again.seconds < best.seconds) {
+      best = std::move(again);
+    }
+  }
+  return best;
+}
+
+/// @brief Strong efficiency is against the fewest workers at the same size;
+/// weak efficiency against the fewest workers at the same cells per worker,
+/// and is left NaN if the sweep has no such run.
+void addEfficiencies(std::vector<RunResult> &runs) {
+  int fewest = std::numeric_limits<int>::max();
+  for (const auto &r : runs) {
+    fewest = std::min(fewest, r.workers);
+  }
+  for (auto &r : runs) {
+    for (const auto &base : runs) {
+      if (base.workers != fewest) {
+        continue;
+      }
+      if (base.lats == r.lats) {
+        r.strongEfficiency = (base.seconds * base.workers) /
+                             (r.seconds * r.workers);
+      }
+      if (base.cells() * r.workers == r.cells() * base.workers) {
+        r.weakEfficiency = base.seconds / r.seconds;
+      }
+    }
+  }
+}
+
+std::vector<Regression> compare(const std::vector<RunResult> &runs,
+                                const ConfigMap &baseline, double threshold) {
+  std::vector<Regression> regressions{};
+  for (const auto &r : runs) {
+    if (!baseline.has_section_key(r.key(), "throughput")) {
+      continue;
+    }
+    if (!baseline.has_section_key(r.key(), "lons") ||
+        std::get<int>(baseline.get_value(r.key(), "lons")) != r.lons) {
+      throw std::runtime_error{"bench_steps: the baseline's " + r.key() +
+                               " was not measured with lons = " +
+                               std::to_string(r.lons)};
+    }
+    const auto expected =
+        std::get<double>(baseline.get_value(r.key(), "throughput"));
+    if (r.throughput < expected * (1.0 - threshold)) {
+      regressions.push_back({r.key(), r.throughput, expected});
+    }
+  }
+  return regressions;
+}
+
+void writeBaseline(const std::vector<RunResult> &runs,
+                   const std::string &path) {
+  ConfigMap baseline{};
+  for (const auto &r : runs) {
+    baseline.set_value(r.key(), "lons", r.lons);
+    baseline.set_value(r.key(), "throughput", r.throughput);
+    baseline.set_value(r.key(), "seconds_per_step", r.seconds / r.steps);
+  }
+  baseline.write_to_file(path);
+}
+
+/// @brief A JSON number, or null for NaN (which JSON cannot express).
+std::string number(double x) {
+  if (!std::isfinite(x)) {
+    return "null";
+  }
+  char buf[32];
+  std::snprintf(buf, sizeof(buf), "%.6g", x);
+  return buf;
+}
+
+/// @brief A JSON string; the paths and keys here need only quotes escaped.
+std::string quoted(const std::string &s) {
+  std::string out{"\""};
+  for (const auto c : s) {
+    if (c == '"' || c == '\\') {
+      out += '\\';
+    }
+    out += c;
+  }
+  return out + "\"";
+}
+
+void writeJson(std::ostream &out, const std::string &scenario,
+               const BenchOptions &o, const std::vector<RunResult> &runs,
+               const std::optional<std::string> &baseline,
+               const std::vector<Regression> &regressions) {
+  out << "{\n  \"scenario\": " << quoted(scenario)
+      << ",\n  \"hardware_threads\": " << std::thread::hardware_concurrency()
+      << ",\n  \"steps\": " << o.steps << ",\n  \"time_step\": "
+      << number(o.timeStep) << ",\n  \"runs\": [";
+  for (size_t i = 0; i < runs.size(); ++i) {
+    const auto &r = runs[i];
+    const auto &p = r.phases;
+    out << (i == 0 ? "\n" : ",\n") << "    {\"lats\": " << r.lats
+        << ", \"lons\": " << r.lons << ", \"cells\": " << r.cells()
+        << ", \"workers\": " << r.workers << ", \"seconds\": "
+        << number(r.seconds) << ", \"seconds_per_step\": "
+        << number(r.seconds / r.steps) << ", \"throughput\": "
+        << number(r.throughput) << ", \"strong_efficiency\": "
+        << number(r.strongEfficiency) << ", \"weak_efficiency\": "
+        << number(r.weakEfficiency) << ", \"peak_rss_kb\": "
+        << (r.peakRssKb < 0 ? std::string{"null"}
+                            : std::to_string(r.peakRssKb))
+        << ", \"mean_temperature\": " << number(r.meanTemperature)
+        << ",\n     \"phases\": {\"config\": " << number(p.config)
+        << ", \"world\": " << number(p.world) << ", \"setup\": "
+        << number(p.setup) << ", \"forcing\": " << number(p.forcing)
+        << ", \"physics\": " << number(p.physics) << ", \"diagnostics\": "
+        << number(p.diagnostics) << ", \"statistics\": "
+        << number(p.statistics) << "}}";
+  }
+  out << "\n  ],\n  \"baseline\": "
+      << (baseline ? quoted(*baseline) : std::string{"null"})
+      << ",\n  \"threshold\": " << number(o.threshold)
+      << ",\n  \"regressions\": [";
+  for (size_t i = 0; i < regressions.size(); ++i) {
+    const auto &g = regressions[i];
+    out << (i == 0 ? "\n" : ",\n") << "    {\"run\": " << quoted(g.key)
+        << ", \"throughput\": " << number(g.throughput)
+        << ", \"baseline\": " << number(g.baseline) << "}";
+  }
+  out << (regressions.empty() ? "]" : "\n  ]") << "\n}\n";
+}
+
+[[noreturn]] void usage() {
+  std::cerr << "usage: bench_steps SCENARIO [--out FILE] [--baseline FILE] "
+               "[--write-baseline FILE] [--threshold FRACTION]\n";
+  std::exit(2);
+}
+} // namespace
+
+int main(int argc, char **argv) {
+  if (argc < 2) {
+    usage();
+  }
+  const std::string scenario{argv[1]};
+  std::optional<std::string> out{};
+  std::optional<std::string> baselinePath{};
+  std::optional<std::string> writeBaselinePath{};
+  std::optional<double> threshold{};
+  for (int i = 2; i < argc; ++i) {
+    const std::string arg{argv[i]};
+    if (i + 1 == argc) {
+      usage();
+    }
+    const std::string value{argv[++i]};
+    if (arg == "--out") {
+      out = value;
+    } else if (arg == "--baseline") {
+      baselinePath = value;
+    } else if (arg == "--write-baseline") {
+      writeBaselinePath = value;
+    } else if (arg == "--threshold") {
+      threshold = std::stod(value);
+    } else {
+      usage();
+    }
+  }
+
+  try {
+    auto options = readOptions(ConfigMap::parse_from_file(scenario));
+    if (threshold) {
+      options.threshold = *threshold;
+    }
+
+    std::vector<RunResult> runs{};
+    for (const auto lats : options.lats) {
+      for (const auto workers : options.workers) {
+        runs.push_back(run(scenario, options, lats, workers));
+        std::cerr << "bench_steps: " << runs.back().key() << ": "
+                  << number(runs.back().throughput) << " cell-steps/s\n";
+      }
+    }
+    addEfficiencies(runs);
+
+    std::vector<Regression> regressions{};
+    if (baselinePath) {
+      regressions = compare(runs, ConfigMap::parse_from_file(*baselinePath),
+                            options.threshold);
+    }
+    if (writeBaselinePath) {
+      writeBaseline(runs, *writeBaselinePath);
+    }
+
+    if (out) {
+      std::ofstream file{*out};
+      if (!file) {
+        throw std::runtime_error{"bench_steps: cannot write " + *out};
+      }
+      writeJson(file, scenario, options, runs, baselinePath, regressions);
+    } else {
+      writeJson(std::cout, scenario, options, runs, baselinePath,
+                regressions);
+    }
+
+    for (const auto &g : regressions) {
+      std::cerr << "bench_steps: " << g.key << " regressed: "
+                << number(g.throughput) << " cell-steps/s against "
+                << number(g.baseline) << "\n";
+    }
+    return regressions.empty() ? 0 : 1;
+  } catch (const std::exception &e) {
+    std::cerr << e.what() << "\n";
+    return 2;
+  }
+}
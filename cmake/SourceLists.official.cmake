@@ -3,10 +3,27 @@ set(SOURCES_LIST ${SOURCES_LIST}
 ${PROJECT_SOURCE_DIR}/src/stat/trick_math.hpp
 ${PROJECT_SOURCE_DIR}/src/stat/planets.hpp
 ${PROJECT_SOURCE_DIR}/src/stat/world.hpp
+${PROJECT_SOURCE_DIR}/src/stat/static_world.hpp
 ${PROJECT_SOURCE_DIR}/src/stat/config_map.cpp
 ${PROJECT_SOURCE_DIR}/src/stat/parameter.hpp
 ${PROJECT_SOURCE_DIR}/src/stat/planets.cpp
 ${PROJECT_SOURCE_DIR}/src/stat/world.cpp
 ${PROJECT_SOURCE_DIR}/src/stat/constants.hpp
+${PROJECT_SOURCE_DIR}/src/stat/fast_math.hpp
+${PROJECT_SOURCE_DIR}/src/stat/field_stats.cpp
+${PROJECT_SOURCE_DIR}/src/stat/seawater.hpp
+${PROJECT_SOURCE_DIR}/src/stat/seawater.cpp
+${PROJECT_SOURCE_DIR}/src/stat/insolation.hpp
+${PROJECT_SOURCE_DIR}/src/stat/insolation.cpp
+${PROJECT_SOURCE_DIR}/src/stat/regrid.hpp
+${PROJECT_SOURCE_DIR}/src/stat/regrid.cpp
+${PROJECT_SOURCE_DIR}/src/stat/philox.hpp
+${PROJECT_SOURCE_DIR}/src/stat/philox.cpp
 ${PROJECT_SOURCE_DIR}/src/tasker/tasker.cpp
+${PROJECT_SOURCE_DIR}/src/tasker/pipeline.cpp
+${PROJECT_SOURCE_DIR}/src/trace/trace.cpp
+${PROJECT_SOURCE_DIR}/src/io/checkpoint.hpp
+${PROJECT_SOURCE_DIR}/src/io/checkpoint.cpp
+${PROJECT_SOURCE_DIR}/src/io/field_series.hpp
+${PROJECT_SOURCE_DIR}/src/io/field_series.cpp
 )
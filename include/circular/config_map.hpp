@@ -1,7 +1,11 @@
 #pragma once
 
+#include <circular/flat_map.hpp>
+#include <cstdint>
+#include <iosfwd>
+#include <memory>
 #include <string>
-#include <unordered_map>
+#include <string_view>
 #include <variant>
 #include <vector>
 
@@ -11,31 +15,97 @@ using PodVariant = std::variant<std::monostate, bool, int, double,
                                 std::string>; // no containers
 
 using VariantList = std::vector<PodVariant>;
-using VariantDict = std::unordered_map<std::string, PodVariant>;
+using VariantDict = FlatMap<std::string, PodVariant>;
 
 using ConfigVariant =
     std::variant<std::monostate, bool, int, double, std::string, VariantList,
                  VariantDict>; // has containers
 
 /**
- * @brief A two-level unordered_map from string sections/keys to variant values.
+ * @brief The compact, 16-byte form in which ConfigMap stores a ConfigVariant.
+ *
+ * Scalars, and strings of up to 14 bytes, are stored inline. A longer string,
+ * a list or a dict is one heap block: a list's elements are ConfigValues
+ * themselves (so short strings in a list cost no allocation of their own),
+ * and a dict's keys and values alternate, sorted by key. A ConfigVariant, by
+ * contrast, is 64 bytes, and a dict of n keys costs n + 1 allocations.
+ */
+class ConfigValue {
+public:
+  enum class Type : uint8_t { Null, Bool, Int, Double, String, List, Dict };
+
+  ConfigValue() noexcept = default;
+  ConfigValue(const ConfigVariant &value);
+  ConfigValue(const ConfigValue &other);
+  ConfigValue(ConfigValue &&other) noexcept;
+  ConfigValue &operator=(const ConfigValue &other);
+  ConfigValue &operator=(ConfigValue &&other) noexcept;
+  ~ConfigValue() { _release(); }
+
+  Type type() const noexcept;
+
+  /// @brief Expand back into a ConfigVariant.
+  ConfigVariant to_variant() const;
+
+  /// @brief Append this value to out as a TOML value (a dict as an inline
+  /// table).
+  ///
+  /// Throws std::invalid_argument if it is null, or a list or dict holding a
+  /// null, which TOML cannot express.
+  void append_toml(std::string &out) const;
+
+private:
+  // Impl: the representation is richer than Type, to say where a string is
+  enum class Kind : uint8_t {
+    Null,
+    Bool,
+    Int,
+    Double,
+    SmallString,
+    HeapString,
+    List,
+    Dict
+  };
+  static constexpr size_t SmallCapacity = 14;
+
+  void _setString(std::string_view s);
+  void _setPod(const PodVariant &value);
+  PodVariant _toPod() const;
+  std::string_view _string() const;
+
+  // heap blocks: a pointer and a count, in the first 12 bytes
+  template <typename T> T *_block() const;
+  uint32_t _blockSize() const;
+  template <typename T> void _setBlock(T *block, uint32_t size);
+
+  void _copyFrom(const ConfigValue &other);
+  void _release() noexcept;
+
+  alignas(8) unsigned char _bytes[SmallCapacity] = {};
+  uint8_t _small = 0; // the length of a SmallString
+  Kind _kind = Kind::Null;
+};
+
+/**
+ * @brief A two-level map from string sections/keys to variant values.
  *
  * ConfigMap is an STL-based analogue to godot::ConfigFile, with three
  * differences:
- * 1. no methods to read/write/parse/stringify; and
+ * 1. it reads and writes TOML rather than godot's own format; and
  * 2. values are restricted to {BOOL, INT, DOUBLE, STRING, ARRAY, DICT}, and
  * 3. The ARRAY and DICT therein are limited to non-container types. Sorry.
  * It stores key-value pairs, with std::string keys and std::variant values.
  * These pairs are further collected into sections, identified by std::string
- * section keys.
+ * section keys. Internally, both levels are FlatMaps, and the values are
+ * stored as compact ConfigValues.
  *
  * The consumer should handle conversion to and from godot::ConfigFile,
  * including the rules for transforming keys/sections <->
  * std::string and values <-> ConfigVariant.
  */
 class ConfigMap {
-  using _config_section_t = std::unordered_map<std::string, ConfigVariant>;
-  using _config_map_repr_t = std::unordered_map<std::string, _config_section_t>;
+  using _config_section_t = FlatMap<std::string, ConfigValue>;
+  using _config_map_repr_t = FlatMap<std::string, _config_section_t>;
 
 public:
   ConfigMap() = default;
@@ -48,6 +118,59 @@ public:
   /// Throws toml::parse_error on parse error.
   static ConfigMap parse_from_file(const std::string &file_path);
 
+  /// @brief load from a file, but parse each section only when first used.
+  /// @param file_path The relative or absolute path of the file to be loaded.
+  /// @param sections The sections to load, e.g. {"body"}, or all if empty.
+  /// The root section is "". Others are absent from the ConfigMap.
+  /// @return a ConfigMap which knows the names of the sections, but holds
+  /// their values only once they are read or written.
+  ///
+  /// Loading only reads the file, and scans it for the byte ranges of the
+  /// sections. The first method to touch a section (even a const one)
+  /// parses its ranges alone, so time and memory scale with the sections
+  /// used, and syntax errors elsewhere go unreported. Sections defined only
+  /// by dotted keys in the root section are parsed, with it, on loading.
+  ///
+  /// Because const methods may parse, a lazily loaded ConfigMap is not safe
+  /// to read from several threads at once until materialise_all is called.
+  ///
+  /// Throws std::runtime_error if the file cannot be read, and
+  /// toml::parse_error, on loading or later, if a section fails to parse.
+  static ConfigMap parse_from_file_lazily(
+      const std::string &file_path,
+      const std::vector<std::string> &sections = {});
+
+  /// @brief parse every section not parsed yet, if loaded lazily.
+  ///
+  /// Throws toml::parse_error if a section fails to parse.
+  void materialise_all() const;
+
+  /// @brief write as TOML, which parse_from_file reads back unchanged.
+  /// @param out The stream to write to.
+  ///
+  /// The root section "" comes first, as top-level keys, then the other
+  /// sections as tables; lists are arrays, and dicts inline tables. Sections
+  /// and keys are written in sorted order, so equal ConfigMaps always give
+  /// identical output. The output is built in a buffer, and written to out a
+  /// large chunk at a time, in a single pass with no intermediate TOML
+  /// document. Null values (which set_value treats as deletions) are skipped.
+  ///
+  /// Throws std::invalid_argument if a list or dict holds a null, or a key in
+  /// the root section is also the name of a section; std::runtime_error if
+  /// out fails.
+  void write_to_stream(std::ostream &out) const;
+
+  /// @brief write as TOML, as write_to_stream.
+  /// @return the TOML document.
+  std::string write_to_string() const;
+
+  /// @brief write as TOML, as write_to_stream.
+  /// @param file_path The relative or absolute path of the file to be
+  /// written, which is replaced if it exists.
+  ///
+  /// Throws std::runtime_error if the file cannot be opened or written.
+  void write_to_file(const std::string &file_path) const;
+
   /// @brief erase all sections and keys, making the ConfigMap empty.
   void clear();
 
@@ -66,11 +189,11 @@ public:
 
   /// @brief list the keys present in a section.
   /// @param section The section for which a list of keys is desired.
-  /// @return A vector of keys in that section (in no particular order).
+  /// @return A vector of keys in that section (in sorted order).
   std::vector<std::string> get_section_keys(const std::string &section) const;
 
   /// @brief List the sections present in the ConfigMap.
-  /// @return A vector of sections in the ConfigMap (in no particular order).
+  /// @return A vector of sections in the ConfigMap (in sorted order).
   std::vector<std::string> get_sections() const;
 
   /// @brief Look up a value, and either return a default or throw if not found.
@@ -112,6 +235,44 @@ public:
                        const std::string &key) const;
 
 private:
+  // Impl: the byte range in _source of each section not parsed yet
+  using _pending_map_t = FlatMap<std::string, std::pair<size_t, size_t>>;
+
+  // Impl: appends to buffer, and moves it to out (if any) whenever it is full
+  void _write_toml(std::string &buffer, std::ostream *out) const;
+
+  /// @brief add the contents of a parsed toml::table, but only the sections
+  /// in allowed (unless it is null).
+  template <typename Table>
+  void _load(const Table &parsed, const std::vector<std::string> *allowed);
+
+  /// @brief parse section, if it is pending, into _lazy.parsed. The only
+  /// const method which changes anything.
+  void _materialise(std::string_view section) const;
+
+  /// @brief materialise section, and move it into _repr if it was parsed.
+  void _adopt(std::string_view section);
+
+  /// @brief section, wherever it is, once materialised; or null.
+  const _config_section_t *_find_section(std::string_view section) const;
+
+  /// @brief set_value, for a section which is neither pending nor parsed.
+  void _set_value(const std::string &section, const std::string &key,
+                  const ConfigVariant &value);
+
+  // Impl: the state of a lazy load; parsing a pending section from a const
+  // method is not a visible change, so it is mutable. A section is in at most
+  // one of _repr, pending, and parsed.
+  struct _lazy_t {
+    _pending_map_t pending{};
+    // the text of the pending sections, shared (read-only) by copies
+    std::shared_ptr<const std::string> source{};
+    // sections parsed by _materialise, until a non-const method adopts them
+    _config_map_repr_t parsed{};
+  };
+
   _config_map_repr_t _repr{};
+  mutable _lazy_t _lazy{};
+  std::string _source_path{};
 };
 } // namespace circular
\ No newline at end of file
@@ -0,0 +1,158 @@
+#pragma once
+
+#include <circular/tasker.hpp>
+#include <cstdint>
+#include <limits>
+#include <optional>
+#include <span>
+#include <vector>
+
+namespace circular {
+
+/**
+ * @brief An approximate quantile sketch (KLL), of bounded size whatever the
+ * number of values added, and mergeable.
+ *
+ * The rank error is about 1.7 / k with high probability. Compaction picks
+ * which half to keep with a fixed-seed generator rather than a random device,
+ * so the same values added in the same order (and merged in the same order)
+ * always give the same sketch.
+ */
+class QuantileSketch {
+public:
+  /// @brief Throws std::invalid_argument if k < 8.
+  explicit QuantileSketch(size_t k = 200);
+
+  void add(double value);
+  void add(std::span<const double> values);
+
+  /// @brief Fold other in, as if its values had been added to this.
+  /// Throws std::invalid_argument if the sketches have different k.
+  void merge(const QuantileSketch &other);
+
+  /// @brief The approximate q-quantile, for q in [0, 1]; NaN if empty.
+  /// Throws std::invalid_argument if q is out of range.
+  double quantile(double q) const;
+
+  uint64_t count() const { return _count; }
+  size_t k() const { return _k; }
+
+  /// @brief How many values the sketch holds, which is O(k).
+  size_t retained() const { return _retained; }
+
+private:
+  void _compress();
+  void _grow();
+
+  size_t _k;
+  uint64_t _count = 0;
+  std::vector<std::vector<double>> _levels;
+  std::vector<size_t> _capacities;
+  size_t _retained = 0;
+  size_t _capacity = 0; // the sum of _capacities
+  uint64_t _rng = 0x9E3779B97F4A7C15;
+};
+
+/**
+ * @brief What a FieldStats collects beyond moments and extrema.
+ *
+ * Histogram bins split [histogramMin, histogramMax] evenly; values outside
+ * are counted as underflow or overflow. A sketchK of 0 means no quantiles.
+ */
+struct FieldStatsOptions {
+  size_t histogramBins = 0;
+  double histogramMin = 0.0;
+  double histogramMax = 1.0;
+  size_t sketchK = 0;
+
+  bool operator==(const FieldStatsOptions &) const = default;
+};
+
+/**
+ * @brief One-pass statistics of a field: count, mean, variance, extrema and
+ * their indices, a fixed-bin histogram and approximate quantiles.
+ *
+ * Values are consumed a cache-sized block at a time. The moments and extrema
+ * of each block are reduced over independent lanes, which the compiler
+ * vectorizes, then combined with the running state (Chan et al.), so that
+ * every value is read from memory once. NaNs are counted, and otherwise
+ * ignored.
+ *
+ * Partial states over disjoint parts of a field merge exactly (up to
+ * rounding, and the sketch's approximation), so computeAsync() splits a field
+ * across Tasker workers and merges the parts in order.
+ */
+class FieldStats {
+public:
+  /// @brief Throws std::invalid_argument if the histogram range is empty or
+  /// not finite, or sketchK is too small (see QuantileSketch).
+  explicit FieldStats(FieldStatsOptions options = {});
+
+  /// @brief Add values, the first of which is at index offset in the field.
+  void add(std::span<const double> values, size_t offset = 0);
+
+  /// @brief Fold in the statistics of another part of the field.
+  /// Throws std::invalid_argument if the options differ.
+  void merge(const FieldStats &other);
+
+  const FieldStatsOptions &options() const { return _options; }
+
+  /// @brief The number of values added, excluding NaNs.
+  uint64_t count() const { return _count; }
+  uint64_t nanCount() const { return _nans; }
+
+  /// @brief NaN if empty, as are variance(), min() and max().
+  double mean() const;
+  /// @brief The population variance, as accumulate_vector().
+  double variance() const;
+  double min() const;
+  double max() const;
+
+  /// @brief The index of the first minimum (or maximum). Throws
+  /// std::out_of_range if empty.
+  size_t argmin() const;
+  size_t argmax() const;
+
+  const std::vector<uint64_t> &histogram() const { return _histogram; }
+  uint64_t underflow() const { return _underflow; }
+  uint64_t overflow() const { return _overflow; }
+
+  /// @brief The approximate q-quantile, except that the 0- and 1-quantiles
+  /// are the exact min() and max(). Throws std::logic_error if the options
+  /// have no sketch.
+  double quantile(double q) const;
+
+  /// @brief The statistics of values, computed in parts of grain values as
+  /// tasks on tasker. values must outlive the returned Future. Throws
+  /// std::invalid_argument if grain is 0.
+  static Future<FieldStats> computeAsync(std::span<const double> values,
+                                         FieldStatsOptions options = {},
+                                         size_t grain = size_t{1} << 16,
+                                         Tasker &tasker = Tasker::Get());
+
+  /// @brief As computeAsync(), but blocking. Do not call from a Tasker task.
+  static FieldStats compute(std::span<const double> values,
+                            FieldStatsOptions options = {},
+                            size_t grain = size_t{1} << 16,
+                            Tasker &tasker = Tasker::Get());
+
+private:
+  void _addBlock(std::span<const double> block, size_t offset);
+
+  FieldStatsOptions _options;
+  uint64_t _count = 0;
+  uint64_t _nans = 0;
+  double _mean = 0.0;
+  double _m2 = 0.0;
+  double _min = std::numeric_limits<double>::infinity();
+  double _max = -std::numeric_limits<double>::infinity();
+  size_t _argmin = 0;
+  size_t _argmax = 0;
+
+  std::vector<uint64_t> _histogram;
+  uint64_t _underflow = 0;
+  uint64_t _overflow = 0;
+  std::optional<QuantileSketch> _sketch;
+};
+
+} // namespace circular
@@ -0,0 +1,137 @@
+#pragma once
+
+#include <algorithm>
+#include <functional>
+#include <initializer_list>
+#include <stdexcept>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+namespace circular {
+
+/**
+ * @brief A map kept as one vector of key-value pairs, sorted by key.
+ *
+ * For the small maps in a config, a binary search over contiguous pairs beats
+ * hashing into separately allocated nodes, in both memory and lookup time.
+ * Insertion is O(n), except in key order, which appends.
+ *
+ * The interface follows std::map, with two differences: elements are
+ * std::pair<K, V> (the key is not const, but must not be modified through an
+ * iterator), and any insertion or erasure invalidates iterators. Lookups are
+ * heterogeneous, so e.g. a FlatMap<std::string, V> can be searched with a
+ * std::string_view without allocating.
+ */
+template <typename K, typename V> class FlatMap {
+public:
+  using key_type = K;
+  using mapped_type = V;
+  using value_type = std::pair<K, V>;
+  using container_type = std::vector<value_type>;
+  using iterator = typename container_type::iterator;
+  using const_iterator = typename container_type::const_iterator;
+  using size_type = typename container_type::size_type;
+
+  FlatMap() = default;
+
+  /// @brief As std::map, the first of several equal keys wins.
+  FlatMap(std::initializer_list<value_type> init) {
+    _items.reserve(init.size());
+    for (const auto &kv : init) {
+      emplace(kv.first, kv.second);
+    }
+  }
+
+  iterator begin() noexcept { return _items.begin(); }
+  iterator end() noexcept { return _items.end(); }
+  const_iterator begin() const noexcept { return _items.begin(); }
+  const_iterator end() const noexcept { return _items.end(); }
+
+  size_type size() const noexcept { return _items.size(); }
+  bool empty() const noexcept { return _items.empty(); }
+  void clear() noexcept { _items.clear(); }
+  void reserve(size_type n) { _items.reserve(n); }
+
+  template <typename Q> iterator find(const Q &key) {
+    auto it = _lowerBound(key);
+    return (it != end() && !std::less<>{}(key, it->first)) ? it : end();
+  }
+  template <typename Q> const_iterator find(const Q &key) const {
+    return const_cast<FlatMap *>(this)->find(key);
+  }
+
+  template <typename Q> bool contains(const Q &key) const {
+    return find(key) != end();
+  }
+
+  /// @brief Throws std::out_of_range if key is absent.
+  template <typename Q> V &at(const Q &key) {
+    auto it = find(key);
+    if (it == end()) {
+      throw std::out_of_range{"FlatMap::at: key not found"};
+    }
+    return it->second;
+  }
+  template <typename Q> const V &at(const Q &key) const {
+    return const_cast<FlatMap *>(this)->at(key);
+  }
+
+  V &operator[](const K &key) { return try_emplace(key).first->second; }
+
+  template <typename... Args>
+  std::pair<iterator, bool> try_emplace(const K &key, Args &&...args) {
+    auto it = _lowerBound(key);
+    if (it != end() && !std::less<>{}(key, it->first)) {
+      return {it, false};
+    }
+    it = _items.emplace(it, std::piecewise_construct,
+                        std::forward_as_tuple(key),
+                        std::forward_as_tuple(std::forward<Args>(args)...));
+    return {it, true};
+  }
+
+  template <typename M>
+  std::pair<iterator, bool> emplace(const K &key, M &&value) {
+    return try_emplace(key, std::forward<M>(value));
+  }
+
+  template <typename M>
+  std::pair<iterator, bool> insert_or_assign(const K &key, M &&value) {
+    auto [it, inserted] = try_emplace(key, std::forward<M>(value));
+    if (!inserted) {
+      it->second = std::forward<M>(value);
+    }
+    return {it, inserted};
+  }
+
+  iterator erase(iterator pos) { return _items.erase(pos); }
+  iterator erase(const_iterator pos) { return _items.erase(pos); }
+
+  template <typename Q> size_type erase(const Q &key) {
+    auto it = find(key);
+    if (it == end()) {
+      return 0;
+    }
+    _items.erase(it);
+    return 1;
+  }
+
+  bool operator==(const FlatMap &other) const = default;
+
+private:
+  template <typename Q> iterator _lowerBound(const Q &key) {
+    // Impl: check the back first, so that building in key order is O(1)
+    if (_items.empty() || std::less<>{}(_items.back().first, key)) {
+      return end();
+    }
+    return std::lower_bound(begin(), end(), key,
+                            [](const value_type &kv, const Q &k) {
+                              return std::less<>{}(kv.first, k);
+                            });
+  }
+
+  container_type _items;
+};
+
+} // namespace circular
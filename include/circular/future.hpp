@@ -0,0 +1,391 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <variant>
+#include <vector>
+
+namespace circular {
+
+template <typename T> class Future;
+
+namespace detail {
+/// @brief One lane of a Tasker, where the continuations of the Futures for
+/// its work run. Defined in tasker.hpp.
+struct Executor;
+
+/// @brief Run task on executor's workers, or on the default Tasker's if
+/// executor is null. Defined in tasker.cpp.
+void schedule(const std::shared_ptr<Executor> &executor,
+              std::function<void()> task);
+
+/// @brief void becomes std::monostate, so that states can always hold a value.
+template <typename T>
+using Stored = std::conditional_t<std::is_void_v<T>, std::monostate, T>;
+
+/**
+ * @brief The state shared by a Future and whatever will fulfil it.
+ *
+ * It is settled exactly once, by a value or an exception; later attempts are
+ * ignored. Continuations registered through onReady() are scheduled on
+ * executor when it settles, and are only run on the thread that settles it
+ * if executor's Tasker has been destroyed.
+ */
+template <typename T> class SharedState {
+public:
+  bool setValue(Stored<T> value) {
+    return _settle([&]() { _value.emplace(std::move(value)); });
+  }
+
+  bool setException(std::exception_ptr error) {
+    return _settle([&]() { _error = std::move(error); });
+  }
+
+  bool ready() const {
+    std::lock_guard lock{_mutex};
+    return _ready;
+  }
+
+  void wait() const {
+    std::unique_lock lock{_mutex};
+    _cv.wait(lock, [this]() { return _ready; });
+  }
+
+  /// @brief Move the value out, or rethrow the exception. Call once, after
+  /// the state has settled.
+  Stored<T> take() {
+    if (_error) {
+      std::rethrow_exception(_error);
+    }
+    return std::move(*_value);
+  }
+
+  void onReady(std::function<void()> continuation) {
+    {
+      std::lock_guard lock{_mutex};
+      if (!_ready) {
+        _continuations.push_back(std::move(continuation));
+        return;
+      }
+    }
+    schedule(executor, std::move(continuation));
+  }
+
+  /// @brief Set by whoever runs the work, if it can be cancelled.
+  std::function<bool()> cancel;
+
+  /// @brief Set by the Tasker which runs the work, and passed on to the
+  /// states of continuations; null for the default Tasker.
+  std::shared_ptr<Executor> executor;
+
+private:
+  template <typename F> bool _settle(F &&store) {
+    std::vector<std::function<void()>> continuations{};
+    {
+      std::lock_guard lock{_mutex};
+      if (_ready) {
+        return false;
+      }
+      store();
+      _ready = true;
+      continuations.swap(_continuations);
+    }
+    _cv.notify_all();
+    for (auto &c : continuations) {
+      schedule(executor, std::move(c));
+    }
+    return true;
+  }
+
+  mutable std::mutex _mutex;
+  mutable std::condition_variable _cv;
+  bool _ready = false;
+  std::optional<Stored<T>> _value;
+  std::exception_ptr _error;
+  std::vector<std::function<void()>> _continuations;
+};
+
+/// @brief Settle state with the result of fn(), or with what it throws.
+template <typename T, typename F> void fulfil(SharedState<T> &state, F &&fn) {
+  try {
+    if constexpr (std::is_void_v<T>) {
+      fn();
+      state.setValue({});
+    } else {
+      state.setValue(fn());
+    }
+  } catch (...) {
+    state.setException(std::current_exception());
+  }
+}
+
+/// @brief The result of a continuation f applied to the value of a Future<T>.
+template <typename T, typename F> struct ContinuationResult {
+  using type = std::invoke_result_t<F &, T>;
+};
+template <typename F> struct ContinuationResult<void, F> {
+  using type = std::invoke_result_t<F &>;
+};
+} // namespace detail
+
+/**
+ * @brief The eventual result of some work: a value of type T, or an
+ * exception.
+ *
+ * Like std::future, it is move-only and its value can be taken once, through
+ * get() or by a continuation added with then(). Unlike std::future, then()
+ * never blocks: the continuation is scheduled once this Future is ready, on
+ * the lane of the Tasker which ran the work (the default Tasker's Frame lane,
+ * for a Promise), as are continuations of the continuation in turn.
+ */
+template <typename T = void> class Future {
+public:
+  using value_type = T;
+
+  /**
+  @brief default constructor, for a Future that is not valid()
+  */
+  Future() = default;
+
+  /**
+  @brief disabled copy constructor
+  */
+  Future(const Future &) = delete;
+
+  /**
+  @brief default move constructor
+  */
+  Future(Future &&) = default;
+
+  /**
+  @brief disabled copy assignment
+  */
+  Future &operator=(const Future &) = delete;
+
+  /**
+  @brief default move assignment
+  */
+  Future &operator=(Future &&) = default;
+
+  explicit Future(std::shared_ptr<detail::SharedState<T>> state)
+      : _state{std::move(state)} {}
+
+  /// @brief Block until ready. Does not throw the stored exception.
+  void wait() const { _checked("wait").wait(); }
+  bool valid() const noexcept { return nullptr != _state; }
+  bool ready() const { return _checked("ready").ready(); }
+
+  /// @brief Try to stop the work before it runs. Returns false if it cannot
+  /// be cancelled (e.g. this Future came from then()).
+  bool cancel() { return valid() && _state->cancel && _state->cancel(); }
+
+  /// @brief Wait, then return the value or rethrow the exception. The Future
+  /// is no longer valid() afterwards.
+  T get() {
+    auto state = _take("get");
+    state->wait();
+    if constexpr (std::is_void_v<T>) {
+      state->take();
+    } else {
+      return state->take();
+    }
+  }
+
+  /**
+   * @brief Schedule f on the value once this Future is ready.
+   *
+   * f takes the value (or nothing, for Future<void>). If this Future holds an
+   * exception, f is skipped and the exception passes to the result. The Future
+   * is no longer valid() afterwards.
+   *
+   * @return a Future for what f returns (or throws).
+   */
+  template <typename F> auto then(F &&f) {
+    using R = typename detail::ContinuationResult<T, std::decay_t<F>>::type;
+    auto state = _take("then");
+    auto next = std::make_shared<detail::SharedState<R>>();
+    next->executor = state->executor;
+    state->onReady([state, next, f = std::forward<F>(f)]() mutable {
+      detail::fulfil(*next, [&]() -> R {
+        if constexpr (std::is_void_v<T>) {
+          state->take();
+          return f();
+        } else {
+          return f(state->take());
+        }
+      });
+    });
+    return Future<R>{std::move(next)};
+  }
+
+private:
+  template <typename U> friend auto when_all(std::vector<Future<U>> futures);
+  template <typename U> friend auto when_any(std::vector<Future<U>> futures);
+
+  detail::SharedState<T> &_checked(const char *what) const {
+    if (!valid()) {
+      throw std::logic_error{std::string{what} + ": future is not valid"};
+    }
+    return *_state;
+  }
+
+  std::shared_ptr<detail::SharedState<T>> _take(const char *what) {
+    _checked(what);
+    return std::move(_state);
+  }
+
+  std::shared_ptr<detail::SharedState<T>> _state;
+};
+
+/**
+ * @brief The producing end of a Future, for work that is not a Tasker task.
+ *
+ * A Promise destroyed before it is fulfilled leaves a std::future_error
+ * (broken_promise) in its Future.
+ */
+template <typename T = void> class Promise {
+public:
+  Promise() : _state{std::make_shared<detail::SharedState<T>>()} {}
+  Promise(const Promise &) = delete;
+  Promise(Promise &&) = default;
+  Promise &operator=(const Promise &) = delete;
+  Promise &operator=(Promise &&) = default;
+
+  ~Promise() {
+    if (nullptr != _state) {
+      _state->setException(std::make_exception_ptr(
+          std::future_error{std::future_errc::broken_promise}));
+    }
+  }
+
+  /// @brief May be called once.
+  Future<T> get_future() {
+    if (_retrieved) {
+      throw std::logic_error{"get_future: future already retrieved"};
+    }
+    _retrieved = true;
+    return Future<T>{_state};
+  }
+
+  template <typename U = T>
+    requires(!std::is_void_v<U>)
+  void set_value(U value) {
+    _state->setValue(std::move(value));
+  }
+
+  template <typename U = T>
+    requires std::is_void_v<U>
+  void set_value() {
+    _state->setValue({});
+  }
+
+  void set_exception(std::exception_ptr error) {
+    _state->setException(std::move(error));
+  }
+
+private:
+  std::shared_ptr<detail::SharedState<T>> _state;
+  bool _retrieved = false;
+};
+
+/**
+ * @brief A Future which is ready once all of futures are.
+ *
+ * Its value is the values in order (nothing, for void), or the exception of
+ * the first of futures (by position) that failed. Consumes futures. Its
+ * continuations run where the first of futures' would.
+ */
+template <typename T> auto when_all(std::vector<Future<T>> futures) {
+  using R = std::conditional_t<std::is_void_v<T>, void, std::vector<T>>;
+  struct Join {
+    std::vector<std::shared_ptr<detail::SharedState<T>>> states;
+    std::atomic<size_t> remaining;
+    std::shared_ptr<detail::SharedState<R>> result;
+  };
+
+  auto join = std::make_shared<Join>();
+  join->result = std::make_shared<detail::SharedState<R>>();
+  for (auto &f : futures) {
+    join->states.push_back(f._take("when_all"));
+  }
+  join->remaining = join->states.size();
+  if (!join->states.empty()) {
+    join->result->executor = join->states.front()->executor;
+  }
+
+  auto finish = [join]() {
+    detail::fulfil(*join->result, [&]() -> R {
+      if constexpr (std::is_void_v<T>) {
+        for (auto &s : join->states) {
+          s->take();
+        }
+      } else {
+        R values{};
+        values.reserve(join->states.size());
+        for (auto &s : join->states) {
+          values.push_back(s->take());
+        }
+        return values;
+      }
+    });
+  };
+  if (join->states.empty()) {
+    finish();
+  }
+  for (auto &s : join->states) {
+    s->onReady([join, finish]() {
+      if (--join->remaining == 0) {
+        finish();
+      }
+    });
+  }
+  return Future<R>{join->result};
+}
+
+/**
+ * @brief A Future which is ready once any of futures is.
+ *
+ * Its value is the index of the first one to become ready (and, unless void,
+ * that one's value, as a std::pair), or that one's exception. Consumes
+ * futures, which must not be empty. Its continuations run where the first of
+ * futures' would.
+ */
+template <typename T> auto when_any(std::vector<Future<T>> futures) {
+  using R = std::conditional_t<std::is_void_v<T>, size_t,
+                               std::pair<size_t, detail::Stored<T>>>;
+  if (futures.empty()) {
+    throw std::invalid_argument{"when_any: no futures"};
+  }
+
+  auto result = std::make_shared<detail::SharedState<R>>();
+  for (size_t i = 0; i < futures.size(); ++i) {
+    auto state = futures[i]._take("when_any");
+    if (i == 0) {
+      result->executor = state->executor;
+    }
+    state->onReady([result, state, i]() {
+      // Impl: only the first to get here settles result, but the others take
+      // their values too; nobody else can
+      detail::fulfil(*result, [&]() -> R {
+        if constexpr (std::is_void_v<T>) {
+          state->take();
+          return i;
+        } else {
+          return {i, state->take()};
+        }
+      });
+    });
+  }
+  return Future<R>{std::move(result)};
+}
+
+} // namespace circular
@@ -6,11 +6,14 @@
 /// \brief Accumulate a vector to produce the mean and the variance of the
 /// distribution.
 ///
-/// This computes the mean and the variance of a vector of double values.
+/// This computes the mean and the variance of a vector of float or double
+/// values (explicitly instantiated for both). The sums are always accumulated
+/// in double, since a float sum of many values loses their low bits.
 ///
 
 namespace circular {
-std::tuple<double, double>
-accumulate_vector(const std::vector<double> &values ///< The vector of values
+template <typename T>
+std::tuple<T, T>
+accumulate_vector(const std::vector<T> &values ///< The vector of values
 );
 }
\ No newline at end of file
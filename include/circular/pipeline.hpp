@@ -0,0 +1,130 @@
+#pragma once
+
+#include <any>
+#include <functional>
+#include <memory>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace circular {
+
+/**
+ * @brief How a pipeline stage treats concurrent steps.
+ *
+ * A Serial stage runs one step at a time, in step order. A Parallel stage may
+ * run several steps at once, in any order; its callable must be thread-safe.
+ */
+enum class StageMode { Serial, Parallel };
+
+/// @brief A type-erased stage: takes the step and the previous stage's output.
+struct PipelineStage {
+  StageMode mode;
+  std::function<std::any(size_t, std::any &&)> fn;
+};
+
+class Pipeline;
+
+/**
+ * @brief Builds a Pipeline one typed stage at a time; see Pipeline::Source().
+ * @tparam Out the output type of the last stage so far.
+ */
+template <typename Out> class PipelineBuilder {
+public:
+  explicit PipelineBuilder(std::vector<PipelineStage> stages)
+      : _stages{std::move(stages)} {}
+
+  /**
+   * @brief Append a stage which takes the previous stage's output (by value,
+   * or nothing if that was void) and returns this stage's.
+   */
+  template <typename F> auto Then(F &&f, StageMode mode = StageMode::Serial) {
+    using R = typename std::conditional_t<std::is_void_v<Out>,
+                                          std::invoke_result<F &>,
+                                          std::invoke_result<F &, Out>>::type;
+    static_assert(std::is_void_v<R> || std::is_copy_constructible_v<R>,
+                  "Then: stage outputs are held in std::any, so must be "
+                  "copy-constructible");
+    auto stage = [f = std::forward<F>(f)](size_t,
+                                          std::any &&in) mutable -> std::any {
+      auto call = [&]() -> R {
+        if constexpr (std::is_void_v<Out>) {
+          return f();
+        } else {
+          return f(std::move(std::any_cast<Out &>(in)));
+        }
+      };
+      if constexpr (std::is_void_v<R>) {
+        call();
+        return {};
+      } else {
+        return call();
+      }
+    };
+    _stages.push_back({mode, std::move(stage)});
+    return PipelineBuilder<R>{std::move(_stages)};
+  }
+
+  Pipeline Build() &&;
+
+private:
+  std::vector<PipelineStage> _stages;
+};
+
+/**
+ * @brief A linear chain of stages, built once and run over many steps by
+ * Tasker::Run, with several steps in flight at once.
+ *
+ * For example, with forcing -> physics -> diagnostics -> output, step N + 1's
+ * forcing runs while step N's diagnostics and output do:
+ *
+ *     auto p = Pipeline::Source([](size_t step) { return forcing(step); })
+ *                  .Then([](Forcing f) { return physics(f); })
+ *                  .Then([](State s) { return diagnose(s); },
+ *                        StageMode::Parallel)
+ *                  .Then([](Diagnostics d) { write(d); })
+ *                  .Build();
+ *     Tasker::Get().Run(p, steps, 4).get();
+ */
+class Pipeline {
+public:
+  /// @brief Start a pipeline with a stage which makes step's input.
+  template <typename F>
+  static auto Source(F &&f, StageMode mode = StageMode::Serial) {
+    using R = std::invoke_result_t<F &, size_t>;
+    static_assert(std::is_void_v<R> || std::is_copy_constructible_v<R>,
+                  "Source: stage outputs are held in std::any, so must be "
+                  "copy-constructible");
+    auto stage = [f = std::forward<F>(f)](size_t step,
+                                          std::any &&) mutable -> std::any {
+      if constexpr (std::is_void_v<R>) {
+        f(step);
+        return {};
+      } else {
+        return f(step);
+      }
+    };
+    std::vector<PipelineStage> stages{};
+    stages.push_back({mode, std::move(stage)});
+    return PipelineBuilder<R>{std::move(stages)};
+  }
+
+  size_t StageCount() const { return _stages->size(); }
+
+private:
+  template <typename Out> friend class PipelineBuilder;
+  friend class Tasker;
+
+  explicit Pipeline(std::vector<PipelineStage> stages)
+      : _stages{std::make_shared<const std::vector<PipelineStage>>(
+            std::move(stages))} {}
+
+  // Impl: shared, so that a run can outlive the Pipeline it was started from
+  std::shared_ptr<const std::vector<PipelineStage>> _stages;
+};
+
+template <typename Out> Pipeline PipelineBuilder<Out>::Build() && {
+  return Pipeline{std::move(_stages)};
+}
+
+} // namespace circular
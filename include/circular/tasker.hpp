@@ -1,53 +1,171 @@
 #pragma once
 
+#include <any>
+#include <atomic>
+#include <chrono>
+#include <circular/future.hpp>
+#include <concepts>
 #include <functional>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
 #include <taskflow/taskflow.hpp>
+#include <unordered_map>
+#include <vector>
 
 namespace circular {
 
+class Pipeline;
+
+/**
+ * @brief Wall-clock timings of the runs of a TaskGraph.
+ */
+struct RunStats {
+  size_t runs = 0;
+  std::chrono::nanoseconds last{0};
+  std::chrono::nanoseconds total{0};
+  std::chrono::nanoseconds min{0};
+  std::chrono::nanoseconds max{0};
+
+  std::chrono::nanoseconds mean() const {
+    using Rep = std::chrono::nanoseconds::rep;
+    return runs == 0 ? std::chrono::nanoseconds{0}
+                     : total / static_cast<Rep>(runs);
+  }
+};
+
 /**
- * @brief Thin wrapper around a tf::Future<void>.
+ * @brief A named task graph which is built once and run many times.
  *
- * It should do everything a tf::Future<void> can do.
+ * Build the graph through Flow(), capturing a reference to Params<P>() in any
+ * task that needs per-run inputs, then Rebind() new values between runs: the
+ * parameters are assigned in place, so the tasks see them without being
+ * rebuilt. Obtain one from Tasker::DefineGraph(), and run it with Tasker::Run,
+ * RunN or RunUntil.
  */
-class Future {
+class TaskGraph {
 public:
-  /**
-  @brief default constructor
-  */
-  Future() = default;
+  explicit TaskGraph(std::string name) : _name{std::move(name)} {
+    _flow.name(_name);
+  }
+  TaskGraph(const TaskGraph &) = delete;
+  TaskGraph &operator=(const TaskGraph &) = delete;
 
-  /**
-  @brief disabled copy constructor
-  */
-  Future(const Future &) = delete;
+  const std::string &Name() const { return _name; }
 
-  /**
-  @brief default move constructor
-  */
-  Future(Future &&) = default;
+  /// @brief The graph itself, to be built before the first run. Do not
+  /// modify it while Running().
+  tf::Taskflow &Flow() { return _flow; }
 
-  /**
-  @brief disabled copy assignment
-  */
-  Future &operator=(const Future &) = delete;
+  /// @brief Set up the parameter block, replacing any existing one.
+  template <typename P> P &Bind(P params) {
+    _throwIfRunning("Bind");
+    return _params.emplace<P>(std::move(params));
+  }
 
-  /**
-  @brief default move assignment
-  */
-  Future &operator=(Future &&) = default;
+  /// @brief The parameter block, which has a stable address until the next
+  /// Bind(). Throws std::bad_any_cast if P is not the type that was bound.
+  template <typename P> P &Params() { return std::any_cast<P &>(_params); }
 
-  /**
-   * @brief move constructor from taskflow tf::Future
-   */
-  Future(tf::Future<void> &&f) : _f{std::move(f)} {}
+  /// @brief Assign new parameters in place, between runs.
+  template <typename P> void Rebind(P params) {
+    _throwIfRunning("Rebind");
+    Params<P>() = std::move(params);
+  }
+
+  /// @brief Whether a run of this graph is queued or in progress.
+  bool Running() const { return _pending.load() > 0; }
+
+  RunStats Stats() const;
+  void ResetStats();
+
+private:
+  friend class Tasker;
+
+  void _throwIfRunning(const char *what) const {
+    if (Running()) {
+      throw std::logic_error{std::string{what} + ": graph " + _name +
+                             " is running"};
+    }
+  }
+
+  void _record(std::chrono::nanoseconds elapsed);
+
+  std::string _name;
+  tf::Taskflow _flow;
+  std::any _params;
+  std::atomic<size_t> _pending{0};
 
-  void wait() const { _f.wait(); }
-  bool valid() const noexcept { return _f.valid(); }
-  bool cancel() { return _f.cancel(); }
+  mutable std::mutex _statsMutex;
+  RunStats _stats;
+};
+
+/**
+ * @brief The priority lanes of a Tasker, each with its own workers.
+ *
+ * Frame is for latency-critical per-frame work, and is the default.
+ * Background is for long jobs (config reloads, checkpoint writes) which must
+ * never take workers away from the frame.
+ */
+enum class Lane { Frame, Background };
+
+class Tasker;
+
+namespace detail {
+/**
+ * @brief One lane of a Tasker, as the Futures for its work see it. The
+ * Tasker detaches it when it is destroyed, after which continuations
+ * scheduled on it run on whichever thread schedules them.
+ */
+struct Executor {
+  Executor(Tasker *tasker, Lane lane) : tasker{tasker}, lane{lane} {}
+
+  std::mutex mutex;
+  Tasker *tasker; // guarded by mutex
+  const Lane lane;
+};
+} // namespace detail
+
+/**
+ * @brief Counts and latencies of the tasks submitted to one Lane.
+ *
+ * Queue latency is from Submit() to the task starting on a worker.
+ */
+struct LaneStats {
+  size_t submitted = 0;
+  size_t completed = 0;
+  size_t cancelled = 0;
+  std::chrono::nanoseconds queueTotal{0};
+  std::chrono::nanoseconds queueMax{0};
+  std::chrono::nanoseconds runTotal{0};
+  std::chrono::nanoseconds runMax{0};
+
+  std::chrono::nanoseconds meanQueue() const { return _mean(queueTotal); }
+  std::chrono::nanoseconds meanRun() const { return _mean(runTotal); }
 
 private:
-  tf::Future<void> _f;
+  std::chrono::nanoseconds _mean(std::chrono::nanoseconds total) const {
+    using Rep = std::chrono::nanoseconds::rep;
+    auto n = completed + cancelled;
+    return n == 0 ? std::chrono::nanoseconds{0} : total / static_cast<Rep>(n);
+  }
+};
+
+/**
+ * @brief How to set up a Tasker's workers.
+ *
+ * A worker count of 0 takes the default split: a quarter of the machine for
+ * Background, and the rest for Frame. A non-empty CPU list pins that lane's
+ * workers round-robin to those CPUs, one CPU per worker, so that they keep
+ * their caches and do not migrate. Pinning is only implemented on Linux, and
+ * is ignored elsewhere.
+ */
+struct TaskerOptions {
+  size_t frameWorkers = 0;
+  size_t backgroundWorkers = 0;
+  std::vector<int> frameCpus{};
+  std::vector<int> backgroundCpus{};
 };
 
 /**
@@ -57,25 +175,220 @@ private:
  * an abstract Tasker interface and implementing two classes: one using
  * Taskflow, and the other just executing tasks synchronously for e.g.
  * single-threaded apps
+ *
+ * Work is split across two Lanes with separate executors, so background jobs
+ * queue behind each other rather than in front of frame work. A frame can be
+ * bracketed by BeginFrame() and EndFrame(), during which long background
+ * tasks should poll ShouldYield().
  */
 class Tasker {
 public:
-  static Tasker &Get();
+  /// @brief Throws std::invalid_argument if a pinned CPU does not exist or
+  /// this process may not run on it, and std::system_error if a worker could
+  /// not be pinned.
+  explicit Tasker(TaskerOptions options = {});
+
+  /// @brief Shutdown(), then join the workers.
+  ~Tasker();
+
   Tasker(const Tasker &) = delete;
   Tasker &operator=(const Tasker &) = delete;
 
-  Future Submit(std::function<void()> task);
+  /// @brief The default Tasker, created on first use. Thread-safe. It lives
+  /// until the process exits, and is never destroyed (only shut down).
+  static Tasker &Get();
+
+  /// @brief Create the default Tasker with options. Throws std::logic_error
+  /// if Get() or Init() has already created it.
+  static Tasker &Init(TaskerOptions options);
+
+  /// @brief Whether Get() or Init() has created the default Tasker yet.
+  static bool HasDefault();
+
+  /// @brief Wait until no work is in flight in either lane, including work
+  /// that tasks submit in turn (to either lane) while it waits, and only then
+  /// refuse new work: Submit and Run throw std::logic_error. Continuations of
+  /// Futures still run. Idempotent. Do not call it from one of its own tasks.
+  void Shutdown();
+  bool IsShutdown() const { return _shutdown.load(); }
+
+  /**
+   * @brief Run task on a worker in lane.
+   * @return a Future for what task returns or throws. If the task is skipped
+   * by cancel() or CancelBackground(), it holds a std::runtime_error.
+   */
+  template <typename F>
+    requires std::invocable<F &>
+  Future<std::invoke_result_t<F &>> Submit(F &&task, Lane lane = Lane::Frame) {
+    return _submitTask(std::forward<F>(task), lane, true);
+  }
+
+  /// @brief As Submit(), but neither cancel() nor CancelBackground() can skip
+  /// the task, for work whose loss would corrupt something, such as one of a
+  /// sequence of writes to a file.
+  template <typename F>
+    requires std::invocable<F &>
+  Future<std::invoke_result_t<F &>>
+  SubmitUncancellable(F &&task, Lane lane = Lane::Frame) {
+    return _submitTask(std::forward<F>(task), lane, false);
+  }
 
   // Escape hatch to allow more complex tasks via TF
-  Future Submit(tf::Taskflow &&t) { return _ex.run(std::move(t)); }
+  /// @brief Run t once in lane. Its Future rethrows the exception of a task
+  /// which threw, and, like Submit(task), reports a cancelled run as a
+  /// std::runtime_error.
+  Future<> Submit(tf::Taskflow &&t, Lane lane = Lane::Frame);
+
+  size_t TaskCount() const {
+    return _ex.num_taskflows() + _background.num_taskflows();
+  }
+
+  size_t WorkerCount(Lane lane) const {
+    return _executor(lane).num_workers();
+  }
+
+  /// @brief Open a frame which should finish within budget from now.
+  void BeginFrame(std::chrono::nanoseconds budget);
+
+  /// @brief Close the frame. Returns false if it overran its budget.
+  bool EndFrame();
+
+  /// @brief Whether background tasks should yield: true while a frame is
+  /// open and either frame work is queued or running, or the frame has
+  /// reached its deadline. This is cooperative, so long background tasks
+  /// should poll it between chunks of work.
+  bool ShouldYield() const;
+
+  /// @brief Skip every background task which has been submitted through
+  /// Submit(task) but has not yet started. Their Futures still become ready.
+  /// Taskflows and pipelines are not skipped; cancel their Futures instead.
+  void CancelBackground() { ++_backgroundEpoch; }
+
+  /// @brief The counts and latencies of Submit(task) in lane. Taskflows,
+  /// graphs and pipelines are not counted, though frame ones do make
+  /// ShouldYield() true while they are in flight.
+  LaneStats Stats(Lane lane) const;
+  void ResetStats(Lane lane);
 
-  size_t TaskCount() const { return _ex.num_taskflows(); }
+  size_t FramesMissed() const { return _framesMissed.load(); }
+
+  /// @brief Create an empty persistent graph called name. Throws
+  /// std::invalid_argument if one already exists.
+  TaskGraph &DefineGraph(const std::string &name);
+
+  /// @brief Throws std::out_of_range if there is no graph called name.
+  TaskGraph &Graph(const std::string &name);
+  bool HasGraph(const std::string &name) const;
+
+  /// @brief Throws std::logic_error if the graph is running.
+  void EraseGraph(const std::string &name);
+
+  /// @brief Run the named graph once.
+  Future<> Run(const std::string &name) { return RunN(name, 1); }
+
+  /// @brief Run the named graph n times, one run after another.
+  Future<> RunN(const std::string &name, size_t n);
+
+  /// @brief Run the named graph until pred returns true. As with Taskflow,
+  /// pred is checked before every run, including the first. The Future
+  /// settles as Submit(tf::Taskflow)'s does.
+  Future<> RunUntil(const std::string &name, std::function<bool()> pred);
+
+  /**
+   * @brief Stream steps [0, steps) through pipeline, with at most maxInFlight
+   * steps between its first and last stages at once.
+   *
+   * If a stage throws, no further steps start, the steps in flight are
+   * dropped at their next stage, and the Future holds the first exception.
+   * Throws std::invalid_argument if maxInFlight is 0.
+   */
+  Future<> Run(const Pipeline &pipeline, size_t steps, size_t maxInFlight,
+               Lane lane = Lane::Frame);
 
 private:
-  Tasker() = default;
-  ~Tasker() = default;
+  friend void detail::schedule(const std::shared_ptr<detail::Executor> &,
+                               std::function<void()>);
+
+  /// @brief Run a continuation in lane. Unlike Submit(), this works after
+  /// Shutdown(), and is neither counted in the lane's stats nor cancellable.
+  void _post(Lane lane, std::function<void()> task);
 
-  static Tasker *_instance;
+  /// @brief Wait until no work is in flight in either lane, nor any
+  /// continuation pending. Every path that counts work in flight must count
+  /// it out again, even if the work is cancelled before it runs, or this
+  /// never returns.
+  void _drain();
+
+  template <typename F>
+  Future<std::invoke_result_t<F &>> _submitTask(F &&task, Lane lane,
+                                                bool cancellable) {
+    _throwIfShutdown("Submit");
+    using R = std::invoke_result_t<F &>;
+    auto state = std::make_shared<detail::SharedState<R>>();
+    state->executor = _executors[static_cast<size_t>(lane)];
+    auto handle = std::make_shared<tf::Future<void>>(_submit(
+        [state, task = std::forward<F>(task)]() mutable {
+          detail::fulfil(*state, task);
+        },
+        [state]() { state->setException(_cancelled()); }, lane, cancellable));
+    if (cancellable) {
+      state->cancel = [handle]() { return handle->cancel(); };
+    }
+    return Future<R>{std::move(state)};
+  }
+
+  /// @brief The type-erased half of Submit(): run task in lane, then call
+  /// settle, which must settle the Future if task was skipped or cancelled.
+  /// Unless cancellable, CancelBackground() does not skip it.
+  tf::Future<void> _submit(std::function<void()> task,
+                           std::function<void()> settle, Lane lane,
+                           bool cancellable);
+
+  static std::exception_ptr _cancelled();
+
+  void _throwIfShutdown(const char *what) const {
+    if (IsShutdown()) {
+      throw std::logic_error{std::string{what} + ": Tasker is shut down"};
+    }
+  }
+
+  /// @brief The live counters behind a LaneStats.
+  struct LaneState {
+    std::atomic<uint64_t> submitted{0};
+    std::atomic<uint64_t> completed{0};
+    std::atomic<uint64_t> cancelled{0};
+    std::atomic<int64_t> queueTotal{0};
+    std::atomic<int64_t> queueMax{0};
+    std::atomic<int64_t> runTotal{0};
+    std::atomic<int64_t> runMax{0};
+    std::atomic<int64_t> inFlight{0};
+  };
+
+  tf::Executor &_executor(Lane lane) {
+    return lane == Lane::Background ? _background : _ex;
+  }
+  const tf::Executor &_executor(Lane lane) const {
+    return lane == Lane::Background ? _background : _ex;
+  }
+  LaneState &_lane(Lane lane) { return _lanes[static_cast<size_t>(lane)]; }
+  const LaneState &_lane(Lane lane) const {
+    return _lanes[static_cast<size_t>(lane)];
+  }
+
+  std::atomic<bool> _shutdown{false};
+  // Impl: before the executors, whose workers apply it as they start
+  std::shared_ptr<tf::WorkerInterface> _pinning[2];
   tf::Executor _ex;
+  tf::Executor _background;
+
+  LaneState _lanes[2];
+  std::shared_ptr<detail::Executor> _executors[2];
+  std::atomic<int64_t> _continuations{0};
+  std::atomic<uint64_t> _backgroundEpoch{0};
+  std::atomic<int64_t> _frameDeadline{0}; // steady_clock ns; 0 when closed
+  std::atomic<size_t> _framesMissed{0};
+
+  mutable std::mutex _graphsMutex;
+  std::unordered_map<std::string, std::unique_ptr<TaskGraph>> _graphs;
 };
 } // namespace circular
\ No newline at end of file
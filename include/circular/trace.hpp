@@ -0,0 +1,94 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+/**
+ * @brief Lightweight hot-path instrumentation: scoped zones, counters and frame
+ * markers, written out as a Chrome trace (chrome://tracing, or Perfetto).
+ *
+ * Instrument code through the CIRCULAR_TRACE_* macros only. Unless the library
+ * is configured with -DCIRCULAR_TRACING=ON, they expand to nothing, and cost
+ * nothing. When enabled, each thread records into its own fixed-size
+ * lock-free ring buffer; a full ring drops events (see droppedEvents()) rather
+ * than blocking the instrumented thread.
+ */
+
+#define CIRCULAR_TRACE_CONCAT_IMPL(a, b) a##b
+#define CIRCULAR_TRACE_CONCAT(a, b) CIRCULAR_TRACE_CONCAT_IMPL(a, b)
+
+#ifdef CIRCULAR_TRACING
+/// @brief Record the enclosing scope as a zone called name.
+#define CIRCULAR_TRACE_ZONE(name)                                              \
+  ::circular::trace::Zone CIRCULAR_TRACE_CONCAT(_circular_trace_zone_,         \
+                                                __LINE__)(name)
+/// @brief Record the current value of a named counter.
+#define CIRCULAR_TRACE_COUNTER(name, value)                                    \
+  ::circular::trace::counter(name, value)
+/// @brief Mark the boundary between two frames (or simulation steps).
+#define CIRCULAR_TRACE_FRAME(name) ::circular::trace::frame(name)
+#else
+#define CIRCULAR_TRACE_ZONE(name) static_cast<void>(0)
+#define CIRCULAR_TRACE_COUNTER(name, value) static_cast<void>(0)
+#define CIRCULAR_TRACE_FRAME(name) static_cast<void>(0)
+#endif
+
+namespace circular {
+namespace trace {
+
+/// @brief Whether the library was built with tracing enabled.
+bool enabled() noexcept;
+
+/// @brief Nanoseconds since the trace epoch (i.e. process start).
+uint64_t now() noexcept;
+
+/// @brief Record a zone which was timed by some other means.
+/// @param name Copied, and truncated to 54 bytes.
+void complete(std::string_view name, uint64_t begin, uint64_t end) noexcept;
+
+void counter(std::string_view name, double value) noexcept;
+
+void frame(std::string_view name = "frame") noexcept;
+
+/**
+ * @brief RAII zone; prefer CIRCULAR_TRACE_ZONE, which compiles out.
+ *
+ * The name is copied (and truncated) as complete() would, so it need not
+ * outlive the zone: CIRCULAR_TRACE_ZONE(prefix + "x") is safe.
+ */
+class Zone {
+public:
+  explicit Zone(std::string_view name) noexcept : _begin{now()} {
+    _size = static_cast<uint8_t>(name.copy(_name, sizeof(_name)));
+  }
+  ~Zone() { complete({_name, _size}, _begin, now()); }
+
+  Zone(const Zone &) = delete;
+  Zone &operator=(const Zone &) = delete;
+
+private:
+  char _name[54];
+  uint8_t _size;
+  uint64_t _begin;
+};
+
+/// @brief Drain every thread's events into a Chrome trace JSON file.
+/// @param file_path The relative or absolute path of the file to be written.
+///
+/// Draining consumes the events, so consecutive calls write consecutive
+/// slices of the run, and frees the rings of threads which have exited. With
+/// tracing disabled, this writes an empty trace.
+/// Throws std::runtime_error if the file cannot be written.
+void writeChromeTrace(const std::string &file_path);
+
+/// @brief The number of events dropped so far because a ring was full.
+uint64_t droppedEvents();
+
+/// @brief The number of rings held: one for each running thread which has
+/// recorded, and one for each exited thread not yet drained.
+size_t threadBuffers();
+
+} // namespace trace
+} // namespace circular
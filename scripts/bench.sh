@@ -0,0 +1,19 @@
+#!/usr/bin/env bash
+
+# Build and run the scaling benchmark, writing bench_results.json. Any
+# arguments are passed on to bench_steps, e.g.
+#   scripts/bench.sh --baseline ../bench/baseline.toml
+#   scripts/bench.sh --write-baseline ../bench/baseline.toml
+# It exits 1 if a run has regressed against the baseline.
+
+set -x
+
+rm -f cmake/SourceLists.cmake
+cp cmake/SourceLists{.official,}.cmake
+
+mkdir -p build-bench/
+
+cd build-bench && cmake -DCMAKE_BUILD_TYPE=Release -DCIRCULAR_BUILD_BENCH=ON .. &&
+  cmake --build . --target bench_steps || exit 2
+
+./bench/bench_steps ../bench/scaling.toml --out bench_results.json "$@"
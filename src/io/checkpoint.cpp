@@ -0,0 +1,365 @@
+#include "checkpoint.hpp"
+
+#include <cerrno>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <new>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define CIRCULAR_HAS_MMAP 1
+#define CIRCULAR_HAS_FSYNC 1
+#endif
+
+using namespace circular;
+
+namespace {
+const char CheckpointMagic[8] = {'C', 'I', 'R', 'C', 'C', 'K', 'P', 'T'};
+const uint32_t ByteOrderMark = 0x01020304;
+
+uint64_t alignUp(uint64_t offset) {
+  return (offset + CheckpointAlignment - 1) & ~(CheckpointAlignment - 1);
+}
+
+/// @brief The size of an element of type element, or 0 if it is not one.
+uint32_t elementSizeOf(uint32_t element) {
+  switch (static_cast<CheckpointElement>(element)) {
+  case CheckpointElement::Float64:
+    return sizeof(double);
+  case CheckpointElement::Float32:
+    return sizeof(float);
+  case CheckpointElement::Int64:
+    return sizeof(int64_t);
+  case CheckpointElement::Int32:
+    return sizeof(int32_t);
+  }
+  return 0;
+}
+
+#ifdef CIRCULAR_HAS_FSYNC
+/// @brief Block until path's contents, or its entries if it is a directory,
+/// are on disk. Throws std::runtime_error on failure.
+void syncPath(const std::string &path) {
+  int fd = ::open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    throw std::runtime_error{"write: could not open " + path + " to sync"};
+  }
+  // Impl: some filesystems cannot sync a directory, and say so with EINVAL;
+  // there is nothing more to be done on them.
+  const bool synced = ::fsync(fd) == 0 || errno == EINVAL;
+  ::close(fd);
+  if (!synced) {
+    throw std::runtime_error{"write: I/O error syncing " + path};
+  }
+}
+#endif
+} // namespace
+
+circular::CheckpointWriter::CheckpointWriter(const World &world, uint64_t step,
+                                             double time)
+    : _header{} {
+  std::memcpy(_header.magic, CheckpointMagic, sizeof(CheckpointMagic));
+  _header.version = CheckpointVersion;
+  _header.byteOrderMark = ByteOrderMark;
+  _header.step = step;
+  _header.time = time;
+
+  _header.orbitRadius = world.getOrbitRadius();
+  _header.sunSize = world.getSunSize();
+  _header.sunTemp = world.getSunTemp();
+  auto ecc = world.getEccentricity();
+  _header.eccCentre = ecc._centre;
+  _header.eccAmplitude = ecc._amplitude;
+  _header.eccPeriod = ecc._period;
+  _header.eccPhase = ecc._phase;
+  _header.bodyPeriod = world.getBodyPeriod();
+  _header.bodyRadius = world.getBodyRadius();
+  _header.bodyDensity = world.getBodyDensity();
+
+  const auto stars = world.getStars();
+  if (stars.size() > 1) {
+    std::vector<double> companions{};
+    for (size_t i = 1; i < stars.size(); ++i) {
+      companions.insert(companions.end(),
+                        {stars[i].size, stars[i].temp, stars[i].distance,
+                         stars[i].hourOffset, stars[i].declinationOffset});
+    }
+    addSection<double>(CheckpointStarsSection, companions);
+  }
+}
+
+void circular::CheckpointWriter::_addSection(const std::string &name,
+                                             CheckpointElement element,
+                                             uint32_t elementSize,
+                                             uint64_t count,
+                                             std::vector<std::byte> &&bytes) {
+  Section s{};
+  if (name.empty() || name.size() >= sizeof(s.entry.name)) {
+    throw std::invalid_argument{"addSection: name is empty or too long"};
+  }
+  for (const auto &other : _sections) {
+    if (name == other.entry.name) {
+      throw std::invalid_argument{"addSection: duplicate section name"};
+    }
+  }
+  std::memcpy(s.entry.name, name.data(), name.size());
+  s.entry.element = static_cast<uint32_t>(element);
+  s.entry.elementSize = elementSize;
+  s.entry.count = count;
+  s.bytes = std::move(bytes);
+  _sections.push_back(std::move(s));
+}
+
+void circular::CheckpointWriter::write(const std::string &path) const {
+  // Impl: lay out the table first, so that each entry can be written with its
+  // final offset in a single forward pass over the file.
+  auto header = _header;
+  header.sectionCount = _sections.size();
+  header.sectionTableOffset = alignUp(sizeof(CheckpointHeader));
+
+  std::vector<CheckpointSectionEntry> table{};
+  table.reserve(_sections.size());
+  uint64_t offset = alignUp(header.sectionTableOffset +
+                            _sections.size() * sizeof(CheckpointSectionEntry));
+  for (const auto &s : _sections) {
+    auto entry = s.entry;
+    entry.offset = offset;
+    table.push_back(entry);
+    offset = alignUp(offset + s.bytes.size());
+  }
+
+  const std::string tmp_path = path + ".tmp";
+  {
+    std::ofstream out{tmp_path, std::ios::binary | std::ios::trunc};
+    if (!out) {
+      throw std::runtime_error{"write: could not open " + tmp_path};
+    }
+
+    const char zeros[CheckpointAlignment] = {};
+    uint64_t written = 0;
+    auto pad_to = [&](uint64_t target) {
+      out.write(zeros, static_cast<std::streamsize>(target - written));
+      written = target;
+    };
+    auto put = [&](const void *data, uint64_t size) {
+      out.write(static_cast<const char *>(data),
+                static_cast<std::streamsize>(size));
+      written += size;
+    };
+
+    put(&header, sizeof(header));
+    pad_to(header.sectionTableOffset);
+    put(table.data(), table.size() * sizeof(CheckpointSectionEntry));
+    for (size_t i = 0; i < _sections.size(); ++i) {
+      pad_to(table[i].offset);
+      put(_sections[i].bytes.data(), _sections[i].bytes.size());
+    }
+    pad_to(alignUp(written));
+
+    out.flush();
+    if (!out) {
+      throw std::runtime_error{"write: I/O error writing " + tmp_path};
+    }
+  }
+#ifdef CIRCULAR_HAS_FSYNC
+  // Impl: the data must be on disk before the rename is, or a crash could
+  // leave the new name on an empty file; and the rename itself is only
+  // durable once the directory is synced.
+  syncPath(tmp_path);
+  std::filesystem::rename(tmp_path, path);
+  const auto dir = std::filesystem::path{path}.parent_path();
+  syncPath(dir.empty() ? std::string{"."} : dir.string());
+#else
+  std::filesystem::rename(tmp_path, path);
+#endif
+}
+
+Future<> circular::CheckpointWriter::writeAsync(const std::string &path) && {
+  auto self = std::make_shared<const CheckpointWriter>(std::move(*this));
+  return Tasker::Get().Submit([self, path]() { self->write(path); },
+                              Lane::Background);
+}
+
+circular::Checkpoint::Checkpoint(const std::byte *data, uint64_t size)
+    : _data{data}, _size{size} {}
+
+circular::Checkpoint::Checkpoint(Checkpoint &&other) noexcept
+    : _data{other._data}, _size{other._size} {
+  other._data = nullptr;
+  other._size = 0;
+}
+
+Checkpoint &circular::Checkpoint::operator=(Checkpoint &&other) noexcept {
+  if (this != &other) {
+    _release();
+    _data = other._data;
+    _size = other._size;
+    other._data = nullptr;
+    other._size = 0;
+  }
+  return *this;
+}
+
+circular::Checkpoint::~Checkpoint() { _release(); }
+
+void circular::Checkpoint::_release() {
+  if (nullptr == _data) {
+    return;
+  }
+#ifdef CIRCULAR_HAS_MMAP
+  ::munmap(const_cast<std::byte *>(_data), _size);
+#else
+  ::operator delete(const_cast<std::byte *>(_data),
+                    std::align_val_t{CheckpointAlignment});
+#endif
+  _data = nullptr;
+  _size = 0;
+}
+
+Checkpoint circular::Checkpoint::open(const std::string &path) {
+#ifdef CIRCULAR_HAS_MMAP
+  int fd = ::open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    throw std::runtime_error{"open: could not open " + path};
+  }
+  struct stat st {};
+  if (::fstat(fd, &st) != 0 || st.st_size < 0 ||
+      static_cast<uint64_t>(st.st_size) < sizeof(CheckpointHeader)) {
+    ::close(fd);
+    throw std::runtime_error{"open: " + path + " is too small"};
+  }
+  auto size = static_cast<uint64_t>(st.st_size);
+  void *mapped = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  ::close(fd);
+  if (MAP_FAILED == mapped) {
+    throw std::runtime_error{"open: could not map " + path};
+  }
+  Checkpoint c{static_cast<const std::byte *>(mapped), size};
+#else
+  // Impl: no mmap on this platform, so read the file into an aligned buffer.
+  std::ifstream in{path, std::ios::binary | std::ios::ate};
+  if (!in) {
+    throw std::runtime_error{"open: could not open " + path};
+  }
+  auto size = static_cast<uint64_t>(in.tellg());
+  if (size < sizeof(CheckpointHeader)) {
+    throw std::runtime_error{"open: " + path + " is too small"};
+  }
+  auto *buffer = static_cast<std::byte *>(
+      ::operator new(size, std::align_val_t{CheckpointAlignment}));
+  Checkpoint c{buffer, size};
+  in.seekg(0);
+  in.read(reinterpret_cast<char *>(buffer), static_cast<std::streamsize>(size));
+  if (!in) {
+    throw std::runtime_error{"open: I/O error reading " + path};
+  }
+#endif
+
+  const auto &h = c._header();
+  if (std::memcmp(h.magic, CheckpointMagic, sizeof(CheckpointMagic)) != 0 ||
+      h.byteOrderMark != ByteOrderMark) {
+    throw std::runtime_error{"open: " + path + " is not a checkpoint"};
+  }
+  if (h.version != CheckpointVersion) {
+    throw std::runtime_error{"open: " + path +
+                             " has an unsupported checkpoint version"};
+  }
+  if (h.sectionTableOffset > size ||
+      h.sectionCount >
+          (size - h.sectionTableOffset) / sizeof(CheckpointSectionEntry)) {
+    throw std::runtime_error{"open: " + path + " has a truncated table"};
+  }
+  const auto *table = reinterpret_cast<const CheckpointSectionEntry *>(
+      c._data + h.sectionTableOffset);
+  for (uint64_t i = 0; i < h.sectionCount; ++i) {
+    const auto &e = table[i];
+    // Impl: section<T>() trusts the element type and count, so the size must
+    // match the type, and the whole array must lie within the file
+    const auto elementSize = elementSizeOf(e.element);
+    if (elementSize == 0 || e.elementSize != elementSize ||
+        e.offset % CheckpointAlignment != 0 || e.offset > size ||
+        e.count > (size - e.offset) / elementSize ||
+        e.name[sizeof(e.name) - 1] != '\0') {
+      throw std::runtime_error{"open: " + path + " has a corrupt section"};
+    }
+  }
+#ifdef CIRCULAR_HAS_MMAP
+  ::madvise(const_cast<std::byte *>(c._data), size, MADV_WILLNEED);
+#endif
+  return c;
+}
+
+World circular::Checkpoint::restoreWorld() const {
+  const auto &h = _header();
+  const std::string bodySection = "body";
+
+  ConfigMap options{};
+  options.set_value(bodySection, "orbit_radius", h.orbitRadius);
+  options.set_value(bodySection, "sun_size", h.sunSize);
+  options.set_value(bodySection, "sun_temp", h.sunTemp);
+  options.set_value(bodySection, "body_period", h.bodyPeriod);
+  options.set_value(bodySection, "body_radius", h.bodyRadius);
+  options.set_value(bodySection, "body_density", h.bodyDensity);
+
+  World w{options};
+  // Impl: the Harmonic goes in directly, since ecc_min/ecc_max would not
+  // round-trip its centre and amplitude exactly.
+  w.setEccentricity({param::Harmonic{h.eccCentre, h.eccAmplitude, h.eccPeriod,
+                                     h.eccPhase},
+                     "eccentricity"});
+  if (const auto *e = _tryFind(CheckpointStarsSection)) {
+    const auto companions = section<double>(CheckpointStarsSection);
+    if (e->count % 5 != 0) {
+      throw std::runtime_error{"restoreWorld: corrupt companion stars"};
+    }
+    auto stars = w.getStars();
+    for (size_t i = 0; i < companions.size(); i += 5) {
+      stars.push_back({companions[i], companions[i + 1], companions[i + 2],
+                       companions[i + 3], companions[i + 4]});
+    }
+    w.setStars(stars);
+  }
+  return w;
+}
+
+const CheckpointSectionEntry *
+circular::Checkpoint::_tryFind(const std::string &name) const {
+  const auto &h = _header();
+  const auto *table = reinterpret_cast<const CheckpointSectionEntry *>(
+      _data + h.sectionTableOffset);
+  for (uint64_t i = 0; i < h.sectionCount; ++i) {
+    if (name == table[i].name) {
+      return &table[i];
+    }
+  }
+  return nullptr;
+}
+
+const CheckpointSectionEntry &
+circular::Checkpoint::_find(const std::string &name) const {
+  const auto *e = _tryFind(name);
+  if (nullptr == e) {
+    throw std::out_of_range{"section: no section named " + name};
+  }
+  return *e;
+}
+
+bool circular::Checkpoint::hasSection(const std::string &name) const {
+  return nullptr != _tryFind(name);
+}
+
+std::vector<std::string> circular::Checkpoint::sectionNames() const {
+  const auto &h = _header();
+  const auto *table = reinterpret_cast<const CheckpointSectionEntry *>(
+      _data + h.sectionTableOffset);
+  std::vector<std::string> names{};
+  names.reserve(h.sectionCount);
+  for (uint64_t i = 0; i < h.sectionCount; ++i) {
+    names.emplace_back(table[i].name);
+  }
+  return names;
+}
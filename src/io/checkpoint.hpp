@@ -0,0 +1,204 @@
+/**
+ * @file checkpoint.hpp
+ * @author Alex Laing (livingearthcompany@gmail.com)
+ * @brief A binary checkpoint/restart format for World and bulk simulation
+ * arrays.
+ *
+ * A checkpoint file is laid out as:
+ * 1. a fixed-size CheckpointHeader, holding a format version, the step/time of
+ * the checkpoint, and the World primaries;
+ * 2. a table of CheckpointSectionEntry, one per named array; and
+ * 3. the raw array sections, each aligned to CheckpointAlignment bytes.
+ *
+ * Everything is stored in native byte order; the header records a byte order
+ * mark so that foreign files are rejected rather than misread.
+ */
+
+#pragma once
+
+#include <circular/tasker.hpp>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "../stat/world.hpp"
+
+namespace circular {
+
+const inline uint32_t CheckpointVersion = 1;
+const inline uint64_t CheckpointAlignment = 64; // [bytes]
+/// @brief The section holding a World's companion stars, if it has any, as
+/// size, temp, distance, hourOffset and declinationOffset for each.
+const inline std::string CheckpointStarsSection = "world.stars";
+
+/// @brief The element type of a checkpoint section.
+enum class CheckpointElement : uint32_t {
+  Float64 = 1,
+  Float32 = 2,
+  Int64 = 3,
+  Int32 = 4,
+};
+
+template <typename T> struct CheckpointElementOf;
+template <> struct CheckpointElementOf<double> {
+  static constexpr auto value = CheckpointElement::Float64;
+};
+template <> struct CheckpointElementOf<float> {
+  static constexpr auto value = CheckpointElement::Float32;
+};
+template <> struct CheckpointElementOf<int64_t> {
+  static constexpr auto value = CheckpointElement::Int64;
+};
+template <> struct CheckpointElementOf<int32_t> {
+  static constexpr auto value = CheckpointElement::Int32;
+};
+
+struct CheckpointHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t byteOrderMark;
+  uint64_t step;
+  double time;
+  // World primaries
+  double orbitRadius;
+  double sunSize;
+  double sunTemp;
+  double eccCentre;
+  double eccAmplitude;
+  double eccPeriod;
+  double eccPhase;
+  double bodyPeriod;
+  double bodyRadius;
+  double bodyDensity;
+  // Section table
+  uint64_t sectionCount;
+  uint64_t sectionTableOffset;
+};
+
+struct CheckpointSectionEntry {
+  char name[48];
+  uint32_t element;
+  uint32_t elementSize;
+  uint64_t offset; // from the start of the file
+  uint64_t count;  // in elements, not bytes
+};
+
+/**
+ * @brief Collects a World and a set of named arrays, and writes them out as a
+ * checkpoint file.
+ *
+ * Sections are copied into the writer when added, so the caller may keep
+ * mutating its own arrays while an asynchronous write is in flight.
+ */
+class CheckpointWriter {
+public:
+  CheckpointWriter() = delete;
+  /// @brief World's companion stars, if any, go in CheckpointStarsSection.
+  CheckpointWriter(const World &world, uint64_t step = 0, double time = 0.0);
+
+  /// @brief Add a named array to the checkpoint.
+  /// @param name At most 47 characters, and unique within the checkpoint.
+  /// @param data The values to be copied into the checkpoint.
+  ///
+  /// Throws std::invalid_argument if the name is too long or already taken.
+  template <typename T>
+  void addSection(const std::string &name, std::span<const T> data) {
+    const auto *bytes = reinterpret_cast<const std::byte *>(data.data());
+    _addSection(name, CheckpointElementOf<T>::value, sizeof(T), data.size(),
+                std::vector<std::byte>(bytes, bytes + data.size_bytes()));
+  }
+
+  /// @brief Write the checkpoint, blocking until it is on disk.
+  /// @param path The file to be (over)written.
+  ///
+  /// The file is written under a temporary name, synced, and then renamed,
+  /// and the rename is synced too, so an interrupted write or a crash never
+  /// clobbers the previous checkpoint. (Without POSIX fsync, the file is only
+  /// flushed.) Throws std::runtime_error on I/O failure.
+  void write(const std::string &path) const;
+
+  /// @brief Write the checkpoint on a Background lane worker, consuming the
+  /// writer. Tasker::CancelBackground() before it starts skips the write.
+  /// @param path The file to be (over)written.
+  /// @return a Future that becomes ready once the write has finished, and
+  /// whose get() rethrows any I/O error.
+  Future<> writeAsync(const std::string &path) &&;
+
+private:
+  struct Section {
+    CheckpointSectionEntry entry;
+    std::vector<std::byte> bytes;
+  };
+
+  void _addSection(const std::string &name, CheckpointElement element,
+                   uint32_t elementSize, uint64_t count,
+                   std::vector<std::byte> &&bytes);
+
+  CheckpointHeader _header;
+  std::vector<Section> _sections;
+};
+
+/**
+ * @brief A read-only view of a checkpoint file.
+ *
+ * The file is memory-mapped, so opening a checkpoint only reads the header and
+ * section table; array sections are paged in as they are touched. Spans
+ * returned by section() point straight into the mapping and are valid for as
+ * long as the Checkpoint is alive.
+ */
+class Checkpoint {
+public:
+  Checkpoint() = delete;
+  Checkpoint(const Checkpoint &) = delete;
+  Checkpoint &operator=(const Checkpoint &) = delete;
+  Checkpoint(Checkpoint &&) noexcept;
+  Checkpoint &operator=(Checkpoint &&) noexcept;
+  ~Checkpoint();
+
+  /// @brief Map a checkpoint file into memory.
+  /// @param path The relative or absolute path of the checkpoint.
+  ///
+  /// Throws std::runtime_error if the file cannot be mapped, or is not a
+  /// checkpoint of a compatible version.
+  static Checkpoint open(const std::string &path);
+
+  uint32_t version() const { return _header().version; }
+  uint64_t step() const { return _header().step; }
+  double time() const { return _header().time; }
+
+  /// @brief Rebuild the World stored in the checkpoint.
+  World restoreWorld() const;
+
+  bool hasSection(const std::string &name) const;
+  std::vector<std::string> sectionNames() const;
+
+  /// @brief A zero-copy view of a named array.
+  ///
+  /// Throws std::out_of_range if there is no such section, and
+  /// std::invalid_argument if it does not hold elements of type T.
+  template <typename T> std::span<const T> section(const std::string &name) const {
+    const auto &e = _find(name);
+    if (e.element != static_cast<uint32_t>(CheckpointElementOf<T>::value)) {
+      throw std::invalid_argument{"section: element type mismatch"};
+    }
+    return {reinterpret_cast<const T *>(_data + e.offset), e.count};
+  }
+
+private:
+  Checkpoint(const std::byte *data, uint64_t size);
+
+  const CheckpointHeader &_header() const {
+    return *reinterpret_cast<const CheckpointHeader *>(_data);
+  }
+  const CheckpointSectionEntry *_tryFind(const std::string &name) const;
+  const CheckpointSectionEntry &_find(const std::string &name) const;
+  void _release();
+
+  const std::byte *_data{nullptr};
+  uint64_t _size{0};
+};
+} // namespace circular
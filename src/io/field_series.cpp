@@ -0,0 +1,602 @@
+#include "field_series.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <circular/trace.hpp>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <stdexcept>
+
+using namespace circular;
+
+namespace {
+const char SeriesMagic[8] = {'C', 'I', 'R', 'C', 'F', 'L', 'D', 'S'};
+const char IndexMagic[8] = {'C', 'I', 'R', 'C', 'F', 'I', 'D', 'X'};
+const uint32_t ChunkMagic = 0x4B4E4843; // "CHNK"
+const uint32_t ByteOrderMark = 0x01020304;
+
+// Impl: quantised values are kept to within 2^40 quanta, so that the
+// rounding of q * quantum is a few thousandths of a quantum at most; the
+// quantum is a little under twice the tolerance to leave room for it
+const double QuantisedLimit = 1099511627776.0; // 2^40
+const double QuantumPerTolerance = 2.0 * (1.0 - 1.0 / 512.0);
+
+void checkOptions(const FieldSeriesOptions &options) {
+  if (options.chunkSteps == 0) {
+    throw std::invalid_argument{"FieldSeriesWriter: chunkSteps must be at "
+                                "least 1"};
+  }
+  if (!(options.tolerance >= 0.0) || !std::isfinite(options.tolerance)) {
+    throw std::invalid_argument{"FieldSeriesWriter: tolerance must be "
+                                "non-negative and finite"};
+  }
+}
+
+uint64_t zigzag(uint64_t d) {
+  return (d << 1) ^ static_cast<uint64_t>(static_cast<int64_t>(d) >> 63);
+}
+
+uint64_t unzigzag(uint64_t z) { return (z >> 1) ^ (0 - (z & 1)); }
+
+/// @brief Difference each step against the one before, and the first step
+/// across the field, then zigzag the differences so that small negative ones
+/// have small encodings too.
+void deltaEncode(std::vector<uint64_t> &words, uint64_t fieldSize) {
+  for (auto i = words.size(); i-- > fieldSize;) {
+    words[i] -= words[i - fieldSize];
+  }
+  for (auto k = std::min<uint64_t>(fieldSize, words.size()); k-- > 1;) {
+    words[k] -= words[k - 1];
+  }
+  for (auto &w : words) {
+    w = zigzag(w);
+  }
+}
+
+void deltaDecode(std::vector<uint64_t> &words, uint64_t fieldSize) {
+  for (auto &w : words) {
+    w = unzigzag(w);
+  }
+  for (uint64_t k = 1; k < std::min<uint64_t>(fieldSize, words.size()); ++k) {
+    words[k] += words[k - 1];
+  }
+  for (auto i = fieldSize; i < words.size(); ++i) {
+    words[i] += words[i - fieldSize];
+  }
+}
+
+/// @brief Runs of 3 to 130 equal bytes as a control byte of 125 + length and
+/// the byte; anything else as literals, a control byte of length - 1 (up to
+/// 128) and the bytes.
+void runLengthEncode(const std::vector<uint8_t> &bytes,
+                     std::vector<uint8_t> &out) {
+  const auto runAt = [&](size_t i) {
+    size_t r = 1;
+    while (i + r < bytes.size() && r < 130 && bytes[i + r] == bytes[i]) {
+      ++r;
+    }
+    return r;
+  };
+  size_t i = 0;
+  while (i < bytes.size()) {
+    const auto run = runAt(i);
+    if (run >= 3) {
+      out.push_back(static_cast<uint8_t>(125 + run));
+      out.push_back(bytes[i]);
+      i += run;
+      continue;
+    }
+    auto end = i + run;
+    while (end < bytes.size() && end - i < 128 && runAt(end) < 3) {
+      ++end;
+    }
+    end = std::min(end, i + 128);
+    out.push_back(static_cast<uint8_t>(end - i - 1));
+    out.insert(out.end(), bytes.begin() + static_cast<ptrdiff_t>(i),
+               bytes.begin() + static_cast<ptrdiff_t>(end));
+    i = end;
+  }
+}
+
+/// @brief The most bytes that one byte of runLengthEncode's output decodes to:
+/// a run of 130 from two bytes.
+constexpr uint64_t MaxRunLengthExpansion = 65;
+
+void runLengthDecode(std::span<const uint8_t> in, std::vector<uint8_t> &bytes) {
+  size_t i = 0;
+  size_t o = 0;
+  while (i < in.size()) {
+    const auto c = in[i++];
+    const size_t n = (c < 128) ? c + 1 : c - 125;
+    if (o + n > bytes.size() || i + ((c < 128) ? n : 1) > in.size()) {
+      throw std::runtime_error{"FieldSeriesReader: corrupt chunk"};
+    }
+    if (c < 128) {
+      std::copy_n(in.begin() + static_cast<ptrdiff_t>(i), n,
+                  bytes.begin() + static_cast<ptrdiff_t>(o));
+      i += n;
+    } else {
+      std::fill_n(bytes.begin() + static_cast<ptrdiff_t>(o), n, in[i++]);
+    }
+    o += n;
+  }
+  if (o != bytes.size()) {
+    throw std::runtime_error{"FieldSeriesReader: corrupt chunk"};
+  }
+}
+
+/// @brief The header (less offsets) and payload of a chunk of steps.
+void encodeChunk(std::span<const double> values, uint64_t fieldSize,
+                 double tolerance, FieldChunkHeader &header,
+                 std::vector<uint8_t> &payload) {
+  std::vector<uint64_t> words(values.size());
+  header.codec = static_cast<uint32_t>(FieldCodec::Delta);
+  header.quantum = 0.0;
+  bool quantisable = tolerance > 0.0;
+  const auto quantum = tolerance * QuantumPerTolerance;
+  for (size_t i = 0; i < values.size() && quantisable; ++i) {
+    quantisable = std::abs(values[i] / quantum) < QuantisedLimit;
+  }
+  if (quantisable) {
+    header.codec = static_cast<uint32_t>(FieldCodec::Quantised);
+    header.quantum = quantum;
+    for (size_t i = 0; i < values.size(); ++i) {
+      words[i] = static_cast<uint64_t>(std::llround(values[i] / quantum));
+    }
+  } else {
+    for (size_t i = 0; i < values.size(); ++i) {
+      words[i] = std::bit_cast<uint64_t>(values[i]);
+    }
+  }
+  deltaEncode(words, fieldSize);
+
+  // Impl: byte b of every word, then byte b + 1, so that the high bytes of
+  // small differences make long runs of zeros
+  const auto n = words.size();
+  std::vector<uint8_t> shuffled(n * sizeof(uint64_t));
+  for (size_t b = 0; b < sizeof(uint64_t); ++b) {
+    for (size_t i = 0; i < n; ++i) {
+      shuffled[b * n + i] = static_cast<uint8_t>(words[i] >> (8 * b));
+    }
+  }
+  payload.clear();
+  runLengthEncode(shuffled, payload);
+}
+
+void decodeChunk(const FieldChunkHeader &header,
+                 std::span<const uint8_t> payload, uint64_t fieldSize,
+                 std::vector<double> &values) {
+  const auto n = header.steps * fieldSize;
+  std::vector<uint8_t> shuffled(n * sizeof(uint64_t));
+  runLengthDecode(payload, shuffled);
+  std::vector<uint64_t> words(n, 0);
+  for (size_t b = 0; b < sizeof(uint64_t); ++b) {
+    for (size_t i = 0; i < n; ++i) {
+      words[i] |= static_cast<uint64_t>(shuffled[b * n + i]) << (8 * b);
+    }
+  }
+  deltaDecode(words, fieldSize);
+
+  values.resize(n);
+  if (header.codec == static_cast<uint32_t>(FieldCodec::Quantised)) {
+    for (size_t i = 0; i < n; ++i) {
+      values[i] = static_cast<double>(static_cast<int64_t>(words[i])) *
+                  header.quantum;
+    }
+  } else if (header.codec == static_cast<uint32_t>(FieldCodec::Delta)) {
+    for (size_t i = 0; i < n; ++i) {
+      values[i] = std::bit_cast<double>(words[i]);
+    }
+  } else {
+    throw std::runtime_error{"FieldSeriesReader: unknown chunk codec"};
+  }
+}
+
+template <typename T> bool readRaw(std::ifstream &in, T &value) {
+  return static_cast<bool>(
+      in.read(reinterpret_cast<char *>(&value), sizeof(T)));
+}
+
+void readHeader(std::ifstream &in, const std::string &path,
+                FieldSeriesHeader &header) {
+  if (!readRaw(in, header) ||
+      std::memcmp(header.magic, SeriesMagic, sizeof(SeriesMagic)) != 0 ||
+      header.byteOrderMark != ByteOrderMark ||
+      header.name[sizeof(header.name) - 1] != '\0') {
+    throw std::runtime_error{path + " is not a field series"};
+  }
+  if (header.version != FieldSeriesVersion) {
+    throw std::runtime_error{path + " has an unsupported field series version"};
+  }
+  if (header.fieldSize == 0) {
+    throw std::runtime_error{path + " has an empty field"};
+  }
+}
+
+/// @brief The chunks of a series, and where the last complete one ends.
+struct Index {
+  std::vector<FieldChunkEntry> entries;
+  uint64_t end = sizeof(FieldSeriesHeader);
+};
+
+/// @brief The index written on closing, if it is intact.
+bool readWrittenIndex(std::ifstream &in, uint64_t size, Index &index) {
+  FieldSeriesTrailer trailer{};
+  if (size < sizeof(FieldSeriesHeader) + sizeof(trailer)) {
+    return false;
+  }
+  const auto trailerOffset = size - sizeof(trailer);
+  in.seekg(static_cast<std::streamoff>(trailerOffset));
+  if (!readRaw(in, trailer) ||
+      std::memcmp(trailer.magic, IndexMagic, sizeof(IndexMagic)) != 0 ||
+      trailer.indexOffset < sizeof(FieldSeriesHeader) ||
+      trailer.indexOffset > trailerOffset ||
+      (trailerOffset - trailer.indexOffset) / sizeof(FieldChunkEntry) !=
+          trailer.chunkCount ||
+      (trailerOffset - trailer.indexOffset) % sizeof(FieldChunkEntry) != 0) {
+    return false;
+  }
+  index.entries.resize(trailer.chunkCount);
+  in.seekg(static_cast<std::streamoff>(trailer.indexOffset));
+  in.read(reinterpret_cast<char *>(index.entries.data()),
+          static_cast<std::streamsize>(trailer.chunkCount *
+                                       sizeof(FieldChunkEntry)));
+  // Impl: as the header walk below, each chunk's header and times must fit
+  // before the next chunk (or the index), so that no entry can claim more
+  // steps than the file holds
+  uint64_t step = 0;
+  for (size_t i = 0; i < index.entries.size(); ++i) {
+    const auto &e = index.entries[i];
+    const auto limit = i + 1 < index.entries.size()
+                           ? index.entries[i + 1].offset
+                           : trailer.indexOffset;
+    if (e.firstStep != step || e.steps == 0 ||
+        e.offset < sizeof(FieldSeriesHeader) || e.offset > limit ||
+        limit - e.offset < sizeof(FieldChunkHeader) ||
+        e.steps > (limit - e.offset - sizeof(FieldChunkHeader)) /
+                      sizeof(double)) {
+      return false;
+    }
+    step += e.steps;
+  }
+  index.end = trailer.indexOffset;
+  return static_cast<bool>(in);
+}
+
+/// @brief The index of a series, from its trailer or else by walking its
+/// chunk headers up to the first incomplete one.
+Index readIndex(std::ifstream &in, uint64_t size) {
+  Index index{};
+  if (readWrittenIndex(in, size, index)) {
+    return index;
+  }
+  in.clear();
+  index = Index{};
+  uint64_t step = 0;
+  while (true) {
+    FieldChunkHeader header{};
+    in.seekg(static_cast<std::streamoff>(index.end));
+    if (size - index.end < sizeof(header) || !readRaw(in, header) ||
+        header.magic != ChunkMagic || header.firstStep != step ||
+        header.steps == 0) {
+      break;
+    }
+    const auto left = size - index.end - sizeof(header);
+    if (header.steps > left / sizeof(double) ||
+        header.payloadBytes > left - header.steps * sizeof(double)) {
+      break;
+    }
+    index.entries.push_back({index.end, step, header.steps});
+    index.end += sizeof(header) + header.steps * sizeof(double) +
+                 header.payloadBytes;
+    step += header.steps;
+  }
+  in.clear();
+  return index;
+}
+
+uint64_t fileSize(std::ifstream &in) {
+  in.seekg(0, std::ios::end);
+  return static_cast<uint64_t>(in.tellg());
+}
+} // namespace
+
+circular::FieldSeriesWriter::FieldSeriesWriter(const std::string &path,
+                                               const std::string &name,
+                                               uint64_t fieldSize,
+                                               FieldSeriesOptions options,
+                                               Tasker &tasker)
+    : _sink{std::make_shared<Sink>()}, _name{name}, _fieldSize{fieldSize},
+      _options{options}, _tasker{&tasker} {
+  FieldSeriesHeader header{};
+  if (name.size() >= sizeof(header.name)) {
+    throw std::invalid_argument{"FieldSeriesWriter: name is too long"};
+  }
+  if (fieldSize == 0) {
+    throw std::invalid_argument{"FieldSeriesWriter: fieldSize must be at "
+                                "least 1"};
+  }
+  checkOptions(options);
+
+  std::memcpy(header.magic, SeriesMagic, sizeof(SeriesMagic));
+  header.version = FieldSeriesVersion;
+  header.byteOrderMark = ByteOrderMark;
+  header.fieldSize = fieldSize;
+  std::memcpy(header.name, name.data(), name.size());
+
+  _sink->path = path;
+  _sink->out.open(path, std::ios::binary | std::ios::trunc);
+  _sink->out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+  if (!_sink->out) {
+    throw std::runtime_error{"FieldSeriesWriter: could not open " + path};
+  }
+  _sink->end = sizeof(header);
+}
+
+circular::FieldSeriesWriter::FieldSeriesWriter(std::shared_ptr<Sink> sink,
+                                               std::string name,
+                                               uint64_t fieldSize,
+                                               uint64_t firstStep,
+                                               FieldSeriesOptions options,
+                                               Tasker &tasker)
+    : _sink{std::move(sink)}, _name{std::move(name)}, _fieldSize{fieldSize},
+      _options{options}, _tasker{&tasker} {
+  _filling.firstStep = firstStep;
+}
+
+FieldSeriesWriter
+circular::FieldSeriesWriter::reopen(const std::string &path,
+                                    FieldSeriesOptions options,
+                                    Tasker &tasker) {
+  checkOptions(options);
+  FieldSeriesHeader header{};
+  Index index{};
+  {
+    std::ifstream in{path, std::ios::binary};
+    if (!in) {
+      throw std::runtime_error{"FieldSeriesWriter: could not open " + path};
+    }
+    readHeader(in, path, header);
+    index = readIndex(in, fileSize(in));
+  }
+
+  // Impl: drop the index (or a torn chunk), to be rewritten on closing
+  std::filesystem::resize_file(path, index.end);
+  auto sink = std::make_shared<Sink>();
+  sink->path = path;
+  sink->out.open(path, std::ios::binary | std::ios::in | std::ios::out);
+  sink->out.seekp(static_cast<std::streamoff>(index.end));
+  if (!sink->out) {
+    throw std::runtime_error{"FieldSeriesWriter: could not open " + path};
+  }
+  sink->end = index.end;
+  sink->index = std::move(index.entries);
+  const auto firstStep =
+      sink->index.empty()
+          ? 0
+          : sink->index.back().firstStep + sink->index.back().steps;
+  return FieldSeriesWriter{std::move(sink), header.name, header.fieldSize,
+                           firstStep, options, tasker};
+}
+
+circular::FieldSeriesWriter::~FieldSeriesWriter() {
+  try {
+    close();
+  } catch (...) {
+  }
+}
+
+uint64_t circular::FieldSeriesWriter::steps() const {
+  return _filling.firstStep + _filling.times.size();
+}
+
+void circular::FieldSeriesWriter::append(double time,
+                                         std::span<const double> values) {
+  if (nullptr == _sink) {
+    throw std::logic_error{"FieldSeriesWriter::append: writer is closed"};
+  }
+  if (values.size() != _fieldSize) {
+    throw std::invalid_argument{
+        "FieldSeriesWriter::append: values are not fieldSize long"};
+  }
+  _throwIfFailed();
+  if (_filling.times.empty()) {
+    _filling.times.reserve(_options.chunkSteps);
+    _filling.values.reserve(_options.chunkSteps * _fieldSize);
+  }
+  _filling.times.push_back(time);
+  _filling.values.insert(_filling.values.end(), values.begin(), values.end());
+  if (_filling.times.size() >= _options.chunkSteps) {
+    _handOver();
+  }
+}
+
+void circular::FieldSeriesWriter::_wait() {
+  if (!_inFlight.valid()) {
+    return;
+  }
+  try {
+    _spare = _inFlight.get();
+  } catch (...) {
+    // Impl: the chunk is lost, so nothing after it may be written
+    _error = std::current_exception();
+    throw;
+  }
+}
+
+void circular::FieldSeriesWriter::_throwIfFailed() const {
+  if (_error) {
+    std::rethrow_exception(_error);
+  }
+}
+
+void circular::FieldSeriesWriter::_handOver() {
+  if (_filling.times.empty()) {
+    return;
+  }
+  // Impl: at most one chunk in flight, so chunks reach the file in order and
+  // the writer holds two buffers, the one filling and the one being written
+  _wait();
+  _throwIfFailed();
+  const auto nextStep = steps();
+  _inFlight = _tasker->SubmitUncancellable(
+      [sink = _sink, chunk = std::move(_filling), fieldSize = _fieldSize,
+       tolerance = _options.tolerance]() mutable {
+        CIRCULAR_TRACE_ZONE("FieldSeriesWriter::write");
+        FieldChunkHeader header{};
+        std::vector<uint8_t> payload{};
+        encodeChunk(chunk.values, fieldSize, tolerance, header, payload);
+        header.magic = ChunkMagic;
+        header.firstStep = chunk.firstStep;
+        header.steps = chunk.times.size();
+        header.payloadBytes = payload.size();
+
+        auto &out = sink->out;
+        out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        out.write(reinterpret_cast<const char *>(chunk.times.data()),
+                  static_cast<std::streamsize>(chunk.times.size() *
+                                               sizeof(double)));
+        out.write(reinterpret_cast<const char *>(payload.data()),
+                  static_cast<std::streamsize>(payload.size()));
+        // Impl: flushed chunk by chunk, so that a run which dies leaves every
+        // complete chunk readable
+        out.flush();
+        if (!out) {
+          throw std::runtime_error{"FieldSeriesWriter: I/O error writing " +
+                                   sink->path};
+        }
+        sink->index.push_back({sink->end, header.firstStep, header.steps});
+        sink->end += sizeof(header) + chunk.times.size() * sizeof(double) +
+                     payload.size();
+
+        chunk.times.clear();
+        chunk.values.clear();
+        return std::move(chunk);
+      },
+      Lane::Background);
+  _filling = std::move(_spare);
+  _spare = Chunk{};
+  _filling.firstStep = nextStep;
+  _filling.times.clear();
+  _filling.values.clear();
+}
+
+void circular::FieldSeriesWriter::flush() {
+  if (nullptr == _sink) {
+    return;
+  }
+  _throwIfFailed();
+  _handOver();
+  _wait();
+}
+
+void circular::FieldSeriesWriter::close() {
+  if (nullptr == _sink) {
+    return;
+  }
+  try {
+    flush();
+  } catch (...) {
+    // Impl: without an index, readers recover the chunks before the failure
+    _sink = nullptr;
+    throw;
+  }
+  auto sink = std::move(_sink);
+  FieldSeriesTrailer trailer{};
+  trailer.indexOffset = sink->end;
+  trailer.chunkCount = sink->index.size();
+  std::memcpy(trailer.magic, IndexMagic, sizeof(IndexMagic));
+  sink->out.write(reinterpret_cast<const char *>(sink->index.data()),
+                  static_cast<std::streamsize>(sink->index.size() *
+                                               sizeof(FieldChunkEntry)));
+  sink->out.write(reinterpret_cast<const char *>(&trailer), sizeof(trailer));
+  sink->out.close();
+  if (!sink->out) {
+    throw std::runtime_error{"FieldSeriesWriter: I/O error writing " +
+                             sink->path};
+  }
+}
+
+circular::FieldSeriesReader::FieldSeriesReader(const std::string &path)
+    : _path{path}, _in{path, std::ios::binary} {
+  if (!_in) {
+    throw std::runtime_error{"FieldSeriesReader: could not open " + path};
+  }
+  FieldSeriesHeader header{};
+  readHeader(_in, path, header);
+  _name = header.name;
+  _fieldSize = header.fieldSize;
+  auto index = readIndex(_in, fileSize(_in));
+  _index = std::move(index.entries);
+  _end = index.end;
+  _steps = _index.empty() ? 0 : _index.back().firstStep + _index.back().steps;
+}
+
+void circular::FieldSeriesReader::_load(uint64_t step) {
+  if (step >= _steps) {
+    throw std::out_of_range{"FieldSeriesReader: no such step"};
+  }
+  const auto it = std::upper_bound(
+      _index.begin(), _index.end(), step,
+      [](uint64_t s, const FieldChunkEntry &e) { return s < e.firstStep; });
+  const auto chunk = static_cast<size_t>(it - _index.begin()) - 1;
+  if (chunk == _cached) {
+    return;
+  }
+  CIRCULAR_TRACE_ZONE("FieldSeriesReader::load");
+  _cached = SIZE_MAX;
+
+  const auto &entry = _index[chunk];
+  const auto limit =
+      chunk + 1 < _index.size() ? _index[chunk + 1].offset : _end;
+  FieldChunkHeader header{};
+  _in.clear();
+  _in.seekg(static_cast<std::streamoff>(entry.offset));
+  // Impl: the index bounds the times; the payload must fit too, and decode
+  // to no more than it could, before anything is allocated for them
+  const auto left = limit - entry.offset - sizeof(header);
+  if (!readRaw(_in, header) || header.magic != ChunkMagic ||
+      header.firstStep != entry.firstStep || header.steps != entry.steps ||
+      header.payloadBytes > left - header.steps * sizeof(double) ||
+      header.steps > header.payloadBytes * MaxRunLengthExpansion /
+                         sizeof(uint64_t) / _fieldSize) {
+    throw std::runtime_error{"FieldSeriesReader: corrupt chunk in " + _path};
+  }
+  _times.resize(header.steps);
+  std::vector<uint8_t> payload(header.payloadBytes);
+  _in.read(reinterpret_cast<char *>(_times.data()),
+           static_cast<std::streamsize>(header.steps * sizeof(double)));
+  _in.read(reinterpret_cast<char *>(payload.data()),
+           static_cast<std::streamsize>(payload.size()));
+  if (!_in) {
+    throw std::runtime_error{"FieldSeriesReader: truncated chunk in " +
+                             _path};
+  }
+  decodeChunk(header, payload, _fieldSize, _values);
+  _cached = chunk;
+}
+
+double circular::FieldSeriesReader::time(uint64_t step) {
+  _load(step);
+  return _times[step - _index[_cached].firstStep];
+}
+
+double circular::FieldSeriesReader::read(uint64_t step,
+                                         std::span<double> values) {
+  if (values.size() != _fieldSize) {
+    throw std::invalid_argument{
+        "FieldSeriesReader::read: values are not fieldSize long"};
+  }
+  _load(step);
+  const auto offset = (step - _index[_cached].firstStep) * _fieldSize;
+  std::copy_n(_values.begin() + static_cast<ptrdiff_t>(offset), _fieldSize,
+              values.begin());
+  return _times[step - _index[_cached].firstStep];
+}
+
+std::vector<double> circular::FieldSeriesReader::read(uint64_t step) {
+  std::vector<double> values(_fieldSize);
+  read(step, values);
+  return values;
+}
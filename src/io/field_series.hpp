@@ -0,0 +1,245 @@
+/**
+ * @file field_series.hpp
+ * @author Alex Laing (livingearthcompany@gmail.com)
+ * @brief A compressed, chunked format for the time series of a field, e.g.
+ * the per-step diagnostics of a long run, which can be appended to and read
+ * back at any step.
+ *
+ * A field series file is laid out as:
+ * 1. a fixed-size FieldSeriesHeader, holding a format version, the field's
+ * name and its size in values;
+ * 2. chunks of consecutive steps, each a FieldChunkHeader, the time of each
+ * step, and the compressed values; and
+ * 3. once the writer is closed, an index of FieldChunkEntry, one per chunk,
+ * and a FieldSeriesTrailer which locates it.
+ *
+ * Readers seek through the index. A file whose writer never closed has no
+ * index, and its complete chunks are found by walking the chunk headers
+ * instead.
+ *
+ * Values are compressed losslessly: each step is differenced against the
+ * step before it in the chunk (the first, across the field), as integers, the
+ * bytes of the differences are shuffled so that bytes of equal significance
+ * are adjacent, and runs of equal bytes are encoded. With a tolerance, values
+ * are first quantised to multiples of twice the tolerance, which bounds the
+ * error and leaves far fewer significant bits.
+ *
+ * Everything is stored in native byte order; the header records a byte order
+ * mark so that foreign files are rejected rather than misread.
+ */
+
+#pragma once
+
+#include <circular/tasker.hpp>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <span>
+#include <string>
+#include <vector>
+
+namespace circular {
+
+const inline uint32_t FieldSeriesVersion = 1;
+
+/// @brief How a chunk's values are encoded.
+enum class FieldCodec : uint32_t {
+  Delta = 1,     // lossless
+  Quantised = 2, // to within a tolerance, then as Delta
+};
+
+struct FieldSeriesHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t byteOrderMark;
+  uint64_t fieldSize; // in values, per step
+  char name[40];
+};
+
+struct FieldChunkHeader {
+  uint32_t magic;
+  uint32_t codec;
+  uint64_t firstStep;
+  uint64_t steps;
+  uint64_t payloadBytes; // the compressed values, after the times
+  double quantum;        // the quantisation step, if Quantised
+};
+
+struct FieldChunkEntry {
+  uint64_t offset; // of the FieldChunkHeader, from the start of the file
+  uint64_t firstStep;
+  uint64_t steps;
+};
+
+struct FieldSeriesTrailer {
+  uint64_t indexOffset;
+  uint64_t chunkCount;
+  char magic[8];
+};
+
+/**
+ * @brief How a FieldSeriesWriter chunks and compresses.
+ *
+ * A tolerance of 0 is lossless; otherwise each value read back is within
+ * tolerance of the value written. Chunks holding values that cannot be
+ * quantised (infinities, NaNs, or too large for the tolerance) are stored
+ * losslessly instead.
+ */
+struct FieldSeriesOptions {
+  uint64_t chunkSteps = 32;
+  double tolerance = 0.0;
+
+  bool operator==(const FieldSeriesOptions &) const = default;
+};
+
+/**
+ * @brief Appends the steps of a field to a field series file.
+ *
+ * Steps are copied into the chunk being filled. A full chunk is handed to a
+ * Background lane worker of the writer's Tasker to be compressed and written,
+ * while the next fills in a second buffer, so append() only waits for the
+ * disk if a whole chunk's worth of steps has come and gone before the
+ * previous chunk is written. The writes cannot be cancelled (e.g. by
+ * Tasker::CancelBackground()), since a lost chunk would leave a gap.
+ *
+ * An I/O error in the background is rethrown by the next call which waits,
+ * and by every call after it: no further chunk is written, and close() does
+ * not write the index, so the file keeps the complete chunks before the
+ * failure, which a FieldSeriesReader recovers as for an unclosed file.
+ */
+class FieldSeriesWriter {
+public:
+  FieldSeriesWriter() = delete;
+  FieldSeriesWriter(const FieldSeriesWriter &) = delete;
+  FieldSeriesWriter &operator=(const FieldSeriesWriter &) = delete;
+  FieldSeriesWriter(FieldSeriesWriter &&) = default;
+  FieldSeriesWriter &operator=(FieldSeriesWriter &&) = default;
+
+  /// @brief Start a new series, (over)writing path.
+  /// @param name At most 39 characters.
+  /// @param fieldSize The number of values in each step.
+  /// @param tasker Writes chunks on its Background lane; must outlive the
+  /// writer.
+  ///
+  /// Throws std::invalid_argument if the name is too long, fieldSize or
+  /// options.chunkSteps is 0, or options.tolerance is negative or not
+  /// finite, and std::runtime_error if the file cannot be opened.
+  FieldSeriesWriter(const std::string &path, const std::string &name,
+                    uint64_t fieldSize, FieldSeriesOptions options = {},
+                    Tasker &tasker = Tasker::Get());
+
+  /// @brief Continue the series in path, after its last complete chunk,
+  /// e.g. on restarting a run. Throws as the constructor, and
+  /// std::runtime_error if path is not a field series.
+  static FieldSeriesWriter reopen(const std::string &path,
+                                  FieldSeriesOptions options = {},
+                                  Tasker &tasker = Tasker::Get());
+
+  /// @brief Closes the series, but swallows any error; call close() to see
+  /// them.
+  ~FieldSeriesWriter();
+
+  /// @brief Add the next step. Throws std::invalid_argument if values is not
+  /// fieldSize() long, and std::logic_error if the writer is closed.
+  void append(double time, std::span<const double> values);
+
+  /// @brief Write out every step appended so far, including a partly filled
+  /// chunk, and wait until they are.
+  void flush();
+
+  /// @brief Flush, then write the index. Idempotent. Throws
+  /// std::runtime_error on I/O failure, including that of an earlier
+  /// background write.
+  void close();
+
+  const std::string &name() const { return _name; }
+  uint64_t fieldSize() const { return _fieldSize; }
+  /// @brief The number of steps in the series, including those not yet
+  /// written.
+  uint64_t steps() const;
+
+private:
+  /// @brief The steps of a chunk, in time-major order.
+  struct Chunk {
+    uint64_t firstStep = 0;
+    std::vector<double> times;
+    std::vector<double> values;
+  };
+
+  /// @brief The open file, shared with the background write in flight.
+  struct Sink {
+    std::string path;
+    std::ofstream out;
+    uint64_t end = 0;
+    std::vector<FieldChunkEntry> index;
+  };
+
+  FieldSeriesWriter(std::shared_ptr<Sink> sink, std::string name,
+                    uint64_t fieldSize, uint64_t firstStep,
+                    FieldSeriesOptions options, Tasker &tasker);
+
+  void _handOver();
+  void _wait();
+  void _throwIfFailed() const;
+
+  std::shared_ptr<Sink> _sink;
+  std::string _name;
+  uint64_t _fieldSize = 0;
+  FieldSeriesOptions _options;
+  Chunk _filling;
+  Chunk _spare; // the buffer back from the last background write
+  Future<Chunk> _inFlight;
+  Tasker *_tasker = nullptr;
+  std::exception_ptr _error; // of a background write; the writer is unusable
+};
+
+/**
+ * @brief Reads steps back from a field series file.
+ *
+ * Opening reads the header and the index, so finding any step is a binary
+ * search and a seek. The last chunk read is kept decoded, so that reading the
+ * steps in order decodes each chunk once.
+ */
+class FieldSeriesReader {
+public:
+  FieldSeriesReader() = delete;
+
+  /// @brief Throws std::runtime_error if the file cannot be read, or is not a
+  /// field series of a compatible version.
+  explicit FieldSeriesReader(const std::string &path);
+
+  const std::string &name() const { return _name; }
+  uint64_t fieldSize() const { return _fieldSize; }
+  uint64_t steps() const { return _steps; }
+  /// @brief The chunks in the file, in step order.
+  const std::vector<FieldChunkEntry> &chunks() const { return _index; }
+
+  /// @brief The time of step. Throws std::out_of_range if there is no such
+  /// step, and std::runtime_error if its chunk is corrupt.
+  double time(uint64_t step);
+
+  /// @brief Copy out the values of step, returning its time. Throws as
+  /// time(), and std::invalid_argument if values is not fieldSize() long.
+  double read(uint64_t step, std::span<double> values);
+
+  /// @brief As read(), into a new vector.
+  std::vector<double> read(uint64_t step);
+
+private:
+  /// @brief Decode the chunk holding step, unless it is the one cached.
+  void _load(uint64_t step);
+
+  std::string _path;
+  std::ifstream _in;
+  std::string _name;
+  uint64_t _fieldSize = 0;
+  uint64_t _steps = 0;
+  std::vector<FieldChunkEntry> _index;
+  uint64_t _end = 0; // of the last chunk, which bounds it
+
+  size_t _cached = SIZE_MAX; // the index of the chunk decoded below
+  std::vector<double> _times;
+  std::vector<double> _values;
+};
+
+} // namespace circular
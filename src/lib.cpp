@@ -3,15 +3,20 @@
 #include <numeric>
 
 namespace circular {
-std::tuple<double, double>
-accumulate_vector(const std::vector<double> &values) {
+template <typename T>
+std::tuple<T, T> accumulate_vector(const std::vector<T> &values) {
   auto len = values.size();
-  double mean = std::reduce(values.begin(), values.end()) / len;
+  double mean = std::reduce(values.begin(), values.end(), 0.0) / len;
   auto variance = std::accumulate(values.begin(), values.end(), 0.0,
-                                  [mean](const double &a, const double &b) {
+                                  [mean](const double &a, const T &b) {
                                     auto diff = mean - b;
                                     return a + (diff * diff);
                                   });
-  return {mean, variance / len};
+  return {static_cast<T>(mean), static_cast<T>(variance / len)};
 }
+
+template std::tuple<float, float>
+accumulate_vector<float>(const std::vector<float> &values);
+template std::tuple<double, double>
+accumulate_vector<double>(const std::vector<double> &values);
 } // namespace circular
\ No newline at end of file
@@ -1,12 +1,515 @@
 #include <circular/config_map.hpp>
+#include <algorithm>
+#include <charconv>
+#include <circular/trace.hpp>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <ostream>
 #include <stdexcept>
 #include <toml++/toml.h>
+#include <utility>
 
 using namespace circular;
 
+namespace {
+// How much TOML to build up before writing it out
+constexpr size_t TomlBufferSize = size_t{1} << 16;
+
+void appendTomlString(std::string &out, std::string_view s) {
+  static constexpr char hex[] = "0123456789ABCDEF";
+  out += '"';
+  for (char c : s) {
+    switch (c) {
+    case '"':
+      out += "\\\"";
+      break;
+    case '\\':
+      out += "\\\\";
+      break;
+    case '\b':
+      out += "\\b";
+      break;
+    case '\t':
+      out += "\\t";
+      break;
+    case '\n':
+      out += "\\n";
+      break;
+    case '\f':
+      out += "\\f";
+      break;
+    case '\r':
+      out += "\\r";
+      break;
+    default: {
+      auto u = static_cast<unsigned char>(c);
+      if (u < 0x20 || u == 0x7F) {
+        out += "\\u00";
+        out += hex[u >> 4];
+        out += hex[u & 0xF];
+      } else {
+        out += c;
+      }
+    }
+    }
+  }
+  out += '"';
+}
+
+/// @brief A bare key if possible, otherwise a quoted one.
+void appendTomlKey(std::string &out, std::string_view key) {
+  auto bare = [](char c) {
+    return (c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z') ||
+           (c >= '0' && c <= '9') || c == '_' || c == '-';
+  };
+  if (!key.empty() && std::all_of(key.begin(), key.end(), bare)) {
+    out += key;
+  } else {
+    appendTomlString(out, key);
+  }
+}
+
+template <typename T> void appendNumber(std::string &out, T value) {
+  char buf[32];
+  auto [end, ec] = std::to_chars(buf, buf + sizeof(buf), value);
+  std::string_view text{buf, static_cast<size_t>(end - buf)};
+  out += text;
+  // Impl: the shortest form that round-trips, but TOML must see a float
+  if constexpr (std::is_floating_point_v<T>) {
+    if (text.find_first_of(".eEn") == std::string_view::npos) {
+      out += ".0";
+    }
+  }
+}
+
+/// @brief Where each section's headers and keys are, in a TOML document.
+struct SectionRanges {
+  std::vector<std::pair<size_t, size_t>> root;
+  FlatMap<std::string, std::vector<std::pair<size_t, size_t>>> sections;
+};
+
+/**
+ * @brief Find the byte ranges of each section in text, without parsing any
+ * values: only strings, comments and brackets are followed, so that a table
+ * header is only recognised at the start of a line, outside any value.
+ *
+ * Headers alone are parsed, to read their (possibly quoted, or dotted) names.
+ * An array of tables ([[name]]) is a root key. Malformed values are left for
+ * the parse of their section to report.
+ */
+SectionRanges scanSections(std::string_view text, const std::string &path) {
+  SectionRanges ranges{};
+  auto *current = &ranges.root;
+  size_t start = 0;
+  size_t depth = 0;
+  bool line_start = true;
+
+  auto line_end = [&](size_t i) {
+    auto e = text.find('\n', i);
+    return (e == std::string_view::npos) ? text.size() : e;
+  };
+  auto skip_string = [&](size_t i) {
+    const auto quote = text[i];
+    const std::string_view triple = (quote == '"') ? "\"\"\"" : "'''";
+    const bool multiline = text.substr(i, 3) == triple;
+    i += multiline ? 3 : 1;
+    while (i < text.size()) {
+      if (quote == '"' && text[i] == '\\') {
+        i += 2;
+      } else if (multiline ? text.substr(i, 3) == triple : text[i] == quote) {
+        return i + (multiline ? 3 : 1);
+      } else if (!multiline && text[i] == '\n') {
+        return i;
+      } else {
+        ++i;
+      }
+    }
+    return i;
+  };
+
+  size_t i = 0;
+  while (i < text.size()) {
+    const auto c = text[i];
+    if (c == '\n') {
+      line_start = true;
+      ++i;
+    } else if (c == ' ' || c == '\t' || c == '\r') {
+      ++i;
+    } else if (c == '#') {
+      i = line_end(i);
+    } else if (line_start && depth == 0 && c == '[') {
+      current->emplace_back(start, i);
+      start = i;
+      auto end = line_end(i);
+      // Impl: without the \r of a CRLF, which toml++ rejects without its \n
+      auto header_end = (end > i && text[end - 1] == '\r') ? end - 1 : end;
+      auto header = toml::parse(text.substr(i, header_end - i), path);
+      current = &ranges.root;
+      for (auto &&[k, v] : header) {
+        if (v.is_table()) {
+          current = &ranges.sections[std::string{k.str()}];
+        }
+        break;
+      }
+      i = end;
+      line_start = false;
+    } else {
+      line_start = false;
+      if (c == '"' || c == '\'') {
+        i = skip_string(i);
+        continue;
+      }
+      if (c == '[' || c == '{') {
+        ++depth;
+      } else if ((c == ']' || c == '}') && depth > 0) {
+        --depth;
+      }
+      ++i;
+    }
+  }
+  current->emplace_back(start, text.size());
+  return ranges;
+}
+} // namespace
+
+static_assert(sizeof(ConfigValue) == 16, "ConfigValue should stay compact");
+
+template <typename T> T *circular::ConfigValue::_block() const {
+  T *block = nullptr;
+  std::memcpy(&block, _bytes, sizeof(block));
+  return block;
+}
+
+uint32_t circular::ConfigValue::_blockSize() const {
+  uint32_t size = 0;
+  std::memcpy(&size, _bytes + sizeof(void *), sizeof(size));
+  return size;
+}
+
+template <typename T>
+void circular::ConfigValue::_setBlock(T *block, uint32_t size) {
+  std::memcpy(_bytes, &block, sizeof(block));
+  std::memcpy(_bytes + sizeof(void *), &size, sizeof(size));
+}
+
+void circular::ConfigValue::_setString(std::string_view s) {
+  if (s.size() <= SmallCapacity) {
+    std::memcpy(_bytes, s.data(), s.size());
+    _small = static_cast<uint8_t>(s.size());
+    _kind = Kind::SmallString;
+    return;
+  }
+  if (s.size() > std::numeric_limits<uint32_t>::max()) {
+    throw std::length_error{"ConfigValue: string too long"};
+  }
+  auto *chars = new char[s.size()];
+  std::memcpy(chars, s.data(), s.size());
+  _setBlock(chars, static_cast<uint32_t>(s.size()));
+  _kind = Kind::HeapString;
+}
+
+std::string_view circular::ConfigValue::_string() const {
+  if (_kind == Kind::SmallString) {
+    return {reinterpret_cast<const char *>(_bytes), _small};
+  }
+  return {_block<char>(), _blockSize()};
+}
+
+void circular::ConfigValue::_setPod(const PodVariant &value) {
+  std::visit(
+      [this](const auto &v) {
+        using T = std::decay_t<decltype(v)>;
+        if constexpr (std::is_same_v<T, std::monostate>) {
+          _kind = Kind::Null;
+        } else if constexpr (std::is_same_v<T, std::string>) {
+          _setString(v);
+        } else {
+          std::memcpy(_bytes, &v, sizeof(v));
+          _kind = std::is_same_v<T, bool>  ? Kind::Bool
+                  : std::is_same_v<T, int> ? Kind::Int
+                                           : Kind::Double;
+        }
+      },
+      value);
+}
+
+PodVariant circular::ConfigValue::_toPod() const {
+  auto load = [this](auto v) {
+    std::memcpy(&v, _bytes, sizeof(v));
+    return v;
+  };
+  switch (_kind) {
+  case Kind::Bool:
+    return load(bool{});
+  case Kind::Int:
+    return load(int{});
+  case Kind::Double:
+    return load(double{});
+  case Kind::SmallString:
+  case Kind::HeapString:
+    return std::string{_string()};
+  default:
+    return PodVariant{};
+  }
+}
+
+circular::ConfigValue::ConfigValue(const ConfigVariant &value) {
+  // Impl: the block is only installed once it is filled, since a throw from
+  // a constructor leaves no destructor to free it
+  if (const auto *list = std::get_if<VariantList>(&value)) {
+    if (list->size() > std::numeric_limits<uint32_t>::max()) {
+      throw std::length_error{"ConfigValue: list too long"};
+    }
+    auto items = std::make_unique<ConfigValue[]>(list->size());
+    for (size_t i = 0; i < list->size(); ++i) {
+      items[i]._setPod((*list)[i]);
+    }
+    _setBlock(items.release(), static_cast<uint32_t>(list->size()));
+    _kind = Kind::List;
+  } else if (const auto *dict = std::get_if<VariantDict>(&value)) {
+    if (dict->size() > std::numeric_limits<uint32_t>::max()) {
+      throw std::length_error{"ConfigValue: dict too long"};
+    }
+    // Impl: keys and values alternate; a VariantDict is already sorted
+    auto items = std::make_unique<ConfigValue[]>(2 * dict->size());
+    size_t i = 0;
+    for (const auto &[k, v] : *dict) {
+      items[i++]._setString(k);
+      items[i++]._setPod(v);
+    }
+    _setBlock(items.release(), static_cast<uint32_t>(dict->size()));
+    _kind = Kind::Dict;
+  } else {
+    std::visit(
+        [this](const auto &v) {
+          using T = std::decay_t<decltype(v)>;
+          if constexpr (!std::is_same_v<T, VariantList> &&
+                        !std::is_same_v<T, VariantDict>) {
+            _setPod(v);
+          }
+        },
+        value);
+  }
+}
+
+circular::ConfigValue::ConfigValue(const ConfigValue &other) {
+  _copyFrom(other);
+}
+
+circular::ConfigValue::ConfigValue(ConfigValue &&other) noexcept
+    : _small{other._small}, _kind{other._kind} {
+  std::memcpy(_bytes, other._bytes, sizeof(_bytes));
+  other._kind = Kind::Null;
+}
+
+ConfigValue &circular::ConfigValue::operator=(const ConfigValue &other) {
+  if (this != &other) {
+    ConfigValue copy{other};
+    *this = std::move(copy);
+  }
+  return *this;
+}
+
+ConfigValue &circular::ConfigValue::operator=(ConfigValue &&other) noexcept {
+  if (this != &other) {
+    _release();
+    std::memcpy(_bytes, other._bytes, sizeof(_bytes));
+    _small = other._small;
+    _kind = other._kind;
+    other._kind = Kind::Null;
+  }
+  return *this;
+}
+
+void circular::ConfigValue::_copyFrom(const ConfigValue &other) {
+  switch (other._kind) {
+  case Kind::HeapString:
+    _setString(other._string());
+    break;
+  case Kind::List:
+  case Kind::Dict: {
+    auto n = other._blockSize();
+    auto count = (other._kind == Kind::Dict) ? 2 * size_t{n} : size_t{n};
+    auto items = std::make_unique<ConfigValue[]>(count);
+    const auto *from = other._block<ConfigValue>();
+    for (size_t i = 0; i < count; ++i) {
+      items[i]._copyFrom(from[i]);
+    }
+    _setBlock(items.release(), n);
+    _kind = other._kind;
+    break;
+  }
+  default:
+    std::memcpy(_bytes, other._bytes, sizeof(_bytes));
+    _small = other._small;
+    _kind = other._kind;
+  }
+}
+
+void circular::ConfigValue::_release() noexcept {
+  switch (_kind) {
+  case Kind::HeapString:
+    delete[] _block<char>();
+    break;
+  case Kind::List:
+  case Kind::Dict:
+    delete[] _block<ConfigValue>();
+    break;
+  default:
+    break;
+  }
+  _kind = Kind::Null;
+}
+
+ConfigValue::Type circular::ConfigValue::type() const noexcept {
+  switch (_kind) {
+  case Kind::Bool:
+    return Type::Bool;
+  case Kind::Int:
+    return Type::Int;
+  case Kind::Double:
+    return Type::Double;
+  case Kind::SmallString:
+  case Kind::HeapString:
+    return Type::String;
+  case Kind::List:
+    return Type::List;
+  case Kind::Dict:
+    return Type::Dict;
+  default:
+    return Type::Null;
+  }
+}
+
+ConfigVariant circular::ConfigValue::to_variant() const {
+  if (_kind == Kind::List) {
+    const auto *items = _block<ConfigValue>();
+    VariantList list{};
+    list.reserve(_blockSize());
+    for (size_t i = 0; i < _blockSize(); ++i) {
+      list.push_back(items[i]._toPod());
+    }
+    return list;
+  }
+  if (_kind == Kind::Dict) {
+    const auto *items = _block<ConfigValue>();
+    VariantDict dict{};
+    dict.reserve(_blockSize());
+    for (size_t i = 0; i < _blockSize(); ++i) {
+      dict.emplace(std::string{items[2 * i]._string()},
+                   items[2 * i + 1]._toPod());
+    }
+    return dict;
+  }
+  return std::visit([](auto &&v) -> ConfigVariant { return v; }, _toPod());
+}
+
+void circular::ConfigValue::append_toml(std::string &out) const {
+  switch (_kind) {
+  case Kind::Null:
+    throw std::invalid_argument{"append_toml: TOML has no null value"};
+  case Kind::Bool:
+    out += std::get<bool>(_toPod()) ? "true" : "false";
+    break;
+  case Kind::Int:
+    appendNumber(out, std::get<int>(_toPod()));
+    break;
+  case Kind::Double:
+    appendNumber(out, std::get<double>(_toPod()));
+    break;
+  case Kind::SmallString:
+  case Kind::HeapString:
+    appendTomlString(out, _string());
+    break;
+  case Kind::List: {
+    const auto *items = _block<ConfigValue>();
+    out += '[';
+    for (size_t i = 0; i < _blockSize(); ++i) {
+      out += (i == 0) ? " " : ", ";
+      items[i].append_toml(out);
+    }
+    out += (_blockSize() == 0) ? "]" : " ]";
+    break;
+  }
+  case Kind::Dict: {
+    const auto *items = _block<ConfigValue>();
+    out += '{';
+    for (size_t i = 0; i < _blockSize(); ++i) {
+      out += (i == 0) ? " " : ", ";
+      appendTomlKey(out, items[2 * i]._string());
+      out += " = ";
+      items[2 * i + 1].append_toml(out);
+    }
+    out += (_blockSize() == 0) ? "}" : " }";
+    break;
+  }
+  }
+}
+
 ConfigMap circular::ConfigMap::parse_from_file(const std::string &file_path) {
+  CIRCULAR_TRACE_ZONE("ConfigMap::parse_from_file");
   ConfigMap m{};
+  auto toml_parsed = toml::parse_file(file_path);
+  m._load(toml_parsed, nullptr);
+  return m;
+}
+
+ConfigMap circular::ConfigMap::parse_from_file_lazily(
+    const std::string &file_path, const std::vector<std::string> &sections) {
+  CIRCULAR_TRACE_ZONE("ConfigMap::parse_from_file_lazily");
+  std::ifstream in{file_path, std::ios::binary};
+  if (!in) {
+    throw std::runtime_error{"parse_from_file_lazily: could not open " +
+                             file_path};
+  }
+  std::string text{std::istreambuf_iterator<char>{in},
+                   std::istreambuf_iterator<char>{}};
+  if (in.bad()) {
+    throw std::runtime_error{"parse_from_file_lazily: I/O error reading " +
+                             file_path};
+  }
+
+  auto allowed = [&](const std::string &section) {
+    return sections.empty() ||
+           std::find(sections.begin(), sections.end(), section) !=
+               sections.end();
+  };
+  auto ranges = scanSections(text, file_path);
+
+  // Impl: keep only the text of the allowed sections, each made contiguous
+  ConfigMap m{};
+  auto source = std::make_shared<std::string>();
+  for (const auto &[section, section_ranges] : ranges.sections) {
+    if (!allowed(section)) {
+      continue;
+    }
+    auto begin = source->size();
+    for (auto [b, e] : section_ranges) {
+      source->append(text, b, e - b);
+    }
+    m._lazy.pending.emplace(section, std::make_pair(begin, source->size()));
+  }
+  m._lazy.source = std::move(source);
+  m._source_path = file_path;
 
+  std::string root_text{};
+  for (auto [b, e] : ranges.root) {
+    root_text.append(text, b, e - b);
+  }
+  m._load(toml::parse(root_text, file_path),
+          sections.empty() ? nullptr : &sections);
+  if (m._lazy.pending.empty()) {
+    m._lazy.source.reset();
+  }
+  return m;
+}
+
+template <typename Table>
+void circular::ConfigMap::_load(const Table &parsed,
+                                const std::vector<std::string> *allowed) {
   auto pod_visitor = [](const toml::node &val) -> circular::PodVariant {
     if (val.is_boolean()) {
       return **val.as_boolean();
@@ -55,36 +558,192 @@ ConfigMap circular::ConfigMap::parse_from_file(const std::string &file_path) {
     return circular::ConfigVariant{};
   };
 
-  auto toml_parsed = toml::parse_file(file_path);
-  for (auto &&[k, v] : toml_parsed) {
+  auto is_allowed = [allowed](const std::string &section) {
+    return nullptr == allowed ||
+           std::find(allowed->begin(), allowed->end(), section) !=
+               allowed->end();
+  };
+
+  for (auto &&[k, v] : parsed) {
     std::string section_str{k.str()};
-    if (v.is_table()) {
+    // Impl: a top-level inline table is a dict in the root section
+    if (v.is_table() && !v.as_table()->is_inline()) {
+      if (!is_allowed(section_str)) {
+        continue;
+      }
+      _adopt(section_str);
+      // Impl: keep empty sections, as write_to_stream writes them
+      _repr.try_emplace(section_str);
       for (auto &&[sk, sv] : *v.as_table()) {
         std::string key_str{sk.str()};
-        auto parsed_val = sv.visit(visitor);
-        m.set_value(section_str, key_str, parsed_val);
+        _set_value(section_str, key_str, sv.visit(visitor));
       }
-    } else {
-      auto parsed_val = v.visit(visitor);
-      m.set_value("", section_str, parsed_val);
+    } else if (is_allowed("")) {
+      _set_value("", section_str, v.visit(visitor));
     }
   }
-  return m;
 }
 
-void circular::ConfigMap::clear() { _repr.clear(); }
+void circular::ConfigMap::_materialise(std::string_view section) const {
+  auto f = _lazy.pending.find(section);
+  if (f == _lazy.pending.end()) {
+    return;
+  }
+  CIRCULAR_TRACE_ZONE("ConfigMap::_materialise");
+  const auto [b, e] = f->second;
+  // Impl: parsed and loaded into a map of its own before the section stops
+  // being pending, so that if either throws, the next use throws again,
+  // rather than finding no section
+  ConfigMap loaded{};
+  loaded._load(toml::parse(std::string_view{*_lazy.source}.substr(b, e - b),
+                           _source_path),
+               nullptr);
+  _lazy.pending.erase(f);
+  for (auto &[name, values] : loaded._repr) {
+    _lazy.parsed.emplace(name, std::move(values));
+  }
+  if (_lazy.pending.empty()) {
+    _lazy.source.reset();
+  }
+}
+
+void circular::ConfigMap::_adopt(std::string_view section) {
+  _materialise(section);
+  auto f = _lazy.parsed.find(section);
+  if (f != _lazy.parsed.end()) {
+    _repr.emplace(f->first, std::move(f->second));
+    _lazy.parsed.erase(f);
+  }
+}
+
+const circular::ConfigMap::_config_section_t *
+circular::ConfigMap::_find_section(std::string_view section) const {
+  _materialise(section);
+  auto f = _repr.find(section);
+  if (f != _repr.end()) {
+    return &f->second;
+  }
+  auto p = std::as_const(_lazy.parsed).find(section);
+  return p == _lazy.parsed.end() ? nullptr : &p->second;
+}
+
+void circular::ConfigMap::materialise_all() const {
+  while (!_lazy.pending.empty()) {
+    auto section = _lazy.pending.begin()->first;
+    _materialise(section);
+  }
+}
+
+void circular::ConfigMap::_write_toml(std::string &buffer,
+                                      std::ostream *out) const {
+  materialise_all();
+  auto flush = [&]() {
+    if (nullptr != out && buffer.size() >= TomlBufferSize) {
+      out->write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+      buffer.clear();
+    }
+  };
+  auto write_section = [&](const _config_section_t &section) {
+    for (const auto &[key, value] : section) {
+      if (value.type() == ConfigValue::Type::Null) {
+        continue;
+      }
+      appendTomlKey(buffer, key);
+      buffer += " = ";
+      value.append_toml(buffer);
+      buffer += '\n';
+      flush();
+    }
+  };
+
+  bool first = true;
+  if (const auto *root = _find_section(std::string_view{})) {
+    for (const auto &kv : *root) {
+      if (!kv.first.empty() && has_section(kv.first) &&
+          kv.second.type() != ConfigValue::Type::Null) {
+        throw std::invalid_argument{"write_to_stream: root key \"" +
+                                    kv.first + "\" is also a section"};
+      }
+    }
+    write_section(*root);
+    first = root->empty();
+  }
+  // Impl: the sections are in _repr and _lazy.parsed, both sorted, and
+  // disjoint; merge them
+  const auto &parsed = _lazy.parsed;
+  auto r = _repr.begin();
+  auto p = parsed.begin();
+  while (r != _repr.end() || p != parsed.end()) {
+    const auto fromRepr =
+        p == parsed.end() || (r != _repr.end() && r->first < p->first);
+    const auto &[name, section] = fromRepr ? *r++ : *p++;
+    if (name.empty()) {
+      continue;
+    }
+    if (!first) {
+      buffer += '\n';
+    }
+    first = false;
+    buffer += '[';
+    appendTomlKey(buffer, name);
+    buffer += "]\n";
+    write_section(section);
+  }
+}
+
+void circular::ConfigMap::write_to_stream(std::ostream &out) const {
+  CIRCULAR_TRACE_ZONE("ConfigMap::write_to_stream");
+  std::string buffer{};
+  buffer.reserve(TomlBufferSize + TomlBufferSize / 4);
+  _write_toml(buffer, &out);
+  out.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+  if (!out) {
+    throw std::runtime_error{"write_to_stream: I/O error"};
+  }
+}
+
+std::string circular::ConfigMap::write_to_string() const {
+  CIRCULAR_TRACE_ZONE("ConfigMap::write_to_string");
+  std::string buffer{};
+  _write_toml(buffer, nullptr);
+  return buffer;
+}
+
+void circular::ConfigMap::write_to_file(const std::string &file_path) const {
+  std::ofstream out{file_path, std::ios::binary | std::ios::trunc};
+  if (!out) {
+    throw std::runtime_error{"write_to_file: could not open " + file_path};
+  }
+  write_to_stream(out);
+  out.close();
+  if (!out) {
+    throw std::runtime_error{"write_to_file: I/O error writing " + file_path};
+  }
+}
+
+void circular::ConfigMap::clear() {
+  _repr.clear();
+  _lazy = {};
+}
 
 void circular::ConfigMap::erase_section(const std::string &section) {
+  // Impl: a pending section is dropped unparsed
+  bool found = _lazy.pending.erase(section) > 0 ||
+               _lazy.parsed.erase(section) > 0;
   auto f = _repr.find(section);
-  if (f == _repr.end()) {
+  if (f != _repr.end()) {
+    _repr.erase(f);
+    found = true;
+  }
+  if (!found) {
     throw std::out_of_range{
         "erase_section: trying to erase nonexistent section"};
   }
-  _repr.erase(f);
 }
 
 void circular::ConfigMap::erase_section_key(const std::string &section,
                                             const std::string &key) {
+  _adopt(section);
   auto &d = _repr.at(section);
   auto k = d.find(key);
   if (k == d.end()) {
@@ -96,11 +755,14 @@ void circular::ConfigMap::erase_section_key(const std::string &section,
 
 std::vector<std::string>
 circular::ConfigMap::get_section_keys(const std::string &section) const {
-  auto d = _repr.at(section);
+  const auto *d = _find_section(section);
+  if (nullptr == d) {
+    throw std::out_of_range{"get_section_keys: section not found"};
+  }
 
   std::vector<std::string> keys{};
-  keys.reserve(d.size());
-  for (const auto kv : d) {
+  keys.reserve(d->size());
+  for (const auto &kv : *d) {
     keys.push_back(kv.first);
   }
 
@@ -109,10 +771,21 @@ circular::ConfigMap::get_section_keys(const std::string &section) const {
 
 std::vector<std::string> circular::ConfigMap::get_sections() const {
   std::vector<std::string> sections{};
-  sections.reserve(_repr.size());
-  for (const auto kv : _repr) {
+  sections.reserve(_repr.size() + _lazy.pending.size() +
+                   _lazy.parsed.size());
+  for (const auto &kv : _repr) {
     sections.push_back(kv.first);
   }
+  if (!_lazy.pending.empty() || !_lazy.parsed.empty()) {
+    // Impl: each is sorted, and they are disjoint
+    for (const auto &kv : _lazy.pending) {
+      sections.push_back(kv.first);
+    }
+    for (const auto &kv : _lazy.parsed) {
+      sections.push_back(kv.first);
+    }
+    std::sort(sections.begin(), sections.end());
+  }
 
   return sections;
 }
@@ -120,8 +793,8 @@ std::vector<std::string> circular::ConfigMap::get_sections() const {
 ConfigVariant circular::ConfigMap::get_value(const std::string &section,
                                              const std::string &key,
                                              ConfigVariant default_value) const {
-  auto finds = _repr.find(section);
-  if (finds == _repr.end()) {
+  const auto *d = _find_section(section);
+  if (nullptr == d) {
     if (default_value == ConfigVariant{}) {
       throw std::out_of_range{
           "get_value: section not found, and default_value == std::monostate"};
@@ -129,9 +802,8 @@ ConfigVariant circular::ConfigMap::get_value(const std::string &section,
     return default_value;
   }
 
-  auto &d = finds->second;
-  auto findk = d.find(key);
-  if (findk == d.end()) {
+  auto findk = d->find(key);
+  if (findk == d->end()) {
     if (default_value == ConfigVariant{}) {
       throw std::out_of_range{
           "get_value: key not found, and default_value == std::monostate"};
@@ -139,16 +811,24 @@ ConfigVariant circular::ConfigMap::get_value(const std::string &section,
     return default_value;
   }
 
-  return findk->second;
+  return findk->second.to_variant();
 }
 
 void circular::ConfigMap::set_value(const std::string &section,
                                     const std::string &key,
                                     ConfigVariant value) {
+  _adopt(section);
+  _set_value(section, key, value);
+}
+
+void circular::ConfigMap::_set_value(const std::string &section,
+                                     const std::string &key,
+                                     const ConfigVariant &value) {
   auto finds = _repr.find(section);
   if (finds == _repr.end()) {
-    _config_section_t new_section_repr{{key, value}};
-    _repr.emplace(std::make_pair(section, new_section_repr));
+    _config_section_t new_section_repr{};
+    new_section_repr.emplace(key, ConfigValue{value});
+    _repr.emplace(section, std::move(new_section_repr));
     return;
   }
 
@@ -159,15 +839,17 @@ void circular::ConfigMap::set_value(const std::string &section,
       d.erase(findk);
     }
   } else {
-    d.insert_or_assign(key, value);
+    d.insert_or_assign(key, ConfigValue{value});
   }
 }
 
 bool circular::ConfigMap::has_section(const std::string &section) const {
-  return _repr.contains(section);
+  return _repr.contains(section) || _lazy.pending.contains(section) ||
+         _lazy.parsed.contains(section);
 }
 
 bool circular::ConfigMap::has_section_key(const std::string &section,
                                           const std::string &key) const {
-  return _repr.contains(section) && _repr.at(section).contains(key);
+  const auto *d = _find_section(section);
+  return nullptr != d && d->contains(key);
 }
@@ -9,29 +9,32 @@
 
 namespace circular {
 namespace param {
-const inline double AstronomicalUnit = 1.496e+11;    // [m]
-const inline double CpNaCl = 8.600e+02;               // [J / kg K]
-const inline double CpWater = 4.184e+03;              // [J / kg K]
-const inline double CryoscopicConstWater = 1.853;     // [K / kg mol]
-const inline double DensityEarth = 5515;              // [kg / m^3]
-const inline double DensityIce = 917;                 // [kg / m^3]
-const inline double DensityWaterLinTerm = 6.327e-02;  // [kg / m^3 K]
-const inline double DensityWaterQuadTerm = 8.524e-03; // [kg / m^3 K^2]
-const inline double DensityWaterZero = 999.853;       // [kg / m^3]
-const inline double LHFusionWater = 3.400e+05;       // [J / kg]
-const inline double LHSublimWater = 2.840e+06;       // [J / kg]
-const inline double LHVaporWater = 2.500e+06;        // [J / kg]
-const inline double MassSun = 1.988e+30;             // [kg]
-const inline double NewtonConst = 6.674e-11;         // [m^3 / kg s^2]
-const inline double PeriodEarth = 86400;             // [s]
-const inline double RadiusEarth = 6.371e+6;           // [m]
-const inline double RadiusSun = 6.957e+8;            // [m]
-const inline double SalinityBrine = 357;              // [g / kg]
-const inline double StefanBoltzmannConst = 5.670e-8; // [W / m^2 K^4]
-const inline double TempSun = 5772;                  // [K]
+constexpr inline double AstronomicalUnit = 1.496e+11;    // [m]
+constexpr inline double CpIce = 2.108e+03;                // [J / kg K]
+constexpr inline double CpNaCl = 8.600e+02;               // [J / kg K]
+constexpr inline double CpWater = 4.184e+03;              // [J / kg K]
+constexpr inline double CryoscopicConstWater = 1.853;     // [K / kg mol]
+constexpr inline double DensityEarth = 5515;              // [kg / m^3]
+constexpr inline double DensityIce = 917;                 // [kg / m^3]
+constexpr inline double DensityWaterLinTerm = 6.327e-02;  // [kg / m^3 K]
+constexpr inline double DensityWaterQuadTerm = 8.524e-03; // [kg / m^3 K^2]
+constexpr inline double DensityWaterZero = 999.853;       // [kg / m^3]
+constexpr inline double LHFusionWater = 3.400e+05;       // [J / kg]
+constexpr inline double LHSublimWater = 2.840e+06;       // [J / kg]
+constexpr inline double LHVaporWater = 2.500e+06;        // [J / kg]
+constexpr inline double MassSun = 1.988e+30;             // [kg]
+constexpr inline double MolarMassNaCl = 58.44;           // [g / mol]
+constexpr inline double NewtonConst = 6.674e-11;         // [m^3 / kg s^2]
+constexpr inline double PeriodEarth = 86400;             // [s]
+constexpr inline double RadiusEarth = 6.371e+6;           // [m]
+constexpr inline double RadiusSun = 6.957e+8;            // [m]
+constexpr inline double SalinityBrine = 357;              // [g / kg]
+constexpr inline double StefanBoltzmannConst = 5.670e-8; // [W / m^2 K^4]
+constexpr inline double TempSun = 5772;                  // [K]
+constexpr inline double TempZeroCelsius = 273.15;        // [K]
 // unit conversions
-const inline double ConvKilo = 1e3;
-const inline double ConvKiloSquared = ConvKilo * ConvKilo;
-const inline double ConvKiloCubed = ConvKilo * ConvKiloSquared;
+constexpr inline double ConvKilo = 1e3;
+constexpr inline double ConvKiloSquared = ConvKilo * ConvKilo;
+constexpr inline double ConvKiloCubed = ConvKilo * ConvKiloSquared;
 } // namespace param
 } // namespace circular
\ No newline at end of file
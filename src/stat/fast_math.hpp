@@ -0,0 +1,225 @@
+/**
+ * @file fast_math.hpp
+ * @author Alex Laing (livingearthcompany@gmail.com)
+ * @brief Precision policies for the transcendental functions used by astro::.
+ *
+ * A policy is a type with static sin/cos/tan/asin/acos/sqrt/root4 members.
+ * Functions templated on a policy can then be compiled against either libm
+ * (math::Precise) or the polynomial kernels here (math::Fast).
+ *
+ * The Fast kernels are branch-free (selects only, no table lookups and no
+ * calls), so loops over arrays that use them are auto-vectorized, whereas libm
+ * calls are not. Error bounds are measured against long double references:
+ * - sin, cos: <= 1.75 ULP for |x| <= 10, and <= 3 ULP for |x| <= 1e6 (the
+ *   Cody-Waite reduction is only good up to there);
+ * - tan: <= 5 ULP for |x| <= 1e6, away from its poles (|cos(x)| > 1e-3);
+ * - asin: <= 3 ULP, and acos: <= 1.5 ULP, on [-1, 1];
+ * - sqrt, root4: as libm (these are hardware instructions already).
+ *
+ * Both policies are constexpr. libm is not, so during constant evaluation
+ * math::Precise falls back on the Fast kernels for trigonometry, and on a
+ * Newton iteration (within 1 ULP) for square roots.
+ */
+
+#pragma once
+
+#include <bit>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <type_traits>
+
+namespace circular {
+namespace math {
+
+// Impl: std::abs, std::copysign and std::sqrt are not constexpr until C++23
+// (and std::sqrt not even then).
+constexpr double _abs(double x) {
+  return std::bit_cast<double>(std::bit_cast<uint64_t>(x) &
+                               ~(uint64_t{1} << 63));
+}
+
+constexpr double _copysign(double x, double sign) {
+  return std::bit_cast<double>(
+      (std::bit_cast<uint64_t>(x) & ~(uint64_t{1} << 63)) |
+      (std::bit_cast<uint64_t>(sign) & (uint64_t{1} << 63)));
+}
+
+constexpr double _constexprSqrt(double x) {
+  if (x == 0.0 || x == std::numeric_limits<double>::infinity()) {
+    return x;
+  }
+  if (!(x > 0.0)) {
+    return std::numeric_limits<double>::quiet_NaN();
+  }
+  // halving the exponent gives a first guess within a factor of two
+  auto y = std::bit_cast<double>((std::bit_cast<uint64_t>(x) >> 1) +
+                                 (uint64_t{0x1FF8} << 48));
+  for (int i = 0; i < 64; ++i) {
+    auto next = 0.5 * (y + x / y);
+    if (next == y) {
+      break;
+    }
+    y = next;
+  }
+  return y;
+}
+
+/// @brief Polynomial kernels; see the file comment for their error bounds.
+struct Fast {
+  static constexpr double sin(double x) {
+    double s = 0.0, c = 0.0;
+    auto q = _sincosReduced(x, s, c);
+    auto r = (q & 1) ? c : s;
+    return _flipSign(r, q & 2);
+  }
+
+  static constexpr double cos(double x) {
+    double s = 0.0, c = 0.0;
+    auto q = _sincosReduced(x, s, c);
+    auto r = (q & 1) ? s : c;
+    return _flipSign(r, (q + 1) & 2);
+  }
+
+  static constexpr double tan(double x) {
+    double s = 0.0, c = 0.0;
+    auto q = _sincosReduced(x, s, c);
+    // Impl: tan has period pi, so only the swap matters, not the signs.
+    return (q & 1) ? -c / s : s / c;
+  }
+
+  static constexpr double asin(double x) {
+    auto a = _abs(x);
+    auto small = a <= 0.5;
+    double r = 0.0;
+    _asinReduced(a, small, r);
+    auto v = small ? r : (PiOver2Hi - 2.0 * r) + PiOver2Lo;
+    return _copysign(v, x);
+  }
+
+  static constexpr double acos(double x) {
+    auto a = _abs(x);
+    auto small = a <= 0.5;
+    double r = 0.0;
+    _asinReduced(a, small, r);
+    // acos(x) = pi/2 - asin(x) near zero, and 2 asin(sqrt((1 - |x|) / 2))
+    // (reflected through pi for x < 0) towards the ends.
+    auto v_small = PiOver2Hi - (_copysign(r, x) - PiOver2Lo);
+    auto v_large = (x < 0.0) ? (PiHi - 2.0 * r) + PiLo : 2.0 * r;
+    return small ? v_small : v_large;
+  }
+
+  static constexpr double sqrt(double x) {
+    if (std::is_constant_evaluated()) {
+      return _constexprSqrt(x);
+    }
+    return std::sqrt(x);
+  }
+  static constexpr double root4(double x) { return sqrt(sqrt(x)); }
+
+private:
+  static constexpr double TwoOverPi = 6.36619772367581382433e-01;
+  // Impl: pi/2 split into 33-bit pieces (as in fdlibm), so that k * piece is
+  // exact for |k| < 2^20.
+  static constexpr double PiOver2_1 = 1.57079632673412561417e+00;
+  static constexpr double PiOver2_2 = 6.07710050630396597660e-11;
+  static constexpr double PiOver2_2t = 2.02226624879595063154e-21;
+  static constexpr double PiOver2Hi = 1.57079632679489655800e+00;
+  static constexpr double PiOver2Lo = 6.12323399573676603587e-17;
+  static constexpr double PiHi = 3.14159265358979311600e+00;
+  static constexpr double PiLo = 1.22464679914735317720e-16;
+  // Impl: adding 1.5 * 2^52 rounds to an integer, which is then readable from
+  // the low mantissa bits, without any (slow, scalar) double -> int64 cast.
+  static constexpr double RoundShifter = 6755399441055744.0;
+
+  static constexpr double _flipSign(double x, uint64_t flip) {
+    return std::bit_cast<double>(std::bit_cast<uint64_t>(x) ^ (flip << 62));
+  }
+
+  /// @brief sin and cos of x reduced to [-pi/4, pi/4], plus the quadrant.
+  static constexpr uint64_t _sincosReduced(double x, double &s, double &c) {
+    auto shifted = x * TwoOverPi + RoundShifter;
+    auto k = shifted - RoundShifter;
+    auto q = std::bit_cast<uint64_t>(shifted) & 3;
+
+    auto r = ((x - k * PiOver2_1) - k * PiOver2_2) - k * PiOver2_2t;
+    auto z = r * r;
+
+    // minimax-fitted on [0, (pi/4)^2]
+    auto ps = -1.6666666666666663e-01 +
+              z * (8.3333333333308595e-03 +
+                   z * (-1.9841269836688147e-04 +
+                        z * (2.7557316078609935e-06 +
+                             z * (-2.5051128182683191e-08 +
+                                  z * 1.5917922197836263e-10))));
+    auto pc = 4.1666666666666470e-02 +
+              z * (-1.3888888888843858e-03 +
+                   z * (2.4801587267108158e-05 +
+                        z * (-2.7557307138653072e-07 +
+                             z * (2.0874666950878130e-09 +
+                                  z * -1.1302057879385138e-11))));
+    s = r + r * z * ps;
+    c = 1.0 - 0.5 * z + z * z * pc;
+    return q;
+  }
+
+  /// @brief asin of either |x| (when small) or sqrt((1 - |x|) / 2).
+  static constexpr void _asinReduced(double a, bool small, double &r) {
+    auto z = small ? a * a : 0.5 * (1.0 - a);
+    auto s = small ? a : sqrt(z);
+    // minimax-fitted on [0, 0.25]
+    auto p = 1.6666666666666652e-01 +
+             z * (7.5000000000198838e-02 +
+             z * (4.4642857104120755e-02 +
+             z * (3.0381947339756875e-02 +
+             z * (2.2372048251977937e-02 +
+             z * (1.7355251122073069e-02 +
+             z * (1.3929735339013982e-02 +
+             z * (1.1874982302973904e-02 +
+             z * (7.8050485579719119e-03 +
+             z * (1.6030059273347060e-02 +
+             z * (-1.0740905995967363e-02 +
+             z * 2.8163897130147421e-02))))))))));
+    r = s + s * z * p;
+  }
+};
+
+/// @brief Defers to libm. This is the default policy everywhere.
+struct Precise {
+  static constexpr double sin(double x) {
+    if (std::is_constant_evaluated()) {
+      return Fast::sin(x);
+    }
+    return std::sin(x);
+  }
+  static constexpr double cos(double x) {
+    if (std::is_constant_evaluated()) {
+      return Fast::cos(x);
+    }
+    return std::cos(x);
+  }
+  static constexpr double tan(double x) {
+    if (std::is_constant_evaluated()) {
+      return Fast::tan(x);
+    }
+    return std::tan(x);
+  }
+  static constexpr double asin(double x) {
+    if (std::is_constant_evaluated()) {
+      return Fast::asin(x);
+    }
+    return std::asin(x);
+  }
+  static constexpr double acos(double x) {
+    if (std::is_constant_evaluated()) {
+      return Fast::acos(x);
+    }
+    return std::acos(x);
+  }
+  static constexpr double sqrt(double x) { return Fast::sqrt(x); }
+  /// @brief x^{1/4}, which is two square roots rather than a std::pow.
+  static constexpr double root4(double x) { return sqrt(sqrt(x)); }
+};
+
+} // namespace math
+} // namespace circular
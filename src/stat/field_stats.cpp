@@ -0,0 +1,405 @@
+#include "circular/field_stats.hpp"
+#include "circular/trace.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <utility>
+
+using namespace circular;
+
+namespace {
+const double NaN = std::numeric_limits<double>::quiet_NaN();
+const double Inf = std::numeric_limits<double>::infinity();
+
+// Impl: small enough that the second pass over a block hits L1
+const size_t BlockSize = 1024;
+// Impl: independent accumulators, so that reductions vectorize without
+// -ffast-math reassociating them
+const size_t Lanes = 8;
+
+/// @brief Moments and extrema of one block, ignoring NaNs.
+struct BlockMoments {
+  uint64_t count = 0;
+  double mean = 0.0;
+  double m2 = 0.0;
+  double min = Inf;
+  double max = -Inf;
+};
+
+BlockMoments blockMoments(std::span<const double> block) {
+  uint64_t n[Lanes] = {};
+  double sum[Lanes] = {};
+  double lo[Lanes], hi[Lanes];
+  std::fill_n(lo, Lanes, Inf);
+  std::fill_n(hi, Lanes, -Inf);
+
+  auto size = block.size();
+  auto *x = block.data();
+  size_t i = 0;
+  for (; i + Lanes <= size; i += Lanes) {
+    for (size_t l = 0; l < Lanes; ++l) {
+      auto v = x[i + l];
+      bool ok = v == v;
+      n[l] += ok;
+      sum[l] += ok ? v : 0.0;
+      lo[l] = (ok && v < lo[l]) ? v : lo[l];
+      hi[l] = (ok && v > hi[l]) ? v : hi[l];
+    }
+  }
+  for (; i < size; ++i) {
+    auto v = x[i];
+    bool ok = v == v;
+    n[0] += ok;
+    sum[0] += ok ? v : 0.0;
+    lo[0] = (ok && v < lo[0]) ? v : lo[0];
+    hi[0] = (ok && v > hi[0]) ? v : hi[0];
+  }
+
+  BlockMoments m{};
+  double total = 0.0;
+  for (size_t l = 0; l < Lanes; ++l) {
+    m.count += n[l];
+    total += sum[l];
+    m.min = std::min(m.min, lo[l]);
+    m.max = std::max(m.max, hi[l]);
+  }
+  if (m.count == 0) {
+    return m;
+  }
+  m.mean = total / static_cast<double>(m.count);
+
+  double m2[Lanes] = {};
+  i = 0;
+  for (; i + Lanes <= size; i += Lanes) {
+    for (size_t l = 0; l < Lanes; ++l) {
+      auto v = x[i + l];
+      auto d = (v == v) ? v - m.mean : 0.0;
+      m2[l] += d * d;
+    }
+  }
+  for (; i < size; ++i) {
+    auto v = x[i];
+    auto d = (v == v) ? v - m.mean : 0.0;
+    m2[0] += d * d;
+  }
+  for (size_t l = 0; l < Lanes; ++l) {
+    m.m2 += m2[l];
+  }
+  return m;
+}
+
+void checkQuantile(double q) {
+  if (!(q >= 0.0 && q <= 1.0)) {
+    throw std::invalid_argument{"quantile: q must be in [0, 1]"};
+  }
+}
+} // namespace
+
+circular::QuantileSketch::QuantileSketch(size_t k) : _k{k} {
+  if (k < 8) {
+    throw std::invalid_argument{"QuantileSketch: k must be at least 8"};
+  }
+  _grow();
+}
+
+void circular::QuantileSketch::_grow() {
+  _levels.emplace_back();
+  // Impl: the top level holds k, and each level below 2/3 of the one above,
+  // but no fewer than 8 (as in Apache DataSketches)
+  _capacities.resize(_levels.size());
+  _capacity = 0;
+  double cap = static_cast<double>(_k);
+  for (size_t h = _levels.size(); h-- > 0;) {
+    _capacities[h] = std::max<size_t>(8, static_cast<size_t>(std::ceil(cap)));
+    _capacity += _capacities[h];
+    cap *= 2.0 / 3.0;
+  }
+}
+
+void circular::QuantileSketch::add(double value) {
+  if (value != value) {
+    return;
+  }
+  ++_count;
+  _levels[0].push_back(value);
+  if (++_retained >= _capacity) {
+    _compress();
+  }
+}
+
+void circular::QuantileSketch::add(std::span<const double> values) {
+  for (auto v : values) {
+    add(v);
+  }
+}
+
+void circular::QuantileSketch::_compress() {
+  // Impl: lazily, compacting only the lowest full level, and only while the
+  // sketch as a whole is full
+  while (_retained >= _capacity) {
+    size_t h = 0;
+    while (_levels[h].size() < _capacities[h]) {
+      ++h;
+    }
+    if (h + 1 == _levels.size()) {
+      _grow();
+    }
+    auto &level = _levels[h];
+    auto &above = _levels[h + 1];
+    std::sort(level.begin(), level.end());
+
+    // splitmix64
+    _rng += 0x9E3779B97F4A7C15;
+    auto z = _rng;
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EB;
+    auto offset = (z ^ (z >> 31)) & 1;
+
+    // Impl: each kept value stands for itself and its neighbour, so weighs
+    // twice as much one level up. An odd one out stays behind.
+    auto pairs = level.size() & ~size_t{1};
+    for (size_t i = offset; i < pairs; i += 2) {
+      above.push_back(level[i]);
+    }
+    _retained -= pairs / 2;
+    if (pairs < level.size()) {
+      level.front() = level.back();
+      level.resize(1);
+    } else {
+      level.clear();
+    }
+  }
+}
+
+void circular::QuantileSketch::merge(const QuantileSketch &other) {
+  if (other._k != _k) {
+    throw std::invalid_argument{"merge: sketches have different k"};
+  }
+  while (_levels.size() < other._levels.size()) {
+    _grow();
+  }
+  for (size_t h = 0; h < other._levels.size(); ++h) {
+    _levels[h].insert(_levels[h].end(), other._levels[h].begin(),
+                      other._levels[h].end());
+  }
+  _count += other._count;
+  _retained += other._retained;
+  _compress();
+}
+
+double circular::QuantileSketch::quantile(double q) const {
+  checkQuantile(q);
+  if (_count == 0) {
+    return NaN;
+  }
+  std::vector<std::pair<double, uint64_t>> weighted{};
+  weighted.reserve(_retained);
+  for (size_t h = 0; h < _levels.size(); ++h) {
+    for (auto v : _levels[h]) {
+      weighted.emplace_back(v, uint64_t{1} << h);
+    }
+  }
+  std::sort(weighted.begin(), weighted.end());
+
+  uint64_t total = 0;
+  for (const auto &w : weighted) {
+    total += w.second;
+  }
+  auto target = q * static_cast<double>(total);
+  uint64_t cumulative = 0;
+  for (const auto &w : weighted) {
+    cumulative += w.second;
+    if (static_cast<double>(cumulative) >= target) {
+      return w.first;
+    }
+  }
+  return weighted.back().first;
+}
+
+circular::FieldStats::FieldStats(FieldStatsOptions options)
+    : _options{options}, _histogram(options.histogramBins, 0) {
+  if (options.histogramBins > 0 &&
+      !(std::isfinite(options.histogramMin) &&
+        std::isfinite(options.histogramMax) &&
+        options.histogramMin < options.histogramMax)) {
+    throw std::invalid_argument{"FieldStats: bad histogram range"};
+  }
+  if (options.sketchK > 0) {
+    _sketch.emplace(options.sketchK);
+  }
+}
+
+void circular::FieldStats::add(std::span<const double> values, size_t offset) {
+  CIRCULAR_TRACE_ZONE("FieldStats::add");
+  for (size_t b = 0; b < values.size(); b += BlockSize) {
+    _addBlock(values.subspan(b, std::min(BlockSize, values.size() - b)),
+              offset + b);
+  }
+}
+
+void circular::FieldStats::_addBlock(std::span<const double> block,
+                                     size_t offset) {
+  auto m = blockMoments(block);
+  _nans += block.size() - m.count;
+  if (m.count == 0) {
+    return;
+  }
+
+  // Impl: only look for the index when the extreme changes, which is rare
+  // after the first few blocks
+  bool first = _count == 0;
+  if (first || m.min < _min) {
+    _min = m.min;
+    _argmin = offset + static_cast<size_t>(
+                           std::find(block.begin(), block.end(), m.min) -
+                           block.begin());
+  }
+  if (first || m.max > _max) {
+    _max = m.max;
+    _argmax = offset + static_cast<size_t>(
+                           std::find(block.begin(), block.end(), m.max) -
+                           block.begin());
+  }
+
+  auto n = static_cast<double>(_count + m.count);
+  auto delta = m.mean - _mean;
+  _mean += delta * static_cast<double>(m.count) / n;
+  _m2 += m.m2 + delta * delta * static_cast<double>(_count) *
+                    static_cast<double>(m.count) / n;
+  _count += m.count;
+
+  if (_options.histogramBins > 0) {
+    auto lo = _options.histogramMin;
+    auto hi = _options.histogramMax;
+    auto last = _options.histogramBins - 1;
+    auto scale = static_cast<double>(_options.histogramBins) / (hi - lo);
+    for (auto v : block) {
+      if (v < lo) {
+        ++_underflow;
+      } else if (v > hi) {
+        ++_overflow;
+      } else if (v == v) {
+        // Impl: hi itself goes in the last bin
+        ++_histogram[std::min(last, static_cast<size_t>((v - lo) * scale))];
+      }
+    }
+  }
+  if (_sketch) {
+    _sketch->add(block);
+  }
+}
+
+void circular::FieldStats::merge(const FieldStats &other) {
+  if (!(other._options == _options)) {
+    throw std::invalid_argument{"merge: FieldStats have different options"};
+  }
+  _nans += other._nans;
+  if (other._count == 0) {
+    return;
+  }
+
+  bool first = _count == 0;
+  if (first || other._min < _min ||
+      (other._min == _min && other._argmin < _argmin)) {
+    _min = other._min;
+    _argmin = other._argmin;
+  }
+  if (first || other._max > _max ||
+      (other._max == _max && other._argmax < _argmax)) {
+    _max = other._max;
+    _argmax = other._argmax;
+  }
+
+  auto n = static_cast<double>(_count + other._count);
+  auto delta = other._mean - _mean;
+  _mean += delta * static_cast<double>(other._count) / n;
+  _m2 += other._m2 + delta * delta * static_cast<double>(_count) *
+                         static_cast<double>(other._count) / n;
+  _count += other._count;
+
+  for (size_t i = 0; i < _histogram.size(); ++i) {
+    _histogram[i] += other._histogram[i];
+  }
+  _underflow += other._underflow;
+  _overflow += other._overflow;
+  if (_sketch) {
+    _sketch->merge(*other._sketch);
+  }
+}
+
+double circular::FieldStats::mean() const { return _count == 0 ? NaN : _mean; }
+
+double circular::FieldStats::variance() const {
+  return _count == 0 ? NaN : _m2 / static_cast<double>(_count);
+}
+
+double circular::FieldStats::min() const { return _count == 0 ? NaN : _min; }
+
+double circular::FieldStats::max() const { return _count == 0 ? NaN : _max; }
+
+size_t circular::FieldStats::argmin() const {
+  if (_count == 0) {
+    throw std::out_of_range{"argmin: no values"};
+  }
+  return _argmin;
+}
+
+size_t circular::FieldStats::argmax() const {
+  if (_count == 0) {
+    throw std::out_of_range{"argmax: no values"};
+  }
+  return _argmax;
+}
+
+double circular::FieldStats::quantile(double q) const {
+  if (!_sketch) {
+    throw std::logic_error{"quantile: FieldStats has no sketch"};
+  }
+  checkQuantile(q);
+  if (q == 0.0) {
+    return min();
+  }
+  if (q == 1.0) {
+    return max();
+  }
+  return _sketch->quantile(q);
+}
+
+Future<FieldStats> circular::FieldStats::computeAsync(
+    std::span<const double> values, FieldStatsOptions options, size_t grain,
+    Tasker &tasker) {
+  if (grain == 0) {
+    throw std::invalid_argument{"computeAsync: grain must be at least 1"};
+  }
+  FieldStats empty{options};
+  if (values.empty()) {
+    Promise<FieldStats> p{};
+    p.set_value(std::move(empty));
+    return p.get_future();
+  }
+
+  std::vector<Future<FieldStats>> parts{};
+  for (size_t begin = 0; begin < values.size(); begin += grain) {
+    auto part = values.subspan(begin, std::min(grain, values.size() - begin));
+    parts.push_back(tasker.Submit([part, begin, options]() {
+      FieldStats s{options};
+      s.add(part, begin);
+      return s;
+    }));
+  }
+  // Impl: merged in order, so the result does not depend on the workers
+  return when_all(std::move(parts))
+      .then([empty](std::vector<FieldStats> parts) mutable {
+        for (const auto &p : parts) {
+          empty.merge(p);
+        }
+        return empty;
+      });
+}
+
+FieldStats circular::FieldStats::compute(std::span<const double> values,
+                                         FieldStatsOptions options,
+                                         size_t grain, Tasker &tasker) {
+  return computeAsync(values, options, grain, tasker).get();
+}
@@ -0,0 +1,306 @@
+#include "insolation.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace circular;
+
+namespace {
+void checkBlock(std::span<const double> latitudes,
+                std::span<const double> longitudes,
+                std::span<const astro::InsolationSlice> slices,
+                double dayLength, std::span<double> exposure,
+                const std::string &what) {
+  if (exposure.size() !=
+      slices.size() * latitudes.size() * longitudes.size()) {
+    throw std::invalid_argument{what + ": the output is not slices x "
+                                       "latitudes x longitudes in size"};
+  }
+  if (!(dayLength > 0.0)) {
+    throw std::invalid_argument{what + ": dayLength must be positive"};
+  }
+  for (const auto &s : slices) {
+    if (!(s.end >= s.begin)) {
+      throw std::invalid_argument{what + ": a slice ends before it begins"};
+    }
+  }
+}
+
+/// @brief Where a star's hour angle starts, and ends, in a slice at
+/// longitude 0: Begin is reduced to [-pi, pi], and End is Begin plus the
+/// slice's width, so that both are shifted by the same whole days.
+struct Phase {
+  double begin = 0.0;
+  double sinBegin = 0.0, cosBegin = 1.0, sinEnd = 0.0, cosEnd = 1.0;
+};
+
+/// @brief The sines and cosines of each latitude and longitude, and of each
+/// star's declination and phase in each slice, evaluated once for the whole
+/// block.
+struct BlockTrig {
+  std::vector<double> sinLat, cosLat, sinLon, cosLon;
+  std::vector<double> sinDecl, cosDecl; // [slice][star]
+  std::vector<Phase> phases;            // [slice][star]
+  std::vector<double> weights; // each star's sun constant
+
+  template <typename Math>
+  static BlockTrig from(std::span<const double> latitudes,
+                        std::span<const double> longitudes,
+                        std::span<const astro::InsolationSlice> slices,
+                        double dayLength,
+                        std::span<const astro::Star> stars) {
+    BlockTrig t{};
+    for (auto lat : latitudes) {
+      t.sinLat.push_back(Math::sin(lat));
+      t.cosLat.push_back(Math::cos(lat));
+    }
+    for (auto lon : longitudes) {
+      t.sinLon.push_back(Math::sin(lon));
+      t.cosLon.push_back(Math::cos(lon));
+    }
+    const auto omega = 2.0 * M_PI / dayLength;
+    for (const auto &s : slices) {
+      const auto width = omega * (s.end - s.begin);
+      for (const auto &star : stars) {
+        t.sinDecl.push_back(Math::sin(s.declination + star.declinationOffset));
+        t.cosDecl.push_back(Math::cos(s.declination + star.declinationOffset));
+        const auto h = omega * s.begin - star.hourOffset;
+        Phase p{};
+        p.begin = h - 2.0 * M_PI * std::round(h * (0.5 * M_1_PI));
+        p.sinBegin = Math::sin(p.begin);
+        p.cosBegin = Math::cos(p.begin);
+        p.sinEnd = Math::sin(p.begin + width);
+        p.cosEnd = Math::cos(p.begin + width);
+        t.phases.push_back(p);
+      }
+    }
+    for (const auto &star : stars) {
+      t.weights.push_back(astro::sunConstant(star));
+    }
+    return t;
+  }
+
+  /// @brief As from(), for the exposure to a single, unit star.
+  template <typename Math>
+  static BlockTrig from(std::span<const double> latitudes,
+                        std::span<const double> longitudes,
+                        std::span<const astro::InsolationSlice> slices,
+                        double dayLength) {
+    const astro::Star unit{};
+    auto t = from<Math>(latitudes, longitudes, slices, dayLength, {&unit, 1});
+    t.weights.front() = 1.0;
+    return t;
+  }
+};
+
+/// @brief Rows [first, last) of the block, where row r is slice r / lats and
+/// latitude r % lats. Each row is the weighted sum over the stars, which is
+/// accumulated while the row is in cache.
+template <typename Math>
+void exposureRows(const BlockTrig &trig, std::span<const double> longitudes,
+                  std::span<const astro::InsolationSlice> slices,
+                  double dayLength, std::span<double> exposure, size_t first,
+                  size_t last) {
+  const auto lats = trig.sinLat.size();
+  const auto lons = longitudes.size();
+  const auto stars = trig.weights.size();
+  const auto omega = 2.0 * M_PI / dayLength;
+  const auto *sin_lon = trig.sinLon.data();
+  const auto *cos_lon = trig.cosLon.data();
+
+  // Impl: the sines and cosines of each cell's hour angles are those of its
+  // longitude and the star's phase, by the angle sum identities, so that a
+  // star costs only multiply-adds per cell; the acos and sine are per row
+  for (size_t row = first; row < last; ++row) {
+    const auto s = row / lats;
+    const auto &slice = slices[s];
+    const auto sin_lat = trig.sinLat[row % lats];
+    const auto cos_lat = trig.cosLat[row % lats];
+    auto *out = exposure.data() + row * lons;
+    std::fill_n(out, lons, 0.0);
+
+    const auto width = omega * (slice.end - slice.begin);
+    for (size_t k = 0; k < stars; ++k) {
+      const auto sin_decl = trig.sinDecl[s * stars + k];
+      const auto cos_decl = trig.cosDecl[s * stars + k];
+      const auto p = trig.phases[s * stars + k];
+      const auto weight = trig.weights[k];
+      if (width == 0.0) {
+        const auto a = sin_lat * sin_decl;
+        const auto b = cos_lat * cos_decl;
+        for (size_t j = 0; j < lons; ++j) {
+          const auto cos_h = cos_lon[j] * p.cosBegin - sin_lon[j] * p.sinBegin;
+          out[j] += weight * std::max(0.0, a + b * cos_h);
+        }
+        continue;
+      }
+
+      const astro::ExposureIntegral e = astro::ExposureIntegral::from<Math>(
+          sin_lat, cos_lat, sin_decl, cos_decl);
+      const auto scale = weight / width;
+      for (size_t j = 0; j < lons; ++j) {
+        const auto h = p.begin + longitudes[j];
+        const auto sin_begin =
+            sin_lon[j] * p.cosBegin + cos_lon[j] * p.sinBegin;
+        const auto sin_end = sin_lon[j] * p.cosEnd + cos_lon[j] * p.sinEnd;
+        out[j] += scale * std::max(0.0, e.at(h + width, sin_end) -
+                                            e.at(h, sin_begin));
+      }
+    }
+  }
+}
+
+/// @brief exposureRows over the whole block, in tasks of grain rows.
+template <typename Math>
+Future<> rowsAsync(std::shared_ptr<const BlockTrig> trig,
+                   std::span<const double> longitudes,
+                   std::span<const astro::InsolationSlice> slices,
+                   double dayLength, std::span<double> out, size_t grain,
+                   Tasker &tasker) {
+  const auto count = slices.size() * trig->sinLat.size();
+  std::vector<Future<>> parts{};
+  for (size_t first = 0; first < count; first += grain) {
+    const auto last = std::min(count, first + grain);
+    parts.push_back(tasker.Submit([=]() {
+      exposureRows<Math>(*trig, longitudes, slices, dayLength, out, first,
+                         last);
+    }));
+  }
+  return when_all(std::move(parts));
+}
+} // namespace
+
+template <typename Math>
+void circular::astro::calcSunExposure(std::span<const double> latitudes,
+                                      std::span<const double> longitudes,
+                                      std::span<const InsolationSlice> slices,
+                                      double dayLength,
+                                      std::span<double> exposure) {
+  checkBlock(latitudes, longitudes, slices, dayLength, exposure,
+             "calcSunExposure");
+  const auto trig =
+      BlockTrig::from<Math>(latitudes, longitudes, slices, dayLength);
+  exposureRows<Math>(trig, longitudes, slices, dayLength, exposure, 0,
+                     slices.size() * latitudes.size());
+}
+
+template <typename Math>
+Future<> circular::astro::calcSunExposureAsync(
+    std::span<const double> latitudes, std::span<const double> longitudes,
+    std::span<const InsolationSlice> slices, double dayLength,
+    std::span<double> exposure, size_t grain, Tasker &tasker) {
+  if (grain == 0) {
+    throw std::invalid_argument{
+        "calcSunExposureAsync: grain must be at least 1"};
+  }
+  checkBlock(latitudes, longitudes, slices, dayLength, exposure,
+             "calcSunExposure");
+  return rowsAsync<Math>(
+      std::make_shared<const BlockTrig>(
+          BlockTrig::from<Math>(latitudes, longitudes, slices, dayLength)),
+      longitudes, slices, dayLength, exposure, grain, tasker);
+}
+
+template <typename Math>
+void circular::astro::calcInsolation(std::span<const double> latitudes,
+                                     std::span<const double> longitudes,
+                                     std::span<const InsolationSlice> slices,
+                                     double dayLength,
+                                     std::span<const Star> stars,
+                                     std::span<double> flux) {
+  checkBlock(latitudes, longitudes, slices, dayLength, flux, "calcInsolation");
+  const auto trig =
+      BlockTrig::from<Math>(latitudes, longitudes, slices, dayLength, stars);
+  exposureRows<Math>(trig, longitudes, slices, dayLength, flux, 0,
+                     slices.size() * latitudes.size());
+}
+
+template <typename Math>
+Future<> circular::astro::calcInsolationAsync(
+    std::span<const double> latitudes, std::span<const double> longitudes,
+    std::span<const InsolationSlice> slices, double dayLength,
+    std::span<const Star> stars, std::span<double> flux, size_t grain,
+    Tasker &tasker) {
+  if (grain == 0) {
+    throw std::invalid_argument{
+        "calcInsolationAsync: grain must be at least 1"};
+  }
+  checkBlock(latitudes, longitudes, slices, dayLength, flux, "calcInsolation");
+  return rowsAsync<Math>(
+      std::make_shared<const BlockTrig>(BlockTrig::from<Math>(
+          latitudes, longitudes, slices, dayLength, stars)),
+      longitudes, slices, dayLength, flux, grain, tasker);
+}
+
+template <typename Math>
+void circular::astro::calcDailyInsolation(std::span<const double> latitudes,
+                                          double declination,
+                                          std::span<const Star> stars,
+                                          std::span<double> flux) {
+  if (latitudes.size() != flux.size()) {
+    throw std::invalid_argument{
+        "calcDailyInsolation: latitudes and flux differ in size"};
+  }
+  const auto n = latitudes.size();
+  std::vector<double> sin_lat(n);
+  std::vector<double> cos_lat(n);
+  for (size_t i = 0; i < n; ++i) {
+    sin_lat[i] = Math::sin(latitudes[i]);
+    cos_lat[i] = Math::cos(latitudes[i]);
+  }
+  std::fill(flux.begin(), flux.end(), 0.0);
+
+  // Impl: the latitudes' trigonometry is shared by every star, so each star
+  // costs only an acos and a sin per latitude, in a loop which vectorizes
+  for (const auto &star : stars) {
+    const auto decl = declination + star.declinationOffset;
+    const auto sin_decl = Math::sin(decl);
+    const auto cos_decl = Math::cos(decl);
+    const auto scale = sunConstant(star) * (0.5 * M_1_PI);
+    for (size_t i = 0; i < n; ++i) {
+      const ExposureIntegral e = ExposureIntegral::from<Math>(
+          sin_lat[i], cos_lat[i], sin_decl, cos_decl);
+      flux[i] += scale * e.day;
+    }
+  }
+}
+
+// Explicit instantiations for each precision policy
+template void circular::astro::calcSunExposure<math::Precise>(
+    std::span<const double>, std::span<const double>,
+    std::span<const InsolationSlice>, double, std::span<double>);
+template void circular::astro::calcSunExposure<math::Fast>(
+    std::span<const double>, std::span<const double>,
+    std::span<const InsolationSlice>, double, std::span<double>);
+template Future<> circular::astro::calcSunExposureAsync<math::Precise>(
+    std::span<const double>, std::span<const double>,
+    std::span<const InsolationSlice>, double, std::span<double>, size_t,
+    Tasker &);
+template Future<> circular::astro::calcSunExposureAsync<math::Fast>(
+    std::span<const double>, std::span<const double>,
+    std::span<const InsolationSlice>, double, std::span<double>, size_t,
+    Tasker &);
+template void circular::astro::calcInsolation<math::Precise>(
+    std::span<const double>, std::span<const double>,
+    std::span<const InsolationSlice>, double, std::span<const Star>,
+    std::span<double>);
+template void circular::astro::calcInsolation<math::Fast>(
+    std::span<const double>, std::span<const double>,
+    std::span<const InsolationSlice>, double, std::span<const Star>,
+    std::span<double>);
+template Future<> circular::astro::calcInsolationAsync<math::Precise>(
+    std::span<const double>, std::span<const double>,
+    std::span<const InsolationSlice>, double, std::span<const Star>,
+    std::span<double>, size_t, Tasker &);
+template Future<> circular::astro::calcInsolationAsync<math::Fast>(
+    std::span<const double>, std::span<const double>,
+    std::span<const InsolationSlice>, double, std::span<const Star>,
+    std::span<double>, size_t, Tasker &);
+template void circular::astro::calcDailyInsolation<math::Precise>(
+    std::span<const double>, double, std::span<const Star>, std::span<double>);
+template void circular::astro::calcDailyInsolation<math::Fast>(
+    std::span<const double>, double, std::span<const Star>, std::span<double>);
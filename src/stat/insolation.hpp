@@ -0,0 +1,220 @@
+/**
+ * @file insolation.hpp
+ * @author Alex Laing (livingearthcompany@gmail.com)
+ * @brief Insolation through the day: at an instant, or averaged over any
+ * window of time, for single points and for whole latitude x longitude x time
+ * blocks.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <circular/tasker.hpp>
+#include <cmath>
+#include <limits>
+#include <span>
+
+#include "fast_math.hpp"
+#include "planets.hpp"
+
+namespace circular {
+namespace astro {
+// Impl: hour angles are in radians, and zero at local noon. Exposures are the
+// cosine of the solar zenith angle, or zero at night, so that multiplying by
+// the sun constant gives the flux onto a horizontal surface.
+
+/// @brief The exposure at an instant, of a location at latitude Latitude and
+/// hour angle HourAngle, to a sun at declination Declination.
+/// @param latitude
+/// @param declination
+/// @param hourAngle
+/// @return dimensionless ratio in [0..1].
+template <typename Math = math::Precise>
+constexpr double calcSunExposure(double latitude, double declination,
+                                 double hourAngle) {
+  return std::max(0.0, Math::sin(latitude) * Math::sin(declination) +
+                           Math::cos(latitude) * Math::cos(declination) *
+                               Math::cos(hourAngle));
+}
+
+/**
+ * @brief The integral over hour angles of the exposure, for a latitude and
+ * declination, which is all that depends on them.
+ *
+ * The exposure is a + b cos(h) where that is positive, i.e. for |h| <= H0
+ * (modulo 2 pi), so its integral from 0 to h is a whole number of days' worth
+ * plus a * c + b * sin(c), where c is the remainder of h (in [-pi, pi])
+ * clamped to [-H0, H0].
+ * That is branch-free, so it is evaluated across a row of longitudes at once.
+ */
+struct ExposureIntegral {
+  double a = 0.0;  // sin(latitude) sin(declination)
+  double b = 0.0;  // cos(latitude) cos(declination)
+  double H0 = 0.0; // the sunset hour angle
+  double sinH0 = 0.0;
+  double day = 0.0; // the integral over a whole day
+
+  template <typename Math = math::Precise>
+  static constexpr ExposureIntegral from(double sinLat, double cosLat,
+                                         double sinDecl, double cosDecl) {
+    ExposureIntegral e{};
+    e.a = sinLat * sinDecl;
+    e.b = cosLat * cosDecl;
+    // Impl: at the poles b == 0, where the sun is up all day or not at all;
+    // dividing by the least normal double instead gives the sign without a
+    // branch, so that a loop of these vectorizes
+    const auto determinant = std::clamp(
+        -e.a / std::max(e.b, std::numeric_limits<double>::min()), -1.0, 1.0);
+    e.H0 = Math::acos(determinant);
+    e.sinH0 = Math::sin(e.H0);
+    e.day = 2.0 * (e.a * e.H0 + e.b * e.sinH0);
+    return e;
+  }
+
+  /// @brief The integral from hour angle 0 to h, for |h| < 2^50.
+  template <typename Math = math::Precise> double at(double h) const {
+    // Impl: rounds to the nearest whole day as math::Fast does to quadrants,
+    // since neither std::floor nor a cast to an integer vectorizes
+    constexpr double RoundShifter = 6755399441055744.0;
+    const auto days = (h * (0.5 * M_1_PI) + RoundShifter) - RoundShifter;
+    const auto c = std::clamp(h - 2.0 * M_PI * days, -H0, H0);
+    return days * day + a * c + b * Math::sin(c);
+  }
+
+  /// @brief As at(h), given sin(h), so that no sine is evaluated: the sine of
+  /// the clamped remainder is sin(h) within [-H0, H0], and +-sin(H0) beyond.
+  double at(double h, double sinH) const {
+    constexpr double RoundShifter = 6755399441055744.0;
+    const auto days = (h * (0.5 * M_1_PI) + RoundShifter) - RoundShifter;
+    const auto w = h - 2.0 * M_PI * days;
+    const auto c = std::clamp(w, -H0, H0);
+    const auto sin_c = std::abs(w) <= H0 ? sinH : std::copysign(sinH0, w);
+    return days * day + a * c + b * sin_c;
+  }
+};
+
+/// @brief The mean exposure between hour angles HourBegin and HourEnd, of a
+/// location at latitude Latitude, to a sun at declination Declination. Over a
+/// whole day, this is the daily mean exposure. If the hour angles are equal,
+/// it is the exposure at that instant.
+/// @param latitude
+/// @param declination
+/// @param hourBegin
+/// @param hourEnd
+/// @return dimensionless ratio in [0..1].
+template <typename Math = math::Precise>
+double calcSunExposure(double latitude, double declination, double hourBegin,
+                       double hourEnd) {
+  if (hourEnd == hourBegin) {
+    return calcSunExposure<Math>(latitude, declination, hourBegin);
+  }
+  const ExposureIntegral e = ExposureIntegral::from<Math>(
+      Math::sin(latitude), Math::cos(latitude), Math::sin(declination),
+      Math::cos(declination));
+  return (e.at<Math>(hourEnd) - e.at<Math>(hourBegin)) /
+         (hourEnd - hourBegin);
+}
+
+/**
+ * @brief A window of time over which to average the exposure. Times are in
+ * seconds since noon at longitude 0; begin == end for the exposure at an
+ * instant.
+ */
+struct InsolationSlice {
+  double begin = 0.0;       // [s]
+  double end = 0.0;         // [s]
+  double declination = 0.0; // [rad]
+};
+
+/**
+ * @brief The mean exposure over each slice of time, at each latitude and
+ * longitude, for a planet whose solar day lasts DayLength.
+ *
+ * The sines and cosines of the latitudes and of each slice's declination
+ * are evaluated once for the block, and the rest of the exposure integral
+ * once per slice and latitude. The loop over longitudes is branch-free, and
+ * with math::Fast is vectorized.
+ * Explicitly instantiated for math::Precise and math::Fast in insolation.cpp.
+ *
+ * Throws std::invalid_argument if exposure is not slices x latitudes x
+ * longitudes in size, dayLength is not positive, or a slice ends before it
+ * begins.
+ *
+ * @param latitudes [rad]
+ * @param longitudes [rad], east of longitude 0.
+ * @param slices
+ * @param dayLength [s]
+ * @param exposure Output, indexed [slice][latitude][longitude].
+ */
+template <typename Math = math::Precise>
+void calcSunExposure(std::span<const double> latitudes,
+                     std::span<const double> longitudes,
+                     std::span<const InsolationSlice> slices,
+                     double dayLength, std::span<double> exposure);
+
+/**
+ * @brief calcSunExposure, split into tasks of Grain (slice, latitude) rows
+ * each, on tasker. All the spans must outlive the returned Future.
+ *
+ * Throws as calcSunExposure (immediately), or std::invalid_argument if grain
+ * is 0.
+ */
+template <typename Math = math::Precise>
+Future<> calcSunExposureAsync(std::span<const double> latitudes,
+                              std::span<const double> longitudes,
+                              std::span<const InsolationSlice> slices,
+                              double dayLength, std::span<double> exposure,
+                              size_t grain = 16,
+                              Tasker &tasker = Tasker::Get());
+
+/**
+ * @brief The insolation from all of stars together: the sum over the stars
+ * of each one's sun constant times its exposure, in one pass over the block.
+ *
+ * Each slice's declination and hour angle are the primary's, and each star
+ * is offset from them as it says (see astro::Star). Each row of the block is
+ * summed over the stars while it is in cache. The cost is linear in the
+ * number of stars: the sines and cosines of the latitudes and longitudes are
+ * evaluated once, so each star adds only an acos and a sine per row and a few
+ * multiply-adds per cell. Explicitly instantiated for math::Precise and
+ * math::Fast in insolation.cpp.
+ *
+ * Throws as calcSunExposure.
+ *
+ * @param flux Output [W / m^2], indexed [slice][latitude][longitude].
+ */
+template <typename Math = math::Precise>
+void calcInsolation(std::span<const double> latitudes,
+                    std::span<const double> longitudes,
+                    std::span<const InsolationSlice> slices, double dayLength,
+                    std::span<const Star> stars, std::span<double> flux);
+
+/// @brief calcInsolation, split as calcSunExposureAsync.
+template <typename Math = math::Precise>
+Future<> calcInsolationAsync(std::span<const double> latitudes,
+                             std::span<const double> longitudes,
+                             std::span<const InsolationSlice> slices,
+                             double dayLength, std::span<const Star> stars,
+                             std::span<double> flux, size_t grain = 16,
+                             Tasker &tasker = Tasker::Get());
+
+/**
+ * @brief The daily mean insolation at each latitude from all of stars, with
+ * the primary at declination Declination. The loop over latitudes is
+ * vectorized, and repeated for each star with the latitudes' sines and
+ * cosines evaluated once. Each star contributes its sunConstant times
+ * astro::calcDailySunExposure.
+ *
+ * Throws std::invalid_argument if latitudes and flux differ in size.
+ *
+ * @param latitudes [rad]
+ * @param declination [rad]
+ * @param stars
+ * @param flux Output [W / m^2], of the same size as latitudes.
+ */
+template <typename Math = math::Precise>
+void calcDailyInsolation(std::span<const double> latitudes, double declination,
+                         std::span<const Star> stars, std::span<double> flux);
+
+} // namespace astro
+} // namespace circular
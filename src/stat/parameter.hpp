@@ -6,6 +6,7 @@
 
 #pragma once
 
+#include <algorithm>
 #include <array>
 #include <cmath>
 #include <ostream>
@@ -17,78 +18,101 @@ namespace param {
 /**
  * @brief A Harmonic represents a cyclical or sinusoidal value, which oscillates
  * about a central value over time.
+ *
+ * @tparam T the type of the value (float or double). Time, the period and the
+ * phase are always double: over many periods, the phase would lose all its
+ * precision in a float.
  */
-struct Harmonic {
-  Harmonic() = delete;
-  Harmonic(double centre, double amplitude, double period, double phase = 0.0)
+template <typename T> struct BasicHarmonic {
+  BasicHarmonic() = delete;
+  constexpr BasicHarmonic(T centre, T amplitude, double period,
+                          double phase = 0.0)
       : _centre{centre}, _amplitude{amplitude}, _period{period}, _phase{phase} {
   }
 
-  inline static Harmonic fromMinMax(double min, double max, double period,
-                                    double phase = 0.0) {
-    return Harmonic(0.5 * (min + max), max - min, period, phase);
+  static constexpr BasicHarmonic fromMinMax(T min, T max, double period,
+                                            double phase = 0.0) {
+    return BasicHarmonic(T(0.5) * (min + max), max - min, period, phase);
   }
-  inline static Harmonic fromCentre(double centre, double amplitude,
-                                    double period, double phase = 0.0) {
-    return Harmonic(centre, amplitude, period, phase);
+  static constexpr BasicHarmonic fromCentre(T centre, T amplitude,
+                                            double period,
+                                            double phase = 0.0) {
+    return BasicHarmonic(centre, amplitude, period, phase);
   }
 
-  inline double at(double t) const {
-    return _centre + _amplitude * std::sin((t * 2.0 * M_PI / _period) + _phase);
+  inline T at(double t) const {
+    return _centre + _amplitude * static_cast<T>(std::sin(
+                                      (t * 2.0 * M_PI / _period) + _phase));
   }
 
-  double _centre;
-  double _amplitude;
+  T _centre;
+  T _amplitude;
   double _period;
   double _phase;
 };
 
+using Harmonic = BasicHarmonic<double>;
+using HarmonicF = BasicHarmonic<float>;
+
 /**
  * @brief A linearly-interpolated 1-dimensional lookup table (LUT).
  *
  * @tparam N the number of samples in the LUT. e.g.: Lut1D<3> samples from a
  * std::array<double, 3>.
+ * @tparam T the type of the samples, and of the coordinate (float or double).
  */
-template <int N> struct Lut1D {
+template <int N, typename T = double> struct Lut1D {
   Lut1D() = delete;
-  Lut1D(double a, double b) : _from{a}, _to{b}, _spread{b - a} {}
+  Lut1D(T a, T b) : _from{a}, _to{b}, _spread{b - a} {}
 
-  double _from;
-  double _to;
-  double _spread;
+  T _from;
+  T _to;
+  T _spread;
 
-  std::array<double, N> _samples{};
+  std::array<T, N> _samples{};
 
-  inline double at(double x) const {
-    auto xnorm = std::clamp((x - _from) / _spread, 0.0, 1.0);
-    int A = std::floor(xnorm * (N - 1));
+  inline T at(T x) const {
+    auto xnorm = std::clamp((x - _from) / _spread, T(0), T(1));
+    int A = static_cast<int>(std::floor(xnorm * (N - 1)));
     int B = (A + 1) % N;
-    double t = xnorm * static_cast<double>(N - 1) - static_cast<double>(A);
+    T t = xnorm * static_cast<T>(N - 1) - static_cast<T>(A);
     return std::lerp(_samples[A], _samples[B], t);
   }
 };
 
 /**
- * @brief A linearly-interpolated 2-dimensional lookup table (LUT).
+ * @brief A bilinearly-interpolated 2-dimensional lookup table (LUT).
  *
- * @tparam N The number of samples in the LUT's first index.
- * @tparam M The number of samples in the LUT's second index.
+ * @tparam N The number of samples in the LUT's first index, over [a, b].
+ * @tparam M The number of samples in the LUT's second index, over [x, y].
+ * @tparam T the type of the samples, and of the coordinates (float or double).
  */
-template <int N, int M> struct Lut2D {
+template <int N, int M, typename T = double> struct Lut2D {
   Lut2D() = delete;
-  Lut2D(double a, double b, double x, double y)
+  Lut2D(T a, T b, T x, T y)
       : _a{a}, _b{b}, _spread_ab{b - a}, _x{x}, _y{y}, _spread_xy{y - x} {}
 
-  double _a;
-  double _b;
-  double _spread_ab;
-  double _x;
-  double _y;
-  double _spread_xy;
-
-  std::array<std::array<double, M>, N> _samples{};
-
-  inline double at(double u, double v) const { return 0.0; }
+  T _a;
+  T _b;
+  T _spread_ab;
+  T _x;
+  T _y;
+  T _spread_xy;
+
+  std::array<std::array<T, M>, N> _samples{};
+
+  inline T at(T u, T v) const {
+    auto unorm = std::clamp((u - _a) / _spread_ab, T(0), T(1)) * (N - 1);
+    auto vnorm = std::clamp((v - _x) / _spread_xy, T(0), T(1)) * (M - 1);
+    int A = static_cast<int>(std::floor(unorm));
+    int C = static_cast<int>(std::floor(vnorm));
+    int B = std::min(A + 1, N - 1);
+    int D = std::min(C + 1, M - 1);
+    T s = unorm - static_cast<T>(A);
+    T t = vnorm - static_cast<T>(C);
+    return std::lerp(std::lerp(_samples[A][C], _samples[A][D], t),
+                     std::lerp(_samples[B][C], _samples[B][D], t), s);
+  }
 };
 
 /**
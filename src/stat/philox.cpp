@@ -0,0 +1,103 @@
+#include "philox.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace circular;
+
+namespace {
+/// @brief How many blocks are generated at once, one per vector lane.
+constexpr size_t TileBlocks = 64;
+
+/// @brief Words of consecutive blocks, laid out word-major, so that each
+/// round of Philox is a loop over lanes which the compiler vectorizes.
+struct Tile {
+  uint32_t w0[TileBlocks], w1[TileBlocks], w2[TileBlocks], w3[TileBlocks];
+
+  void generate(rng::PhiloxKey key, uint64_t step, uint64_t first) {
+    for (size_t i = 0; i < TileBlocks; ++i) {
+      w0[i] = static_cast<uint32_t>(first + i);
+      w1[i] = static_cast<uint32_t>((first + i) >> 32);
+      w2[i] = static_cast<uint32_t>(step);
+      w3[i] = static_cast<uint32_t>(step >> 32);
+    }
+    // Impl: as rng::philox4x32
+    for (int round = 0; round < 10; ++round) {
+      for (size_t i = 0; i < TileBlocks; ++i) {
+        const auto p0 = uint64_t{0xD2511F53} * w0[i];
+        const auto p1 = uint64_t{0xCD9E8D57} * w2[i];
+        w0[i] = static_cast<uint32_t>(p1 >> 32) ^ w1[i] ^ key[0];
+        w1[i] = static_cast<uint32_t>(p1);
+        w2[i] = static_cast<uint32_t>(p0 >> 32) ^ w3[i] ^ key[1];
+        w3[i] = static_cast<uint32_t>(p0);
+      }
+      key[0] += 0x9E3779B9;
+      key[1] += 0xBB67AE85;
+    }
+  }
+
+  /// @brief The two uniform draws of each block, in index order.
+  void uniforms(double *out) const {
+    for (size_t i = 0; i < TileBlocks; ++i) {
+      out[2 * i] = rng::Philox::toUniform(w0[i], w1[i]);
+      out[2 * i + 1] = rng::Philox::toUniform(w2[i], w3[i]);
+    }
+  }
+};
+
+/// @brief The Box-Muller pair from two uniform draws; u1 is flipped to
+/// (0, 1] so that its logarithm is finite.
+inline void boxMuller(double u1, double u2, double &z0, double &z1) {
+  const auto r = std::sqrt(-2.0 * std::log(1.0 - u1));
+  const auto theta = 2.0 * M_PI * u2;
+  z0 = r * std::cos(theta);
+  z1 = r * std::sin(theta);
+}
+
+/// @brief values[i] = draw(first + i), where draw makes a tile's worth of
+/// draws into its second argument.
+template <typename F>
+void fillTiles(uint64_t first, std::span<double> values, F &&draw) {
+  constexpr size_t PerTile = 2 * TileBlocks;
+  double drawn[PerTile];
+  size_t done = 0;
+  while (done < values.size()) {
+    const auto index = first + done;
+    draw(index / 2, drawn);
+    const auto skip = static_cast<size_t>(index % 2);
+    const auto n = std::min(values.size() - done, PerTile - skip);
+    std::copy_n(drawn + skip, n, values.begin() + static_cast<ptrdiff_t>(done));
+    done += n;
+  }
+}
+} // namespace
+
+double circular::rng::Philox::normal(uint64_t step, uint64_t index) const {
+  const auto b = block(step, index / 2);
+  double z0 = 0.0;
+  double z1 = 0.0;
+  boxMuller(toUniform(b[0], b[1]), toUniform(b[2], b[3]), z0, z1);
+  return (index % 2 == 0) ? z0 : z1;
+}
+
+void circular::rng::Philox::uniform(uint64_t step, uint64_t first,
+                                    std::span<double> values) const {
+  Tile tile{};
+  fillTiles(first, values, [&](uint64_t block, double *drawn) {
+    tile.generate(_key, step, block);
+    tile.uniforms(drawn);
+  });
+}
+
+void circular::rng::Philox::normal(uint64_t step, uint64_t first,
+                                   std::span<double> values) const {
+  Tile tile{};
+  fillTiles(first, values, [&](uint64_t block, double *drawn) {
+    tile.generate(_key, step, block);
+    tile.uniforms(drawn);
+    for (size_t i = 0; i < TileBlocks; ++i) {
+      boxMuller(drawn[2 * i], drawn[2 * i + 1], drawn[2 * i],
+                drawn[2 * i + 1]);
+    }
+  });
+}
@@ -0,0 +1,94 @@
+/**
+ * @file philox.hpp
+ * @author Alex Laing (livingearthcompany@gmail.com)
+ * @brief Counter-based random numbers (Philox4x32-10), for stochastic forcing
+ * which must be reproducible however the work is split across threads.
+ */
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <span>
+
+namespace circular {
+namespace rng {
+
+using PhiloxCounter = std::array<uint32_t, 4>;
+using PhiloxKey = std::array<uint32_t, 2>;
+
+/// @brief The Philox4x32 bijection of counter under key, with 10 rounds
+/// (Salmon et al., "Parallel random numbers: as easy as 1, 2, 3", 2011).
+constexpr PhiloxCounter philox4x32(PhiloxCounter counter, PhiloxKey key) {
+  constexpr uint64_t M0 = 0xD2511F53;
+  constexpr uint64_t M1 = 0xCD9E8D57;
+  constexpr uint32_t W0 = 0x9E3779B9;
+  constexpr uint32_t W1 = 0xBB67AE85;
+  for (int round = 0; round < 10; ++round) {
+    const auto p0 = M0 * counter[0];
+    const auto p1 = M1 * counter[2];
+    counter = {static_cast<uint32_t>(p1 >> 32) ^ counter[1] ^ key[0],
+               static_cast<uint32_t>(p1),
+               static_cast<uint32_t>(p0 >> 32) ^ counter[3] ^ key[1],
+               static_cast<uint32_t>(p0)};
+    key[0] += W0;
+    key[1] += W1;
+  }
+  return counter;
+}
+
+/**
+ * @brief Random draws which are a pure function of (seed, step, index).
+ *
+ * There is no state to share or advance: any thread can draw any value, so
+ * a field of per-cell noise is the same however it is split into chunks or
+ * across Tasker workers. Each Philox block, at counter (index / 2, step)
+ * under the seed, gives two uniform draws, and the two normal draws made from
+ * them by the Box-Muller transform. To draw several values per cell per step,
+ * use e.g. index = cell * draws + draw, or a different seed per quantity.
+ */
+class Philox {
+public:
+  constexpr explicit Philox(uint64_t seed)
+      : _key{static_cast<uint32_t>(seed), static_cast<uint32_t>(seed >> 32)} {}
+
+  constexpr uint64_t seed() const {
+    return _key[0] | (static_cast<uint64_t>(_key[1]) << 32);
+  }
+
+  /// @brief The 128 random bits of a block.
+  constexpr PhiloxCounter block(uint64_t step, uint64_t block) const {
+    return philox4x32({static_cast<uint32_t>(block),
+                       static_cast<uint32_t>(block >> 32),
+                       static_cast<uint32_t>(step),
+                       static_cast<uint32_t>(step >> 32)},
+                      _key);
+  }
+
+  /// @brief A draw from the uniform distribution on [0, 1), of 53 bits.
+  constexpr double uniform(uint64_t step, uint64_t index) const {
+    const auto b = block(step, index / 2);
+    return (index % 2 == 0) ? toUniform(b[0], b[1]) : toUniform(b[2], b[3]);
+  }
+
+  /// @brief A draw from the standard normal distribution.
+  double normal(uint64_t step, uint64_t index) const;
+
+  /// @brief values[i] = uniform(step, first + i), a few blocks at a time.
+  void uniform(uint64_t step, uint64_t first, std::span<double> values) const;
+
+  /// @brief values[i] = normal(step, first + i).
+  void normal(uint64_t step, uint64_t first, std::span<double> values) const;
+
+  /// @brief The top 53 of the 64 bits lo | hi << 32, as a fraction.
+  static constexpr double toUniform(uint32_t lo, uint32_t hi) {
+    const auto bits = lo | (static_cast<uint64_t>(hi) << 32);
+    return static_cast<double>(bits >> 11) * 0x1p-53;
+  }
+
+private:
+  PhiloxKey _key;
+};
+
+} // namespace rng
+} // namespace circular
@@ -1,82 +1,47 @@
 #include "planets.hpp"
 
+#include <algorithm>
 #include <cmath>
-
-#include "trick_math.hpp"
+#include <stdexcept>
 
 using namespace circular;
 
-double circular::astro::planetSurfaceArea(double radius) {
-  return 4.0 * M_PI * _pow2(radius);
-}
-
-double circular::astro::planetMass(double density, double radius) {
-  return (4.0 / 3.0) * M_PI * density * _pow3(radius);
-}
-
-double circular::astro::planetSurfaceGravity(double density, double radius) {
-  return param::NewtonConst * planetMass(density, radius) / _pow2(radius);
-}
-
-double circular::astro::orbitalPeriod(double semiMajorAxis,
-                                      double primaryMass) {
-  return 2.0 * M_PI *
-         std::sqrt(_pow3(semiMajorAxis) / (param::NewtonConst * primaryMass));
-}
-
-double circular::astro::sunMass(double sunSize) {
-  return std::pow(sunSize, 1.25) * param::MassSun;
-}
-
-double circular::astro::sunEmission(double sunTemp) {
-  return param::StefanBoltzmannConst * _pow4(sunTemp);
-}
-
-double circular::astro::sunConstant(double sunTemp, double sunSize,
-                                    double distance) {
-  auto area_ratio = _pow2(sunSize * param::RadiusSun) / _pow2(distance);
-  return sunEmission(sunTemp) * area_ratio;
-}
-
-double circular::astro::planetaryBalanceTemperature(double sunConstant,
-                                                    double bondAlbedo,
-                                                    double emissivity) {
-  auto balance_emission = (1.0 - bondAlbedo) * sunConstant /
-                          (4.0 * param::StefanBoltzmannConst * emissivity);
-  return std::pow(balance_emission, 0.25);
-}
-
-double circular::astro::sunApparentSize(double sunSize, double distance) {
-  return 2.0 * std::asin(sunSize * param::RadiusSun / distance);
-}
-
-double circular::astro::calcTrueAnomaly(double eccentricity, double timeInYear,
-                                        double timeOfPeriapsis) {
-  /// Impl: Copied from pan-gaia. This is an approximation via a Taylor series
-  /// expansion. Is it necessary now?
-  const double M = 2.0 * M_PI * timeInYear; // Mean anomaly
-  const auto &e = eccentricity;
-  return M + 2 * e * std::sin(M) + (5. / 4.) * e * e * std::sin(2 * M);
-}
-
-double circular::astro::calcDeclination(double axialTilt, double trueAnomaly,
-                                        double timeInYear) {
-  return axialTilt * std::sin(trueAnomaly);
-}
-
-double circular::astro::calcDailySunExposure(double latitude,
-                                             double declination) {
-  // Impl: Copied from pan-gaia.
-  const auto determinant = -std::tan(latitude) * std::tan(declination);
-  double H0 = 0.0; // sunrise hour
-
-  if (determinant <= -1.0) { // check for no sunrise
-    H0 = M_PI;
-  } else if (determinant < 1.0) {
-    H0 = std::acos(determinant);
+template <typename Math, typename T>
+void circular::astro::calcDailySunExposure(
+    std::span<const std::type_identity_t<T>> latitudes, double declination,
+    std::span<std::type_identity_t<T>> exposure) {
+  if (latitudes.size() != exposure.size()) {
+    throw std::invalid_argument{
+        "calcDailySunExposure: latitudes and exposure differ in size"};
   }
 
-  return std::max(0.0, M_1_PI * H0 * std::sin(H0) * std::sin(latitude) *
-                           std::sin(declination) * std::cos(latitude) *
-                           std::cos(declination));
+  const auto sin_decl = Math::sin(declination);
+  const auto cos_decl = Math::cos(declination);
+  const auto tan_decl = Math::tan(declination);
+
+  // Impl: the branches of the scalar version are a clamp of the determinant
+  // to [-1, 1], since acos(-1) == pi and acos(1) == 0. Written this way, the
+  // loop body is branch-free and vectorizes.
+  for (size_t i = 0; i < latitudes.size(); ++i) {
+    // Impl: a float latitude of a pole rounds beyond it, where cos < 0
+    const double lat = std::clamp<double>(latitudes[i], -M_PI_2, M_PI_2);
+    const auto sin_lat = Math::sin(lat);
+    const auto cos_lat = Math::cos(lat);
+    const auto determinant =
+        std::clamp(-(sin_lat / cos_lat) * tan_decl, -1.0, 1.0);
+    const auto H0 = Math::acos(determinant);
+    exposure[i] = static_cast<T>(
+        std::max(0.0, M_1_PI * (H0 * sin_lat * sin_decl +
+                                cos_lat * cos_decl * Math::sin(H0))));
+  }
 }
+
+// Explicit instantiations for each precision policy and scalar type
+template void circular::astro::calcDailySunExposure<math::Precise, double>(
+    std::span<const double>, double, std::span<double>);
+template void circular::astro::calcDailySunExposure<math::Fast, double>(
+    std::span<const double>, double, std::span<double>);
+template void circular::astro::calcDailySunExposure<math::Precise, float>(
+    std::span<const float>, double, std::span<float>);
+template void circular::astro::calcDailySunExposure<math::Fast, float>(
+    std::span<const float>, double, std::span<float>);
@@ -7,47 +7,74 @@
 
 #pragma once
 
+#include <algorithm>
+#include <span>
+#include <type_traits>
+
 #include "constants.hpp"
+#include "fast_math.hpp"
 #include "parameter.hpp"
+#include "trick_math.hpp"
 
 namespace circular {
 namespace astro {
+// Impl: the scalar functions are constexpr and header-inline, so that derived
+// values for a fixed planet fold to constants (see static_world.hpp). Those
+// that need libm are templated on a math:: precision policy (see
+// fast_math.hpp), which is also what makes them constexpr-safe.
+
 /// @brief The area of a sphere with radius Radius.
 /// @param Radius
 /// @return in square meters [m^2].
-double planetSurfaceArea(double radius);
+constexpr double planetSurfaceArea(double radius) {
+  return 4.0 * M_PI * _pow2(radius);
+}
 
 /// @brief The mass of a sphere with density Density and radius Radius.
 /// @param Density
 /// @param Radius
 /// @return in kilograms [kg].
-double planetMass(double density, double radius);
+constexpr double planetMass(double density, double radius) {
+  return (4.0 / 3.0) * M_PI * density * _pow3(radius);
+}
 
 /// @brief The surface gravity of a sphere with density Density and radius
 /// Radius.
 /// @param Density
 /// @param Radius
 /// @return in metres per square second [m / s^2]
-double planetSurfaceGravity(double density, double radius);
+constexpr double planetSurfaceGravity(double density, double radius) {
+  return param::NewtonConst * planetMass(density, radius) / _pow2(radius);
+}
 
 /// @brief The orbital period of a body with semi-major axis SemiMajorAxis,
 /// orbiting a (much more massive) primary body of mass PrimaryMass.
 /// @param SemiMajorAxis
 /// @param PrimaryMass
 /// @return in seconds [s].
-double orbitalPeriod(double semiMajorAxis, double primaryMass);
+template <typename Math = math::Precise>
+constexpr double orbitalPeriod(double semiMajorAxis, double primaryMass) {
+  return 2.0 * M_PI *
+         Math::sqrt(_pow3(semiMajorAxis) / (param::NewtonConst * primaryMass));
+}
 
 /// @brief The mass of a main-branch star which is SunSize times our Sun's
 /// radius. For Sun-like stars, the relationship R = M^{0.8} holds.
 /// @param SunSize
 /// @return in kilograms [kg].
-double sunMass(double sunSize);
+template <typename Math = math::Precise>
+constexpr double sunMass(double sunSize) {
+  // Impl: x^{5/4} == x * x^{1/4}, which avoids std::pow
+  return sunSize * Math::root4(sunSize) * param::MassSun;
+}
 
 /// @brief The outgoing energy per unit area of a blackbody at temperature
 /// SunTemp.
 /// @param SunTemp
 /// @return in Watts per square metre [W / m^2].
-double sunEmission(double sunTemp);
+constexpr double sunEmission(double sunTemp) {
+  return param::StefanBoltzmannConst * _pow4(sunTemp);
+}
 
 /// @brief The incoming energy per unit area, at a distance Distance, from a
 /// star of temperature SunTemp and radius SunSize (in radii of our Sun).
@@ -55,7 +82,35 @@ double sunEmission(double sunTemp);
 /// @param SunSize
 /// @param SemiMajorAxis
 /// @return in Watts per square metre [W / m^2].
-double sunConstant(double sunTemp, double sunSize, double distance);
+constexpr double sunConstant(double sunTemp, double sunSize, double distance) {
+  auto area_ratio = _pow2(sunSize * param::RadiusSun) / _pow2(distance);
+  return sunEmission(sunTemp) * area_ratio;
+}
+
+/**
+ * @brief A star which lights the body, as seen from the body.
+ *
+ * A body may have several, e.g. a circumbinary planet. The first is the
+ * primary, which sets the declination and hour angle of the insolation
+ * kernels; the others are placed relative to it, by how much later they
+ * cross the meridian and how much further north they are.
+ */
+struct Star {
+  double size = 1.0;                         // [radii of our Sun]
+  double temp = param::TempSun;              // [K]
+  double distance = param::AstronomicalUnit; // from the body [m]
+  double hourOffset = 0.0;                   // [rad]
+  double declinationOffset = 0.0;            // [rad]
+
+  bool operator==(const Star &) const = default;
+};
+
+/// @brief The incoming energy per unit area from Star.
+/// @param star
+/// @return in Watts per square metre [W / m^2].
+constexpr double sunConstant(const Star &star) {
+  return sunConstant(star.temp, star.size, star.distance);
+}
 
 /// @brief The equilibrium temperature for a rotating body with Bond albedo
 /// BondAlbedo, experiencing an incoming energy flux of SunConstant.
@@ -63,15 +118,24 @@ double sunConstant(double sunTemp, double sunSize, double distance);
 /// @param BondAlbedo
 /// @param emissivity
 /// @return in Kelvin [K].
-double planetaryBalanceTemperature(double sunConstant, double bondAlbedo,
-                                   double emissivity = 0.95);
+template <typename Math = math::Precise>
+constexpr double planetaryBalanceTemperature(double sunConstant,
+                                             double bondAlbedo,
+                                             double emissivity = 0.95) {
+  auto balance_emission = (1.0 - bondAlbedo) * sunConstant /
+                          (4.0 * param::StefanBoltzmannConst * emissivity);
+  return Math::root4(balance_emission);
+}
 
 /// @brief The apparent angular size for a body of size SunSize (in radii of our
 /// Sun), seen at a distance Distance.
 /// @param SunSize
 /// @param Distance
 /// @return in radians.
-double sunApparentSize(double sunSize, double distance);
+template <typename Math = math::Precise>
+constexpr double sunApparentSize(double sunSize, double distance) {
+  return 2.0 * Math::asin(sunSize * param::RadiusSun / distance);
+}
 
 /// @brief The true anomaly of a body, in an orbit of eccentricity Eccentricity,
 /// at fractional time of the orbit [0..1) timeInYear. The periapsis is assumed
@@ -80,8 +144,15 @@ double sunApparentSize(double sunSize, double distance);
 /// @param year
 /// @param timeInYear
 /// @return in radians.
-double calcTrueAnomaly(double eccentricity, double timeInYear,
-                       double timeOfPeriapsis = 0.0);
+template <typename Math = math::Precise>
+constexpr double calcTrueAnomaly(double eccentricity, double timeInYear,
+                                 double timeOfPeriapsis = 0.0) {
+  /// Impl: Copied from pan-gaia. This is an approximation via a Taylor series
+  /// expansion. Is it necessary now?
+  const double M = 2.0 * M_PI * timeInYear; // Mean anomaly
+  const auto &e = eccentricity;
+  return M + 2 * e * Math::sin(M) + (5. / 4.) * e * e * Math::sin(2 * M);
+}
 
 /// @brief Calculate the solar declination on a planet with tilt AxialTilt and
 /// orbital true anomaly TrueAnomaly, at a fractional time in the year [0..1]
@@ -90,7 +161,11 @@ double calcTrueAnomaly(double eccentricity, double timeInYear,
 /// @param trueAnomaly
 /// @param timeInYear
 /// @return in radians.
-double calcDeclination(double axialTilt, double trueAnomaly, double timeInYear);
+template <typename Math = math::Precise>
+constexpr double calcDeclination(double axialTilt, double trueAnomaly,
+                                 double timeInYear) {
+  return axialTilt * Math::sin(trueAnomaly);
+}
 
 /// @brief Calculate the average exposure per rotation, of a location on a
 /// rotating planet, at latitude Latitude, to a sun at declination Declination.
@@ -101,8 +176,46 @@ double calcDeclination(double axialTilt, double trueAnomaly, double timeInYear);
 /// @param declination
 /// @return dimensionless ratio in [0..1], corresponding to the fractional
 /// brightness of a _constant, direct illumination_ that would match the daily
-/// average energy from the moving sun at that latitude.
-double calcDailySunExposure(double latitude, double declination);
+/// average energy from the moving sun at that latitude. This is
+/// astro::calcSunExposure over any whole day (see insolation.hpp), and
+/// astro::calcDailyInsolation is the sum over stars of sunConstant times it.
+template <typename Math = math::Precise>
+constexpr double calcDailySunExposure(double latitude, double declination) {
+  // Impl: Copied from pan-gaia.
+  const auto determinant = -Math::tan(latitude) * Math::tan(declination);
+  double H0 = 0.0; // sunrise hour
+
+  if (determinant <= -1.0) { // check for no sunrise
+    H0 = M_PI;
+  } else if (determinant < 1.0) {
+    H0 = Math::acos(determinant);
+  }
+
+  // Impl: the mean over a day of sin(lat) sin(decl) + cos(lat) cos(decl)
+  // cos(h), where that is positive, i.e. for |h| <= H0
+  return std::max(0.0, M_1_PI * (H0 * Math::sin(latitude) *
+                                     Math::sin(declination) +
+                                 Math::cos(latitude) * Math::cos(declination) *
+                                     Math::sin(H0)));
+}
+
+/// @brief calcDailySunExposure over a whole array of latitudes, for a single
+/// declination. With math::Fast, the loop is vectorized. Explicitly
+/// instantiated for math::Precise and math::Fast, and float and double, in
+/// planets.cpp.
+///
+/// With float, the arrays take half the memory and bandwidth, but each value
+/// is still evaluated in double: near the terminator, the acos of the
+/// product of tangents is too ill-conditioned for float. The result is within
+/// a float rounding of the double one.
+/// @tparam T the type of latitudes and exposure, which is not deduced.
+/// @param latitudes
+/// @param declination
+/// @param exposure Output, of the same size as latitudes.
+template <typename Math = math::Precise, typename T = double>
+void calcDailySunExposure(std::span<const std::type_identity_t<T>> latitudes,
+                          double declination,
+                          std::span<std::type_identity_t<T>> exposure);
 
 } // namespace astro
 } // namespace circular
@@ -0,0 +1,268 @@
+#include "regrid.hpp"
+
+#include <algorithm>
+#include <circular/trace.hpp>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+#include <utility>
+
+using namespace circular;
+
+namespace {
+constexpr double TwoPi = 2.0 * M_PI;
+
+void checkEdges(const std::vector<double> &edges, const char *what) {
+  if (edges.size() < 2) {
+    throw std::invalid_argument{std::string{"LatLonGrid: fewer than two "} +
+                                what + " edges"};
+  }
+  for (size_t i = 0; i < edges.size(); ++i) {
+    if (!std::isfinite(edges[i]) || (i > 0 && !(edges[i] > edges[i - 1]))) {
+      throw std::invalid_argument{std::string{"LatLonGrid: "} + what +
+                                  " edges are not increasing"};
+    }
+  }
+}
+
+/// @brief For each target interval, the source intervals it overlaps and by
+/// how much, in order of source index.
+using Overlaps = std::vector<std::vector<std::pair<uint32_t, double>>>;
+
+/// @brief Latitude overlaps, measured in sin(latitude), which is in
+/// proportion to area.
+Overlaps latitudeOverlaps(const std::vector<double> &source,
+                          const std::vector<double> &target) {
+  Overlaps overlaps(target.size() - 1);
+  for (size_t t = 0; t + 1 < target.size(); ++t) {
+    for (size_t s = 0; s + 1 < source.size(); ++s) {
+      const auto low = std::max(source[s], target[t]);
+      const auto high = std::min(source[s + 1], target[t + 1]);
+      if (high > low) {
+        overlaps[t].emplace_back(static_cast<uint32_t>(s),
+                                 std::sin(high) - std::sin(low));
+      }
+    }
+  }
+  return overlaps;
+}
+
+/// @brief Longitude overlaps, in radians, for intervals which may be offset
+/// from each other by any number of turns.
+Overlaps longitudeOverlaps(const std::vector<double> &source,
+                           const std::vector<double> &target) {
+  Overlaps overlaps(target.size() - 1);
+  for (size_t t = 0; t + 1 < target.size(); ++t) {
+    for (size_t s = 0; s + 1 < source.size(); ++s) {
+      // Impl: every whole-turn shift of the source interval which could meet
+      // the target's; a cell spans at most one turn, so there are few
+      const auto first = std::ceil((target[t] - source[s + 1]) / TwoPi);
+      const auto last = std::floor((target[t + 1] - source[s]) / TwoPi);
+      double overlap = 0.0;
+      for (auto k = first; k <= last; ++k) {
+        const auto low = std::max(source[s] + k * TwoPi, target[t]);
+        const auto high = std::min(source[s + 1] + k * TwoPi, target[t + 1]);
+        overlap += std::max(0.0, high - low);
+      }
+      if (overlap > 0.0) {
+        overlaps[t].emplace_back(static_cast<uint32_t>(s), overlap);
+      }
+    }
+  }
+  return overlaps;
+}
+
+/// @brief target[row] for rows in [first, last).
+void multiplyRows(const std::vector<size_t> &rowStarts,
+                  const std::vector<uint32_t> &columns,
+                  const std::vector<double> &values,
+                  std::span<const double> source, std::span<double> target,
+                  size_t first, size_t last) {
+  for (size_t row = first; row < last; ++row) {
+    double sum = 0.0;
+    for (auto k = rowStarts[row]; k < rowStarts[row + 1]; ++k) {
+      sum += values[k] * source[columns[k]];
+    }
+    target[row] = sum;
+  }
+}
+
+double integral(std::span<const double> values,
+                const std::vector<double> &areas, const char *what) {
+  if (values.size() != areas.size()) {
+    throw std::invalid_argument{std::string{"Regridder::"} + what +
+                                ": values are not the size of the grid"};
+  }
+  double sum = 0.0;
+  for (size_t i = 0; i < values.size(); ++i) {
+    sum += values[i] * areas[i];
+  }
+  return sum;
+}
+} // namespace
+
+circular::grid::LatLonGrid::LatLonGrid(std::vector<double> latEdges,
+                                       std::vector<double> lonEdges)
+    : _latEdges{std::move(latEdges)}, _lonEdges{std::move(lonEdges)} {
+  checkEdges(_latEdges, "latitude");
+  checkEdges(_lonEdges, "longitude");
+  if (_latEdges.front() < -M_PI_2 || _latEdges.back() > M_PI_2) {
+    throw std::invalid_argument{"LatLonGrid: latitude edges are beyond a pole"};
+  }
+  if (_lonEdges.back() - _lonEdges.front() > TwoPi) {
+    throw std::invalid_argument{
+        "LatLonGrid: longitude edges span more than a turn"};
+  }
+}
+
+grid::LatLonGrid circular::grid::LatLonGrid::uniform(size_t lats,
+                                                     size_t lons) {
+  if (lats == 0 || lons == 0) {
+    throw std::invalid_argument{"LatLonGrid::uniform: no cells"};
+  }
+  std::vector<double> latEdges(lats + 1);
+  for (size_t i = 0; i <= lats; ++i) {
+    latEdges[i] = -M_PI_2 + M_PI * static_cast<double>(i) / lats;
+  }
+  std::vector<double> lonEdges(lons + 1);
+  for (size_t j = 0; j <= lons; ++j) {
+    lonEdges[j] = TwoPi * static_cast<double>(j) / lons;
+  }
+  // Impl: exactly the poles, whatever the rounding above
+  latEdges.front() = -M_PI_2;
+  latEdges.back() = M_PI_2;
+  return LatLonGrid{std::move(latEdges), std::move(lonEdges)};
+}
+
+std::vector<double>
+circular::grid::LatLonGrid::cellAreas(double radius) const {
+  std::vector<double> areas{};
+  areas.reserve(size());
+  for (size_t i = 0; i < lats(); ++i) {
+    const auto band = radius * radius *
+                      (std::sin(_latEdges[i + 1]) - std::sin(_latEdges[i]));
+    for (size_t j = 0; j < lons(); ++j) {
+      areas.push_back(band * (_lonEdges[j + 1] - _lonEdges[j]));
+    }
+  }
+  return areas;
+}
+
+circular::grid::Regridder::Regridder(const LatLonGrid &source,
+                                     const LatLonGrid &target,
+                                     const World &world)
+    : _source{source}, _target{target}, _sourceAreas{source.cellAreas(world)},
+      _targetAreas{target.cellAreas(world)} {
+  CIRCULAR_TRACE_ZONE("Regridder::Regridder");
+  if (source.size() > std::numeric_limits<uint32_t>::max()) {
+    throw std::invalid_argument{"Regridder: the source grid is too large"};
+  }
+
+  // Impl: both grids are products of latitude and longitude intervals, so
+  // the overlap of two cells is the product of their overlaps along each
+  // axis, and these are all that need searching for
+  const auto lat = latitudeOverlaps(source.latEdges(), target.latEdges());
+  const auto lon = longitudeOverlaps(source.lonEdges(), target.lonEdges());
+
+  auto weights = std::make_shared<Weights>();
+  weights->rowStarts.reserve(target.size() + 1);
+  weights->rowStarts.push_back(0);
+  for (size_t ti = 0; ti < target.lats(); ++ti) {
+    for (size_t tj = 0; tj < target.lons(); ++tj) {
+      // Impl: divide by the area the source covers, not the whole cell's, so
+      // that each row's weights sum to 1 even where the target overhangs
+      double covered = 0.0;
+      for (const auto &[si, dLat] : lat[ti]) {
+        for (const auto &[sj, dLon] : lon[tj]) {
+          weights->columns.push_back(
+              static_cast<uint32_t>(si * source.lons() + sj));
+          weights->values.push_back(dLat * dLon);
+          covered += dLat * dLon;
+        }
+      }
+      for (auto k = weights->rowStarts.back(); k < weights->values.size();
+           ++k) {
+        weights->values[k] /= covered;
+      }
+      weights->rowStarts.push_back(weights->columns.size());
+    }
+  }
+
+  // Impl: rows are in latitude order, so the source cells a run of rows
+  // reads are a band; cut a block wherever that band would outgrow the cache
+  weights->blocks.push_back(0);
+  auto low = std::numeric_limits<uint32_t>::max();
+  uint32_t high = 0;
+  for (size_t row = 0; row < target.size(); ++row) {
+    auto rowLow = std::numeric_limits<uint32_t>::max();
+    uint32_t rowHigh = 0;
+    for (auto k = weights->rowStarts[row]; k < weights->rowStarts[row + 1];
+         ++k) {
+      rowLow = std::min(rowLow, weights->columns[k]);
+      rowHigh = std::max(rowHigh, weights->columns[k]);
+    }
+    const auto start = weights->blocks.back();
+    const auto bandLow = std::min(low, rowLow);
+    const auto bandHigh = std::max(high, rowHigh);
+    if (row > start && (row - start >= BlockRows ||
+                        (bandLow <= bandHigh &&
+                         bandHigh - bandLow >= BlockColumns))) {
+      weights->blocks.push_back(row);
+      low = rowLow;
+      high = rowHigh;
+    } else {
+      low = bandLow;
+      high = bandHigh;
+    }
+  }
+  weights->blocks.push_back(target.size());
+  _weights = std::move(weights);
+}
+
+void circular::grid::Regridder::_check(std::span<const double> source,
+                                       std::span<double> target) const {
+  if (source.size() != _source.size()) {
+    throw std::invalid_argument{
+        "Regridder: source values are not the size of the source grid"};
+  }
+  if (target.size() != _target.size()) {
+    throw std::invalid_argument{
+        "Regridder: target values are not the size of the target grid"};
+  }
+}
+
+void circular::grid::Regridder::apply(std::span<const double> source,
+                                      std::span<double> target) const {
+  CIRCULAR_TRACE_ZONE("Regridder::apply");
+  _check(source, target);
+  const auto &w = *_weights;
+  for (size_t b = 0; b + 1 < w.blocks.size(); ++b) {
+    multiplyRows(w.rowStarts, w.columns, w.values, source, target,
+                 w.blocks[b], w.blocks[b + 1]);
+  }
+}
+
+Future<> circular::grid::Regridder::applyAsync(std::span<const double> source,
+                                               std::span<double> target,
+                                               Tasker &tasker) const {
+  _check(source, target);
+  std::vector<Future<>> parts{};
+  const auto weights = _weights;
+  for (size_t b = 0; b + 1 < weights->blocks.size(); ++b) {
+    parts.push_back(tasker.Submit([=]() {
+      multiplyRows(weights->rowStarts, weights->columns, weights->values,
+                   source, target, weights->blocks[b], weights->blocks[b + 1]);
+    }));
+  }
+  return when_all(std::move(parts));
+}
+
+double circular::grid::Regridder::sourceIntegral(
+    std::span<const double> values) const {
+  return integral(values, _sourceAreas, "sourceIntegral");
+}
+
+double circular::grid::Regridder::targetIntegral(
+    std::span<const double> values) const {
+  return integral(values, _targetAreas, "targetIntegral");
+}
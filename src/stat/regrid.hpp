@@ -0,0 +1,135 @@
+/**
+ * @file regrid.hpp
+ * @author Alex Laing (livingearthcompany@gmail.com)
+ * @brief Conservative regridding of fields between latitude x longitude grids
+ * of different resolutions, e.g. from a zonal energy balance model to a
+ * finer-grained atmosphere.
+ */
+
+#pragma once
+
+#include <circular/tasker.hpp>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <vector>
+
+#include "world.hpp"
+
+namespace circular {
+namespace grid {
+
+/**
+ * @brief A grid of cells bounded by lines of latitude and longitude.
+ *
+ * Edges are in radians and strictly increasing: latitudes within
+ * [-pi / 2, pi / 2], and longitudes spanning at most 2 pi, from anywhere.
+ * Cells are indexed latitude-major, i.e. cell (i, j) is at i * lons() + j.
+ * A zonal grid, of latitude bands, has longitude edges {0, 2 pi}.
+ */
+class LatLonGrid {
+public:
+  /// @brief Throws std::invalid_argument if there are fewer than two edges of
+  /// either kind, or they are out of range or not increasing.
+  LatLonGrid(std::vector<double> latEdges, std::vector<double> lonEdges);
+
+  /// @brief The whole sphere, in lats bands of equal latitude and lons
+  /// sectors of equal longitude. Throws std::invalid_argument if either is 0.
+  static LatLonGrid uniform(size_t lats, size_t lons);
+
+  size_t lats() const { return _latEdges.size() - 1; }
+  size_t lons() const { return _lonEdges.size() - 1; }
+  size_t size() const { return lats() * lons(); }
+
+  const std::vector<double> &latEdges() const { return _latEdges; }
+  const std::vector<double> &lonEdges() const { return _lonEdges; }
+
+  /// @brief The area of each cell on a sphere of the given radius, m^2.
+  std::vector<double> cellAreas(double radius) const;
+
+  /// @brief The area of each cell on world's body.
+  std::vector<double> cellAreas(const World &world) const {
+    return cellAreas(world.getBodyRadius());
+  }
+
+private:
+  std::vector<double> _latEdges;
+  std::vector<double> _lonEdges;
+};
+
+/**
+ * @brief First-order conservative remapping from one grid to another.
+ *
+ * Each target cell's value is the area-weighted mean of the source cells it
+ * overlaps, so a constant field stays constant. Where every target cell the
+ * source overlaps lies wholly within the source grid, the integral of a field
+ * is unchanged too; a target cell the source only partly covers takes the
+ * mean over the part it covers, which extends that mean over the rest of the
+ * cell. A target cell the source misses is 0. The overlap weights are
+ * computed once, when the Regridder is made, and kept as a sparse matrix in
+ * compressed rows, one per target cell.
+ *
+ * Rows are grouped into blocks whose source cells span at most
+ * BlockColumns, so that while a block is applied the part of the source it
+ * reads stays in cache; blocks are independent, so applyAsync() runs them as
+ * Tasker tasks.
+ */
+class Regridder {
+public:
+  /// @brief The most source cells (doubles) one block of rows reads from.
+  static constexpr size_t BlockColumns = size_t{1} << 15;
+  /// @brief The most target cells (rows) in one block.
+  static constexpr size_t BlockRows = 1024;
+
+  /// @brief Weights from source to target, with cell areas on world's body.
+  /// Throws std::invalid_argument if source has 2^32 cells or more.
+  Regridder(const LatLonGrid &source, const LatLonGrid &target,
+            const World &world);
+
+  const LatLonGrid &source() const { return _source; }
+  const LatLonGrid &target() const { return _target; }
+
+  /// @brief The cell areas of each grid, on the body this was made for.
+  const std::vector<double> &sourceAreas() const { return _sourceAreas; }
+  const std::vector<double> &targetAreas() const { return _targetAreas; }
+
+  /// @brief The number of overlapping (source, target) pairs.
+  size_t nonZeros() const { return _weights->columns.size(); }
+  /// @brief The number of blocks of rows, i.e. of tasks for applyAsync().
+  size_t blocks() const { return _weights->blocks.size() - 1; }
+
+  /// @brief Remap values on the source grid to the target grid.
+  /// Throws std::invalid_argument if either is the wrong size.
+  void apply(std::span<const double> source, std::span<double> target) const;
+
+  /// @brief As apply(), a block of rows per task on tasker. source and target
+  /// must outlive the returned Future; the Regridder need not.
+  Future<> applyAsync(std::span<const double> source, std::span<double> target,
+                      Tasker &tasker = Tasker::Get()) const;
+
+  /// @brief The integral of values over the source (or target) grid, i.e.
+  /// the sum of values times cell areas.
+  double sourceIntegral(std::span<const double> values) const;
+  double targetIntegral(std::span<const double> values) const;
+
+private:
+  /// @brief The sparse matrix, in compressed rows, and where each block of
+  /// rows starts; shared, so that tasks can outlive the Regridder.
+  struct Weights {
+    std::vector<size_t> rowStarts;
+    std::vector<uint32_t> columns;
+    std::vector<double> values;
+    std::vector<size_t> blocks;
+  };
+
+  void _check(std::span<const double> source, std::span<double> target) const;
+
+  LatLonGrid _source;
+  LatLonGrid _target;
+  std::vector<double> _sourceAreas;
+  std::vector<double> _targetAreas;
+  std::shared_ptr<const Weights> _weights;
+};
+
+} // namespace grid
+} // namespace circular
@@ -0,0 +1,91 @@
+#include "seawater.hpp"
+
+#include <stdexcept>
+#include <string>
+
+using namespace circular;
+
+namespace {
+void checkSizes(const ocean::WaterColumns &cells, const char *what) {
+  const auto n = cells.temperature.size();
+  if (cells.salinity.size() != n || cells.water.size() != n ||
+      cells.ice.size() != n) {
+    throw std::invalid_argument{std::string{what} +
+                                ": columns differ in size"};
+  }
+}
+} // namespace
+
+void circular::ocean::waterDensity(std::span<const double> temperatures,
+                                   std::span<double> density) {
+  if (temperatures.size() != density.size()) {
+    throw std::invalid_argument{
+        "waterDensity: temperatures and density differ in size"};
+  }
+  for (size_t i = 0; i < temperatures.size(); ++i) {
+    density[i] = waterDensity(temperatures[i]);
+  }
+}
+
+void circular::ocean::freezingPoint(std::span<const double> salinities,
+                                    std::span<double> freezing) {
+  if (salinities.size() != freezing.size()) {
+    throw std::invalid_argument{
+        "freezingPoint: salinities and freezing differ in size"};
+  }
+  for (size_t i = 0; i < salinities.size(); ++i) {
+    freezing[i] = freezingPoint(salinities[i]);
+  }
+}
+
+void circular::ocean::enthalpy(const WaterColumns &cells,
+                               std::span<double> out) {
+  checkSizes(cells, "enthalpy");
+  if (out.size() != cells.temperature.size()) {
+    throw std::invalid_argument{"enthalpy: cells and out differ in size"};
+  }
+  for (size_t i = 0; i < out.size(); ++i) {
+    out[i] = enthalpy(cells.temperature[i], cells.salinity[i], cells.water[i],
+                      cells.ice[i]);
+  }
+}
+
+void circular::ocean::freezeMelt(const WaterColumns &cells) {
+  checkSizes(cells, "freezeMelt");
+  constexpr auto T0 = param::TempZeroCelsius;
+  constexpr auto L = param::LHFusionWater;
+
+  // Impl: every step of the loop body is arithmetic, a clamp or a select, so
+  // that it vectorizes. The selects compute both sides, and pick the finite
+  // one for empty cells.
+  for (size_t i = 0; i < cells.temperature.size(); ++i) {
+    const auto temp = cells.temperature[i];
+    const auto water = cells.water[i];
+    const auto ice = cells.ice[i];
+    const auto salt = water * cells.salinity[i] * 1e-3;
+
+    const auto salt_capacity = salt * param::CpNaCl;
+    const auto capacity =
+        water * param::CpWater + salt_capacity + ice * param::CpIce;
+    const auto h = capacity * (temp - T0) - ice * L;
+
+    // The mass to freeze (or, if negative, melt) to end at freezing, found by
+    // solving enthalpy(freezing, ...) == h for it
+    const auto freezing = freezingPoint(cells.salinity[i]);
+    auto frozen = capacity * (freezing - temp) /
+                  (L + (param::CpWater - param::CpIce) * (freezing - T0));
+    const auto unfreezable = salt * 1e3 / param::SalinityBrine;
+    frozen = std::clamp(frozen, -ice, std::max(0.0, water - unfreezable));
+
+    const auto new_water = std::max(0.0, water - frozen);
+    const auto new_ice = std::max(0.0, ice + frozen);
+    const auto new_capacity =
+        new_water * param::CpWater + salt_capacity + new_ice * param::CpIce;
+    const auto new_temp = T0 + (h + new_ice * L) / new_capacity;
+
+    cells.temperature[i] = (new_capacity > 0.0) ? new_temp : temp;
+    cells.salinity[i] = (new_water > 0.0) ? salt * 1e3 / new_water : 0.0;
+    cells.water[i] = new_water;
+    cells.ice[i] = new_ice;
+  }
+}
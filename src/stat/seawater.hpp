@@ -0,0 +1,108 @@
+/**
+ * @file seawater.hpp
+ * @author Alex Laing (livingearthcompany@gmail.com)
+ * @brief Thermodynamics of salty water and sea ice: density, freezing point,
+ * enthalpy and freezing/melting, for single cells and for whole columns.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <span>
+
+#include "constants.hpp"
+#include "trick_math.hpp"
+
+namespace circular {
+namespace ocean {
+// Impl: temperatures are in Kelvin, as elsewhere. Salinity is grams of salt
+// (taken to be NaCl) per kilogram of liquid water, the unit of
+// param::SalinityBrine, which is also the most salt that water can hold here.
+
+/// @brief The density of fresh water at temperature Temp, from a quadratic
+/// fit which peaks at about 3.7 C.
+/// @param temp
+/// @return in kilograms per cubic metre [kg / m^3].
+constexpr double waterDensity(double temp) {
+  const auto celsius = temp - param::TempZeroCelsius;
+  return param::DensityWaterZero + param::DensityWaterLinTerm * celsius -
+         param::DensityWaterQuadTerm * _pow2(celsius);
+}
+
+/// @brief The freezing point of water with salinity Salinity, lowered from
+/// that of fresh water by the cryoscopic constant times the molality of the
+/// dissolved ions (two for each NaCl).
+/// @param salinity in grams per kilogram of water [g / kg], clamped to
+/// [0, param::SalinityBrine].
+/// @return in Kelvin [K].
+constexpr double freezingPoint(double salinity) {
+  const auto molality =
+      std::clamp(salinity, 0.0, param::SalinityBrine) / param::MolarMassNaCl;
+  return param::TempZeroCelsius -
+         2.0 * param::CryoscopicConstWater * molality;
+}
+
+/// @brief The enthalpy of a cell holding Water kilograms of liquid water with
+/// salinity Salinity, and Ice kilograms of (fresh) ice, at temperature Temp.
+/// It is zero for liquid water at 0 C, and freezing a kilogram of water at
+/// 0 C takes param::LHFusionWater from it.
+/// @param temp
+/// @param salinity
+/// @param water
+/// @param ice
+/// @return in Joules [J].
+constexpr double enthalpy(double temp, double salinity, double water,
+                          double ice) {
+  const auto heat_capacity = water * param::CpWater +
+                             water * salinity * 1e-3 * param::CpNaCl +
+                             ice * param::CpIce;
+  return heat_capacity * (temp - param::TempZeroCelsius) -
+         ice * param::LHFusionWater;
+}
+
+/**
+ * @brief Cells of an ocean or sea-ice column, as parallel arrays (structure of
+ * arrays), all of the same size. Masses may be per cell or per unit area, so
+ * long as they are consistent.
+ */
+struct WaterColumns {
+  std::span<double> temperature; // [K]
+  std::span<double> salinity;    // of the liquid water [g / kg]
+  std::span<double> water;       // liquid water [kg]
+  std::span<double> ice;         // [kg]
+};
+
+/// @brief waterDensity over a whole array. Vectorized.
+/// @param temperatures
+/// @param density Output, of the same size as temperatures.
+void waterDensity(std::span<const double> temperatures,
+                  std::span<double> density);
+
+/// @brief freezingPoint over a whole array. Vectorized.
+/// @param salinities
+/// @param freezing Output, of the same size as salinities.
+void freezingPoint(std::span<const double> salinities,
+                   std::span<double> freezing);
+
+/// @brief enthalpy of every cell. Vectorized.
+/// @param cells
+/// @param out Output, of the same size as cells.
+void enthalpy(const WaterColumns &cells, std::span<double> out);
+
+/**
+ * @brief Freeze water in cells below their freezing point, and melt ice in
+ * cells above it, exchanging latent for sensible heat. Vectorized.
+ *
+ * Each cell's enthalpy and salt are conserved exactly (to rounding): salt is
+ * rejected from freezing water into what stays liquid, and melting ice
+ * freshens it. A cell is brought to the freezing point of its salinity before
+ * the update, unless it runs out of water or ice first; as salinity changes
+ * with the update, a few calls converge to equilibrium. Water saturated with
+ * salt (at param::SalinityBrine) does not freeze further.
+ *
+ * Throws std::invalid_argument if the arrays of cells differ in size.
+ */
+void freezeMelt(const WaterColumns &cells);
+
+} // namespace ocean
+} // namespace circular
@@ -0,0 +1,129 @@
+/**
+ * @file static_world.hpp
+ * @author Alex Laing (livingearthcompany@gmail.com)
+ * @brief Declaration of StaticWorld, a compile-time counterpart to World for
+ * fixed-planet builds.
+ */
+
+#pragma once
+
+#include <vector>
+
+#include "constants.hpp"
+#include "parameter.hpp"
+#include "planets.hpp"
+#include "world.hpp"
+
+namespace circular {
+namespace presets {
+/**
+ * @brief The primaries of a World, as compile-time constants.
+ *
+ * A preset is any type with these static constexpr members; Earth and Venus
+ * are provided, matching World's defaults and tests/fixtures/venus.toml.
+ */
+struct Earth {
+  static constexpr double orbitRadius = param::AstronomicalUnit;
+  static constexpr double sunSize = 1.0;
+  static constexpr double sunTemp = param::TempSun;
+  static constexpr double eccMin = 0.0;
+  static constexpr double eccMax = 0.0;
+  static constexpr double eccPeriod = 4.13e+5;
+  static constexpr double eccPhase = M_PI / 6.0;
+  static constexpr double bodyPeriod = param::PeriodEarth;
+  static constexpr double bodyRadius = param::RadiusEarth;
+  static constexpr double bodyDensity = param::DensityEarth;
+};
+
+struct Venus {
+  static constexpr double orbitRadius = 108.208e+9;
+  static constexpr double sunSize = 1.0;
+  static constexpr double sunTemp = param::TempSun;
+  static constexpr double eccMin = 0.007;
+  static constexpr double eccMax = 0.02;
+  static constexpr double eccPeriod = 50000.0;
+  static constexpr double eccPhase = 1.57;
+  static constexpr double bodyPeriod = -1.00872e+7;
+  static constexpr double bodyRadius = 6.0518e+6;
+  static constexpr double bodyDensity = 5243.0;
+};
+} // namespace presets
+
+/**
+ * @brief A World whose primaries are fixed by Preset, and whose derived values
+ * are therefore compile-time constants.
+ *
+ * StaticWorld has the same getters as World, but static and (except
+ * getStars) constexpr, so a kernel templated on its world type (and taking it
+ * by const reference) can be instantiated on either. Its only star is the
+ * primary. Instantiated on a StaticWorld, every parameter
+ * is an immediate in the generated code rather than a load.
+ *
+ * @tparam Preset see presets::Earth.
+ * @tparam Math the precision policy used for the derived values.
+ */
+template <typename Preset, typename Math = math::Precise> struct StaticWorld {
+  static constexpr double getOrbitRadius() { return Preset::orbitRadius; }
+  static constexpr double getSunSize() { return Preset::sunSize; }
+  static constexpr double getSunTemp() { return Preset::sunTemp; }
+  static constexpr param::Harmonic getEccentricity() {
+    return param::Harmonic::fromMinMax(Preset::eccMin, Preset::eccMax,
+                                       Preset::eccPeriod, Preset::eccPhase);
+  }
+  static constexpr double getBodyPeriod() { return Preset::bodyPeriod; }
+  static constexpr double getBodyRadius() { return Preset::bodyRadius; }
+  static constexpr double getBodyDensity() { return Preset::bodyDensity; }
+
+  static std::vector<astro::Star> getStars() {
+    astro::Star primary{};
+    primary.size = Preset::sunSize;
+    primary.temp = Preset::sunTemp;
+    primary.distance = Preset::orbitRadius;
+    return {primary};
+  }
+
+  static constexpr double getBodySurfaceArea() { return bodySurfaceArea; }
+  static constexpr double getBodyMass() { return bodyMass; }
+  static constexpr double getBodyGravity() { return bodyGravity; }
+  static constexpr double getSunConstant() { return sunConstant; }
+  static constexpr double getTotalSunConstant() { return sunConstant; }
+  static constexpr double getPlanetaryBalanceTemperature() {
+    return planetaryBalanceTemperature;
+  }
+
+  /// @brief The equivalent run-time World, e.g. to hand to code that has not
+  /// been specialised.
+  static World makeWorld() {
+    const std::string bodySection = "body";
+    ConfigMap options{};
+    options.set_value(bodySection, "orbit_radius", Preset::orbitRadius);
+    options.set_value(bodySection, "sun_size", Preset::sunSize);
+    options.set_value(bodySection, "sun_temp", Preset::sunTemp);
+    options.set_value(bodySection, "ecc_min", Preset::eccMin);
+    options.set_value(bodySection, "ecc_max", Preset::eccMax);
+    options.set_value(bodySection, "ecc_period", Preset::eccPeriod);
+    options.set_value(bodySection, "ecc_phase", Preset::eccPhase);
+    options.set_value(bodySection, "body_period", Preset::bodyPeriod);
+    options.set_value(bodySection, "body_radius", Preset::bodyRadius);
+    options.set_value(bodySection, "body_density", Preset::bodyDensity);
+    return World{options};
+  }
+
+private:
+  // Derived, as in World::calcBodyParams()
+  static constexpr double bodySurfaceArea =
+      astro::planetSurfaceArea(Preset::bodyRadius);
+  static constexpr double bodyMass =
+      astro::planetMass(Preset::bodyDensity, Preset::bodyRadius);
+  static constexpr double bodyGravity =
+      astro::planetSurfaceGravity(Preset::bodyDensity, Preset::bodyRadius);
+  static constexpr double sunConstant = astro::sunConstant(
+      Preset::sunTemp, Preset::sunSize, Preset::orbitRadius);
+  static constexpr double planetaryBalanceTemperature =
+      astro::planetaryBalanceTemperature<Math>(sunConstant,
+                                               should_be_defines::BondAlbedo,
+                                               should_be_defines::Emissivity);
+};
+
+using EarthWorld = StaticWorld<presets::Earth>;
+} // namespace circular
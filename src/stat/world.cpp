@@ -1,5 +1,8 @@
 #include "world.hpp"
 
+#include <circular/trace.hpp>
+#include <stdexcept>
+
 #include "planets.hpp"
 
 using namespace circular;
@@ -13,6 +16,7 @@ void lookupHelper(const ConfigMap &map, param::Parameter<T> &parm,
 }
 
 circular::World::World(const ConfigMap &options) {
+  CIRCULAR_TRACE_ZONE("World::World");
   const std::string bodySection = "body";
 
   lookupHelper(options, orbitRadius, bodySection);
@@ -32,15 +36,64 @@ circular::World::World(const ConfigMap &options) {
   lookupHelper(options, bodyRadius, bodySection);
   lookupHelper(options, bodyDensity, bodySection);
 
+  const std::string starPrefix = "star_";
+  for (const auto &section : options.get_sections()) {
+    if (!section.starts_with(starPrefix)) {
+      continue;
+    }
+    auto get = [&](const std::string &key, double fallback) {
+      return std::get<double>(options.get_value(section, key, fallback));
+    };
+    astro::Star star{};
+    star.size = get("sun_size", star.size);
+    star.temp = get("sun_temp", star.temp);
+    star.distance = get("orbit_radius", star.distance);
+    star.hourOffset = get("hour_offset", star.hourOffset);
+    star.declinationOffset = get("declination_offset", star.declinationOffset);
+    companions.push_back(star);
+  }
+
+  calcBodyParams();
+}
+
+std::vector<astro::Star> circular::World::getStars() const {
+  std::vector<astro::Star> stars{};
+  stars.reserve(1 + companions.size());
+  astro::Star primary{};
+  primary.size = sunSize();
+  primary.temp = sunTemp();
+  primary.distance = orbitRadius();
+  stars.push_back(primary);
+  stars.insert(stars.end(), companions.begin(), companions.end());
+  return stars;
+}
+
+void circular::World::setStars(const std::vector<astro::Star> &stars) {
+  if (stars.empty()) {
+    throw std::invalid_argument{"setStars: there must be a primary"};
+  }
+  if (stars.front().hourOffset != 0.0 ||
+      stars.front().declinationOffset != 0.0) {
+    throw std::invalid_argument{"setStars: the primary cannot be offset"};
+  }
+  sunSize.set(stars.front().size);
+  sunTemp.set(stars.front().temp);
+  orbitRadius.set(stars.front().distance);
+  companions.assign(stars.begin() + 1, stars.end());
   calcBodyParams();
 }
 
 void circular::World::calcBodyParams() {
+  CIRCULAR_TRACE_ZONE("World::calcBodyParams");
   bodySurfaceArea = astro::planetSurfaceArea(bodyRadius());
   bodyMass = astro::planetMass(bodyDensity(), bodyRadius());
   bodyGravity = astro::planetSurfaceGravity(bodyDensity(), bodyRadius());
   sunConstant = astro::sunConstant(sunTemp(), sunSize(), orbitRadius());
+  totalSunConstant = sunConstant;
+  for (const auto &star : companions) {
+    totalSunConstant += astro::sunConstant(star);
+  }
   planetaryBalanceTemperature = astro::planetaryBalanceTemperature(
-      sunConstant, should_be_defines::BondAlbedo,
+      totalSunConstant, should_be_defines::BondAlbedo,
       should_be_defines::Emissivity);
 }
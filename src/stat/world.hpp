@@ -13,14 +13,16 @@
 
 #include <circular/config_map.hpp>
 #include <string>
+#include <vector>
 
 #include "constants.hpp"
 #include "parameter.hpp"
+#include "planets.hpp"
 
 namespace circular {
 namespace should_be_defines {
-const inline double BondAlbedo = 0.3;  // [-]
-const inline double Emissivity = 0.95; // [-]
+constexpr inline double BondAlbedo = 0.3;  // [-]
+constexpr inline double Emissivity = 0.95; // [-]
 } // namespace should_be_defines
 
 /**
@@ -39,6 +41,10 @@ const inline double Emissivity = 0.95; // [-]
 class World {
 public:
   World() = delete;
+  /// @brief Reads the body section and, for each section named star_*, in
+  /// order of name, a companion star, with keys sun_size, sun_temp,
+  /// orbit_radius (its distance from the body), hour_offset and
+  /// declination_offset.
   World(const ConfigMap &options);
 
   double getOrbitRadius() const { return orbitRadius(); }
@@ -83,14 +89,26 @@ public:
     calcBodyParams();
   }
 
+  /// @brief Every star lighting the body: first the primary, described by
+  /// the orbit radius and sun size and temperature, then any companions.
+  std::vector<astro::Star> getStars() const;
+
+  /// @brief Replace the primary and companions. Throws std::invalid_argument
+  /// if there are no stars, or the primary has an hour or declination offset.
+  void setStars(const std::vector<astro::Star> &stars);
+
   double getBodySurfaceArea() const { return bodySurfaceArea; }
 
   double getBodyMass() const { return bodyMass; }
 
   double getBodyGravity() const { return bodyGravity; }
 
+  /// @brief The primary's sun constant.
   double getSunConstant() const { return sunConstant; }
 
+  /// @brief The sum of every star's sun constant.
+  double getTotalSunConstant() const { return totalSunConstant; }
+
   double getPlanetaryBalanceTemperature() const {
     return planetaryBalanceTemperature;
   }
@@ -126,11 +144,15 @@ private:
       "body_density",
   };
 
+  // Stars other than the primary, from the star_* sections
+  std::vector<astro::Star> companions;
+
   // Derived
   double bodySurfaceArea;
   double bodyMass;
   double bodyGravity;
   double sunConstant;
+  double totalSunConstant;
   double planetaryBalanceTemperature;
 
   void calcBodyParams();
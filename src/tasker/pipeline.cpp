@@ -0,0 +1,199 @@
+#include "circular/pipeline.hpp"
+#include "circular/tasker.hpp"
+
+#include <map>
+#include <optional>
+
+using namespace circular;
+
+namespace {
+/**
+ * @brief The scheduling state of one Tasker::Run over a Pipeline.
+ *
+ * Every decision is made under the mutex, which is never held while a stage
+ * runs. A step is "in flight" from entering the first stage until it leaves
+ * the last (or is dropped after a failure).
+ */
+class PipelineRun : public std::enable_shared_from_this<PipelineRun> {
+public:
+  /// @brief onSettled is called once the run's Future is ready.
+  PipelineRun(std::shared_ptr<const std::vector<PipelineStage>> stages,
+              size_t steps, size_t maxInFlight, tf::Executor &ex,
+              std::shared_ptr<detail::Executor> executor,
+              std::function<void()> onSettled)
+      : _stages{std::move(stages)}, _steps{steps}, _maxInFlight{maxInFlight},
+        _ex{ex}, _serial(_stages->size()),
+        _result{std::make_shared<detail::SharedState<void>>()},
+        _onSettled{std::move(onSettled)} {
+    _result->executor = std::move(executor);
+  }
+
+  Future<> start() {
+    std::vector<Job> jobs{};
+    bool done = false;
+    {
+      std::lock_guard lock{_mutex};
+      _launch(jobs);
+      done = _done();
+    }
+    _schedule(jobs);
+    if (done) {
+      _settle();
+    }
+    return Future<>{_result};
+  }
+
+private:
+  struct Job {
+    size_t step;
+    size_t stage;
+    std::any value;
+  };
+
+  /// @brief Steps waiting to enter a Serial stage, which takes them in order.
+  struct SerialStage {
+    size_t next = 0;
+    bool busy = false;
+    std::map<size_t, std::any> waiting;
+  };
+
+  void _schedule(std::vector<Job> &jobs) {
+    for (auto &job : jobs) {
+      _ex.silent_async(
+          [self = shared_from_this(), job = std::move(job)]() mutable {
+            self->_execute(std::move(job));
+          });
+    }
+  }
+
+  void _execute(Job job) {
+    std::optional<std::any> out{};
+    std::exception_ptr error{};
+    try {
+      out = (*_stages)[job.stage].fn(job.step, std::move(job.value));
+    } catch (...) {
+      error = std::current_exception();
+    }
+
+    std::vector<Job> jobs{};
+    bool done = false;
+    {
+      std::lock_guard lock{_mutex};
+      _finished(job.step, job.stage, std::move(out), error, jobs);
+      done = _done();
+    }
+    _schedule(jobs);
+    if (done) {
+      _settle();
+    }
+  }
+
+  void _finished(size_t step, size_t stage, std::optional<std::any> out,
+                 std::exception_ptr error, std::vector<Job> &jobs) {
+    bool serial = (*_stages)[stage].mode == StageMode::Serial;
+    if (serial) {
+      _serial[stage].busy = false;
+      ++_serial[stage].next;
+    }
+
+    if (error && !_error) {
+      _error = error;
+      // Impl: steps parked at Serial stages would otherwise wait forever
+      for (auto &s : _serial) {
+        _inFlight -= s.waiting.size();
+        s.waiting.clear();
+      }
+    }
+
+    if (_error) {
+      --_inFlight;
+      return;
+    }
+    if (stage + 1 < _stages->size()) {
+      _arrive(step, stage + 1, std::move(*out), jobs);
+    } else {
+      --_inFlight;
+      ++_completed;
+    }
+    if (serial) {
+      _dispatch(stage, jobs);
+    }
+    _launch(jobs);
+  }
+
+  void _launch(std::vector<Job> &jobs) {
+    while (!_error && _inFlight < _maxInFlight && _launched < _steps) {
+      ++_inFlight;
+      _arrive(_launched++, 0, {}, jobs);
+    }
+  }
+
+  void _arrive(size_t step, size_t stage, std::any value,
+               std::vector<Job> &jobs) {
+    if ((*_stages)[stage].mode == StageMode::Parallel) {
+      jobs.push_back({step, stage, std::move(value)});
+      return;
+    }
+    _serial[stage].waiting.emplace(step, std::move(value));
+    _dispatch(stage, jobs);
+  }
+
+  void _dispatch(size_t stage, std::vector<Job> &jobs) {
+    auto &s = _serial[stage];
+    if (s.busy || s.waiting.empty() || s.waiting.begin()->first != s.next) {
+      return;
+    }
+    s.busy = true;
+    auto node = s.waiting.extract(s.waiting.begin());
+    jobs.push_back({node.key(), stage, std::move(node.mapped())});
+  }
+
+  bool _done() {
+    if (_inFlight != 0 || (!_error && _completed != _steps) || _settled) {
+      return false;
+    }
+    _settled = true;
+    return true;
+  }
+
+  void _settle() {
+    if (_error) {
+      _result->setException(_error);
+    } else {
+      _result->setValue({});
+    }
+    _onSettled();
+  }
+
+  std::shared_ptr<const std::vector<PipelineStage>> _stages;
+  const size_t _steps;
+  const size_t _maxInFlight;
+  tf::Executor &_ex;
+
+  std::mutex _mutex;
+  size_t _launched = 0;
+  size_t _inFlight = 0;
+  size_t _completed = 0;
+  bool _settled = false;
+  std::vector<SerialStage> _serial;
+  std::exception_ptr _error;
+  std::shared_ptr<detail::SharedState<void>> _result;
+  std::function<void()> _onSettled;
+};
+} // namespace
+
+Future<> circular::Tasker::Run(const Pipeline &pipeline, size_t steps,
+                               size_t maxInFlight, Lane lane) {
+  _throwIfShutdown("Run");
+  if (maxInFlight == 0) {
+    throw std::invalid_argument{"Run: maxInFlight must be at least 1"};
+  }
+  // Impl: the whole run is in flight in lane, so that Shutdown() waits for
+  // the jobs it schedules
+  auto &inFlight = _lane(lane).inFlight;
+  ++inFlight;
+  auto run = std::make_shared<PipelineRun>(
+      pipeline._stages, steps, maxInFlight, _executor(lane),
+      _executors[static_cast<size_t>(lane)], [&inFlight]() { --inFlight; });
+  return run->start();
+}
@@ -1,20 +1,514 @@
 #include "circular/tasker.hpp"
+#include "circular/trace.hpp"
 
 #include <taskflow/taskflow.hpp>
 
+#include <algorithm>
+#include <cerrno>
+#include <condition_variable>
+#include <system_error>
+#include <thread>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
 using namespace circular;
 
-Tasker *Tasker::_instance = nullptr;
+namespace {
+// Impl: a quarter of the machine for background work, and the rest reserved
+// for the frame, so that background jobs can never starve it.
+size_t backgroundWorkers() {
+  return std::max<size_t>(1, std::thread::hardware_concurrency() / 4);
+}
+
+size_t frameWorkers() {
+  auto hw = std::max<size_t>(1, std::thread::hardware_concurrency());
+  return std::max<size_t>(1, hw - std::min(hw, backgroundWorkers()));
+}
+
+size_t workers(size_t requested, size_t fallback) {
+  return requested == 0 ? fallback : requested;
+}
+
+/// @brief Pins each worker of an executor to one of a list of CPUs, and
+/// records the first failure, for the Tasker to report.
+class PinnedWorkers : public tf::WorkerInterface {
+public:
+  explicit PinnedWorkers(std::vector<int> cpus) : _cpus{std::move(cpus)} {}
+
+  void scheduler_prologue(tf::Worker &w) override final {
+    int error = 0;
+    int cpu = _cpus[w.id() % _cpus.size()];
+#ifdef __linux__
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    error = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+#endif
+    std::lock_guard lock{_mutex};
+    if (error != 0 && _error == 0) {
+      _error = error;
+      _failedCpu = cpu;
+    }
+    ++_started;
+    _cv.notify_all();
+  }
+
+  void scheduler_epilogue(tf::Worker &, std::exception_ptr) override final {}
+
+  /// @brief Wait for workers workers to start, and throw std::system_error
+  /// if any of them could not be pinned.
+  void check(size_t workers) {
+    std::unique_lock lock{_mutex};
+    _cv.wait(lock, [&]() { return _started >= workers; });
+    if (_error != 0) {
+      throw std::system_error{_error, std::generic_category(),
+                              "Tasker: cannot pin a worker to CPU " +
+                                  std::to_string(_failedCpu)};
+    }
+  }
+
+private:
+  std::vector<int> _cpus;
+  std::mutex _mutex;
+  std::condition_variable _cv;
+  size_t _started = 0;
+  int _error = 0;
+  int _failedCpu = 0;
+};
+
+std::shared_ptr<tf::WorkerInterface> pinning(const std::vector<int> &cpus) {
+  if (cpus.empty()) {
+    return nullptr;
+  }
+#ifdef __linux__
+  // Impl: the CPUs this process may run on, which excludes offline ones
+  cpu_set_t allowed;
+  CPU_ZERO(&allowed);
+  if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0) {
+    throw std::system_error{errno, std::generic_category(),
+                            "Tasker: cannot read the CPU affinity"};
+  }
+#endif
+  for (auto cpu : cpus) {
+#ifdef __linux__
+    bool exists = cpu >= 0 && cpu < CPU_SETSIZE && CPU_ISSET(cpu, &allowed);
+#else
+    bool exists = cpu >= 0;
+#endif
+    if (!exists) {
+      throw std::invalid_argument{"Tasker: no CPU " + std::to_string(cpu)};
+    }
+  }
+  return std::make_shared<PinnedWorkers>(cpus);
+}
+
+std::atomic<Tasker *> defaultTasker{nullptr};
+std::mutex defaultTaskerMutex{};
+
+int64_t nowNs() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+void atomicMax(std::atomic<int64_t> &a, int64_t v) {
+  auto cur = a.load(std::memory_order_relaxed);
+  while (cur < v && !a.compare_exchange_weak(cur, v)) {
+  }
+}
+
+/// @brief A Taskflow run's own Future, which holds any exception a task
+/// threw, and whether the run was cancelled. The mutex is held while run()
+/// returns it, since the run may finish first.
+struct FlowRun {
+  std::mutex mutex;
+  tf::Future<void> future;
+  bool cancelled = false;
+};
+
+/// @brief Settle state as run ended: with the exception of a task which
+/// threw, with cancelled() if the run was cancelled, or else with success.
+/// Taskflow readies run's Future only after calling the run's callback, so
+/// this is posted from the callback, rather than called in it.
+void settleFlow(detail::SharedState<void> &state, FlowRun &run,
+                std::exception_ptr (*cancelled)()) {
+  std::lock_guard lock{run.mutex};
+  try {
+    run.future.get();
+  } catch (...) {
+    state.setException(std::current_exception());
+    return;
+  }
+  if (run.cancelled) {
+    state.setException(cancelled());
+  } else {
+    state.setValue({});
+  }
+}
+
+std::function<bool()> cancelFlow(std::shared_ptr<FlowRun> run) {
+  return [run = std::move(run)]() {
+    std::lock_guard lock{run->mutex};
+    run->cancelled = run->future.cancel();
+    return run->cancelled;
+  };
+}
+} // namespace
+
+#ifdef CIRCULAR_TRACING
+namespace {
+/// @brief Records every task the executor runs as a trace zone.
+class TraceObserver : public tf::ObserverInterface {
+public:
+  void set_up(size_t) override final {}
+
+  void on_entry(tf::WorkerView, tf::TaskView) override final {
+    _begins.push_back(trace::now());
+  }
+
+  void on_exit(tf::WorkerView, tf::TaskView tv) override final {
+    auto begin = _begins.back();
+    _begins.pop_back();
+    trace::complete(tv.name().empty() ? "task" : tv.name(), begin,
+                    trace::now());
+  }
+
+private:
+  // Impl: a stack, since a worker may run a task from inside another
+  static thread_local std::vector<uint64_t> _begins;
+};
+
+thread_local std::vector<uint64_t> TraceObserver::_begins{};
+} // namespace
+#endif
+
+circular::Tasker::Tasker(TaskerOptions options)
+    : _pinning{pinning(options.frameCpus), pinning(options.backgroundCpus)},
+      _ex{workers(options.frameWorkers, frameWorkers()), _pinning[0]},
+      _background{workers(options.backgroundWorkers, backgroundWorkers()),
+                  _pinning[1]},
+      _executors{std::make_shared<detail::Executor>(this, Lane::Frame),
+                 std::make_shared<detail::Executor>(this, Lane::Background)} {
+  for (auto lane : {Lane::Frame, Lane::Background}) {
+    auto &p = _pinning[static_cast<size_t>(lane)];
+    if (nullptr != p) {
+      static_cast<PinnedWorkers &>(*p).check(_executor(lane).num_workers());
+    }
+  }
+#ifdef CIRCULAR_TRACING
+  _ex.make_observer<TraceObserver>();
+  _background.make_observer<TraceObserver>();
+#endif
+}
+
+circular::Tasker::~Tasker() {
+  Shutdown();
+  for (auto &executor : _executors) {
+    std::lock_guard lock{executor->mutex};
+    executor->tasker = nullptr;
+  }
+}
 
 Tasker &circular::Tasker::Get() {
-  if (nullptr == _instance) {
-    _instance = new Tasker;
+  // Impl: double-checked, so that the common case is one atomic load
+  auto *t = defaultTasker.load(std::memory_order_acquire);
+  if (nullptr != t) {
+    return *t;
+  }
+  std::lock_guard lock{defaultTaskerMutex};
+  t = defaultTasker.load(std::memory_order_relaxed);
+  if (nullptr == t) {
+    // Impl: leaked deliberately, since workers must not outlive statics that
+    // tasks may use during static destruction
+    t = new Tasker{};
+    defaultTasker.store(t, std::memory_order_release);
   }
-  return *_instance;
+  return *t;
+}
+
+Tasker &circular::Tasker::Init(TaskerOptions options) {
+  std::lock_guard lock{defaultTaskerMutex};
+  if (nullptr != defaultTasker.load(std::memory_order_relaxed)) {
+    throw std::logic_error{"Init: the default Tasker already exists"};
+  }
+  auto *t = new Tasker{std::move(options)};
+  defaultTasker.store(t, std::memory_order_release);
+  return *t;
+}
+
+bool circular::Tasker::HasDefault() {
+  return nullptr != defaultTasker.load(std::memory_order_acquire);
+}
+
+void circular::Tasker::Shutdown() {
+  _drain();
+  _shutdown = true;
+  // Impl: and whatever was submitted between the drain and the flag
+  _drain();
 }
 
-Future circular::Tasker::Submit(std::function<void()> task) {
+void circular::Tasker::_drain() {
+  // Impl: frame work may submit background work, and vice versa, so wait
+  // until both lanes are idle at once
+  while (true) {
+    _ex.wait_for_all();
+    _background.wait_for_all();
+    if (_lane(Lane::Frame).inFlight.load() == 0 &&
+        _lane(Lane::Background).inFlight.load() == 0 &&
+        _continuations.load() == 0) {
+      return;
+    }
+    std::this_thread::yield();
+  }
+}
+
+void circular::Tasker::_post(Lane lane, std::function<void()> task) {
+  ++_continuations;
+  _executor(lane).silent_async([this, task = std::move(task)]() {
+    struct Done {
+      std::atomic<int64_t> &count;
+      ~Done() { --count; }
+    } done{_continuations};
+    task();
+  });
+}
+
+void circular::detail::schedule(const std::shared_ptr<Executor> &executor,
+                                std::function<void()> task) {
+  if (nullptr == executor) {
+    Tasker::Get()._post(Lane::Frame, std::move(task));
+    return;
+  }
+  std::unique_lock lock{executor->mutex};
+  if (nullptr != executor->tasker) {
+    executor->tasker->_post(executor->lane, std::move(task));
+    return;
+  }
+  lock.unlock();
+  task();
+}
+
+std::exception_ptr circular::Tasker::_cancelled() {
+  return std::make_exception_ptr(
+      std::runtime_error{"Submit: task was cancelled"});
+}
+
+Future<> circular::Tasker::Submit(tf::Taskflow &&t, Lane lane) {
+  _throwIfShutdown("Submit");
+  auto state = std::make_shared<detail::SharedState<void>>();
+  state->executor = _executors[static_cast<size_t>(lane)];
+  auto &inFlight = _lane(lane).inFlight;
+  ++inFlight;
+  auto run = std::make_shared<FlowRun>();
+  {
+    std::lock_guard lock{run->mutex};
+    run->future = _executor(lane).run(
+        std::move(t), [this, state, run, lane, &inFlight]() {
+          _post(lane, [state, run]() {
+            settleFlow(*state, *run, &Tasker::_cancelled);
+          });
+          --inFlight;
+        });
+  }
+  state->cancel = cancelFlow(run);
+  return Future<>{std::move(state)};
+}
+
+tf::Future<void> circular::Tasker::_submit(std::function<void()> task,
+                                           std::function<void()> settle,
+                                           Lane lane, bool cancellable) {
+  auto &state = _lane(lane);
+  ++state.submitted;
+  ++state.inFlight;
+  auto queued = nowNs();
+  auto epoch = _backgroundEpoch.load();
+  auto ran = std::make_shared<std::atomic<bool>>(false);
+
+  auto wrapped = [this, &state, lane, task = std::move(task), queued, epoch,
+                  cancellable, ran]() {
+    ran->store(true);
+    auto start = nowNs();
+    state.queueTotal += start - queued;
+    atomicMax(state.queueMax, start - queued);
+
+    // Impl: a guard, so that the counts stay right if task throws
+    struct Finish {
+      LaneState &state;
+      int64_t start;
+      bool ran;
+      ~Finish() {
+        auto elapsed = nowNs() - start;
+        state.runTotal += elapsed;
+        atomicMax(state.runMax, elapsed);
+        ++(ran ? state.completed : state.cancelled);
+        --state.inFlight;
+      }
+    };
+    bool skip = cancellable && lane == Lane::Background &&
+                epoch != _backgroundEpoch.load();
+    Finish finish{state, start, !skip};
+    if (!skip) {
+      task();
+    }
+  };
+
   tf::Taskflow f;
-  auto t = f.emplace(task);
-  return _ex.run(std::move(f));
+  f.emplace(std::move(wrapped))
+      .name(lane == Lane::Frame ? "Tasker::Submit" : "Tasker::Submit(bg)");
+  // Impl: a cancelled Future skips wrapped, but Taskflow still calls this, so
+  // it is left to count the task
+  return _executor(lane).run(
+      std::move(f), [&state, ran, settle = std::move(settle)]() {
+        settle();
+        if (!ran->load()) {
+          ++state.cancelled;
+          --state.inFlight;
+        }
+      });
+}
+
+void circular::Tasker::BeginFrame(std::chrono::nanoseconds budget) {
+  _frameDeadline = nowNs() + std::max<int64_t>(1, budget.count());
+}
+
+bool circular::Tasker::EndFrame() {
+  auto deadline = _frameDeadline.exchange(0);
+  if (deadline == 0) {
+    throw std::logic_error{"EndFrame: no frame is open"};
+  }
+  bool met = nowNs() <= deadline;
+  if (!met) {
+    ++_framesMissed;
+  }
+  return met;
+}
+
+bool circular::Tasker::ShouldYield() const {
+  auto deadline = _frameDeadline.load();
+  return deadline != 0 &&
+         (_lane(Lane::Frame).inFlight.load() > 0 || nowNs() >= deadline);
+}
+
+LaneStats circular::Tasker::Stats(Lane lane) const {
+  const auto &state = _lane(lane);
+  LaneStats s{};
+  s.submitted = state.submitted.load();
+  s.completed = state.completed.load();
+  s.cancelled = state.cancelled.load();
+  s.queueTotal = std::chrono::nanoseconds{state.queueTotal.load()};
+  s.queueMax = std::chrono::nanoseconds{state.queueMax.load()};
+  s.runTotal = std::chrono::nanoseconds{state.runTotal.load()};
+  s.runMax = std::chrono::nanoseconds{state.runMax.load()};
+  return s;
+}
+
+void circular::Tasker::ResetStats(Lane lane) {
+  auto &state = _lane(lane);
+  state.submitted = 0;
+  state.completed = 0;
+  state.cancelled = 0;
+  state.queueTotal = 0;
+  state.queueMax = 0;
+  state.runTotal = 0;
+  state.runMax = 0;
+}
+
+RunStats circular::TaskGraph::Stats() const {
+  std::lock_guard lock{_statsMutex};
+  return _stats;
+}
+
+void circular::TaskGraph::ResetStats() {
+  std::lock_guard lock{_statsMutex};
+  _stats = RunStats{};
+}
+
+void circular::TaskGraph::_record(std::chrono::nanoseconds elapsed) {
+  std::lock_guard lock{_statsMutex};
+  _stats.min = (_stats.runs == 0) ? elapsed : std::min(_stats.min, elapsed);
+  _stats.max = (_stats.runs == 0) ? elapsed : std::max(_stats.max, elapsed);
+  _stats.last = elapsed;
+  _stats.total += elapsed;
+  ++_stats.runs;
+}
+
+TaskGraph &circular::Tasker::DefineGraph(const std::string &name) {
+  std::lock_guard lock{_graphsMutex};
+  auto [it, inserted] = _graphs.try_emplace(name, nullptr);
+  if (!inserted) {
+    throw std::invalid_argument{"DefineGraph: graph " + name +
+                                " already exists"};
+  }
+  it->second = std::make_unique<TaskGraph>(name);
+  return *it->second;
+}
+
+TaskGraph &circular::Tasker::Graph(const std::string &name) {
+  std::lock_guard lock{_graphsMutex};
+  auto it = _graphs.find(name);
+  if (it == _graphs.end()) {
+    throw std::out_of_range{"Graph: no graph named " + name};
+  }
+  return *it->second;
+}
+
+bool circular::Tasker::HasGraph(const std::string &name) const {
+  std::lock_guard lock{_graphsMutex};
+  return _graphs.contains(name);
+}
+
+void circular::Tasker::EraseGraph(const std::string &name) {
+  std::lock_guard lock{_graphsMutex};
+  auto it = _graphs.find(name);
+  if (it == _graphs.end()) {
+    throw std::out_of_range{"EraseGraph: no graph named " + name};
+  }
+  it->second->_throwIfRunning("EraseGraph");
+  _graphs.erase(it);
+}
+
+Future<> circular::Tasker::RunN(const std::string &name, size_t n) {
+  return RunUntil(name, [n, i = size_t{0}]() mutable { return i++ >= n; });
+}
+
+Future<> circular::Tasker::RunUntil(const std::string &name,
+                                  std::function<bool()> pred) {
+  _throwIfShutdown("RunUntil");
+  auto &g = Graph(name);
+  ++g._pending;
+  ++_lane(Lane::Frame).inFlight;
+
+  // Impl: Taskflow calls the predicate before the first run and after every
+  // run, so the time between consecutive calls is the time of one run.
+  using Clock = std::chrono::steady_clock;
+  auto timed = [&g, pred = std::move(pred), started = false,
+                begin = Clock::time_point{}]() mutable {
+    auto now = Clock::now();
+    if (started) {
+      g._record(now - begin);
+    }
+    started = true;
+    auto done = pred();
+    begin = Clock::now();
+    return done;
+  };
+  auto state = std::make_shared<detail::SharedState<void>>();
+  state->executor = _executors[static_cast<size_t>(Lane::Frame)];
+  auto run = std::make_shared<FlowRun>();
+  {
+    std::lock_guard lock{run->mutex};
+    run->future = _ex.run_until(
+        g._flow, std::move(timed), [this, &g, state, run]() {
+          _post(Lane::Frame, [state, run]() {
+            settleFlow(*state, *run, &Tasker::_cancelled);
+          });
+          --g._pending;
+          --_lane(Lane::Frame).inFlight;
+        });
+  }
+  state->cancel = cancelFlow(run);
+  return Future<>{std::move(state)};
 }
@@ -0,0 +1,255 @@
+#include "circular/trace.hpp"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+
+using namespace circular;
+
+namespace {
+std::chrono::steady_clock::time_point epoch() {
+  static const auto e = std::chrono::steady_clock::now();
+  return e;
+}
+
+#ifdef CIRCULAR_TRACING
+struct Event {
+  uint64_t ts;
+  uint64_t dur;
+  double value;
+  char phase; // as in the Chrome trace format: X, C or i
+  char name[55];
+};
+
+/**
+ * @brief A single-producer, single-consumer ring of Events.
+ *
+ * The owning thread is the only producer; writeChromeTrace() is the only
+ * consumer, and is serialised by the registry mutex.
+ */
+class ThreadBuffer {
+public:
+  static constexpr uint64_t Capacity = 1 << 14;
+
+  explicit ThreadBuffer(uint32_t tid)
+      : _events{std::make_unique<std::array<Event, Capacity>>()}, _tid{tid} {}
+
+  Event *acquire() noexcept {
+    auto head = _head.load(std::memory_order_relaxed);
+    if (head - _tail.load(std::memory_order_acquire) == Capacity) {
+      _dropped.fetch_add(1, std::memory_order_relaxed);
+      return nullptr;
+    }
+    return &(*_events)[head & (Capacity - 1)];
+  }
+
+  void commit() noexcept {
+    _head.store(_head.load(std::memory_order_relaxed) + 1,
+                std::memory_order_release);
+  }
+
+  template <typename F> void drain(F &&f) {
+    auto tail = _tail.load(std::memory_order_relaxed);
+    auto head = _head.load(std::memory_order_acquire);
+    for (; tail != head; ++tail) {
+      f((*_events)[tail & (Capacity - 1)]);
+    }
+    _tail.store(tail, std::memory_order_release);
+  }
+
+  uint32_t tid() const { return _tid; }
+  uint64_t dropped() const { return _dropped.load(std::memory_order_relaxed); }
+
+private:
+  std::unique_ptr<std::array<Event, Capacity>> _events;
+  std::atomic<uint64_t> _head{0};
+  std::atomic<uint64_t> _tail{0};
+  std::atomic<uint64_t> _dropped{0};
+  uint32_t _tid;
+};
+
+/// @brief Every thread's buffer, kept alive past thread exit until drained.
+struct Registry {
+  std::mutex mutex;
+  std::vector<std::shared_ptr<ThreadBuffer>> buffers;
+  uint32_t nextTid = 1;
+  uint64_t prunedDropped = 0; // by the threads whose buffers are gone
+};
+
+Registry &registry() {
+  static Registry r{};
+  return r;
+}
+
+ThreadBuffer &threadBuffer() {
+  thread_local std::shared_ptr<ThreadBuffer> buffer = []() {
+    auto &r = registry();
+    std::lock_guard lock{r.mutex};
+    auto b = std::make_shared<ThreadBuffer>(r.nextTid++);
+    r.buffers.push_back(b);
+    return b;
+  }();
+  return *buffer;
+}
+
+void record(char phase, std::string_view name, uint64_t ts, uint64_t dur,
+            double value) noexcept {
+  auto &buffer = threadBuffer();
+  auto *e = buffer.acquire();
+  if (nullptr == e) {
+    return;
+  }
+  e->ts = ts;
+  e->dur = dur;
+  e->value = value;
+  e->phase = phase;
+  auto len = std::min(name.size(), sizeof(e->name) - 1);
+  name.copy(e->name, len);
+  e->name[len] = '\0';
+  buffer.commit();
+}
+
+void writeEscaped(std::ostream &out, const char *s) {
+  for (; *s != '\0'; ++s) {
+    auto c = static_cast<unsigned char>(*s);
+    if (c == '"' || c == '\\') {
+      out << '\\' << *s;
+    } else if (c < 0x20) {
+      char buf[8];
+      std::snprintf(buf, sizeof(buf), "\\u%04x", c);
+      out << buf;
+    } else {
+      out << *s;
+    }
+  }
+}
+#endif
+} // namespace
+
+bool circular::trace::enabled() noexcept {
+#ifdef CIRCULAR_TRACING
+  return true;
+#else
+  return false;
+#endif
+}
+
+uint64_t circular::trace::now() noexcept {
+  return static_cast<uint64_t>(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(
+          std::chrono::steady_clock::now() - epoch())
+          .count());
+}
+
+void circular::trace::complete([[maybe_unused]] std::string_view name,
+                               [[maybe_unused]] uint64_t begin,
+                               [[maybe_unused]] uint64_t end) noexcept {
+#ifdef CIRCULAR_TRACING
+  record('X', name, begin, end - begin, 0.0);
+#endif
+}
+
+void circular::trace::counter([[maybe_unused]] std::string_view name,
+                              [[maybe_unused]] double value) noexcept {
+#ifdef CIRCULAR_TRACING
+  record('C', name, now(), 0, value);
+#endif
+}
+
+void circular::trace::frame([[maybe_unused]] std::string_view name) noexcept {
+#ifdef CIRCULAR_TRACING
+  record('i', name, now(), 0, 0.0);
+#endif
+}
+
+void circular::trace::writeChromeTrace(const std::string &file_path) {
+  std::ofstream out{file_path, std::ios::trunc};
+  if (!out) {
+    throw std::runtime_error{"writeChromeTrace: could not open " + file_path};
+  }
+  out << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+
+#ifdef CIRCULAR_TRACING
+  auto &r = registry();
+  std::lock_guard lock{r.mutex};
+  bool first = true;
+  char num[64];
+  for (auto &buffer : r.buffers) {
+    // Impl: once its thread has exited, the registry holds the only
+    // reference; the fence pairs with the release of the thread's, so that
+    // its last events are seen by this drain, after which it can be freed
+    const bool orphaned = buffer.use_count() == 1;
+    if (orphaned) {
+      std::atomic_thread_fence(std::memory_order_acquire);
+    }
+    buffer->drain([&](const Event &e) {
+      out << (first ? "\n" : ",\n") << "{\"name\":\"";
+      writeEscaped(out, e.name);
+      out << "\",\"ph\":\"" << e.phase << "\",\"pid\":1,\"tid\":"
+          << buffer->tid();
+      // Chrome traces count in (fractional) microseconds
+      std::snprintf(num, sizeof(num), "%.3f", static_cast<double>(e.ts) * 1e-3);
+      out << ",\"ts\":" << num;
+      if ('X' == e.phase) {
+        std::snprintf(num, sizeof(num), "%.3f",
+                      static_cast<double>(e.dur) * 1e-3);
+        out << ",\"dur\":" << num;
+      } else if ('C' == e.phase) {
+        if (std::isfinite(e.value)) {
+          std::snprintf(num, sizeof(num), "%.17g", e.value);
+        } else {
+          std::snprintf(num, sizeof(num), "null");
+        }
+        out << ",\"args\":{\"value\":" << num << "}";
+      } else {
+        out << ",\"s\":\"g\"";
+      }
+      out << "}";
+      first = false;
+    });
+    if (orphaned) {
+      r.prunedDropped += buffer->dropped();
+      buffer.reset();
+    }
+  }
+  std::erase(r.buffers, nullptr);
+#endif
+
+  out << "\n]}\n";
+  if (!out) {
+    throw std::runtime_error{"writeChromeTrace: I/O error writing " +
+                             file_path};
+  }
+}
+
+uint64_t circular::trace::droppedEvents() {
+#ifdef CIRCULAR_TRACING
+  auto &r = registry();
+  std::lock_guard lock{r.mutex};
+  uint64_t dropped = r.prunedDropped;
+  for (const auto &buffer : r.buffers) {
+    dropped += buffer->dropped();
+  }
+  return dropped;
+#else
+  return 0;
+#endif
+}
+
+size_t circular::trace::threadBuffers() {
+#ifdef CIRCULAR_TRACING
+  auto &r = registry();
+  std::lock_guard lock{r.mutex};
+  return r.buffers.size();
+#else
+  return 0;
+#endif
+}
@@ -0,0 +1,129 @@
+#include <catch2/catch_all.hpp>
+
+#include <atomic>
+#include <fstream>
+#include <vector>
+
+#include "../src/io/checkpoint.hpp"
+
+using namespace circular;
+
+TEST_CASE("Checkpoint round-trips World primaries and sections",
+          "[checkpoint]") {
+  auto venus_def = ConfigMap::parse_from_file("tests/fixtures/venus.toml");
+  auto w = World(venus_def);
+
+  std::vector<double> temps{280.0, 281.5, 290.25, 301.0};
+  std::vector<int32_t> mask{1, 0, 1};
+
+  CheckpointWriter writer{w, 42, 3600.0};
+  writer.addSection<double>("temperature", temps);
+  writer.addSection<int32_t>("land_mask", mask);
+  writer.write("checkpoint_test.ckpt");
+
+  auto c = Checkpoint::open("checkpoint_test.ckpt");
+  REQUIRE(c.version() == CheckpointVersion);
+  REQUIRE(c.step() == 42);
+  REQUIRE(c.time() == 3600.0);
+
+  auto restored = c.restoreWorld();
+  REQUIRE(restored.getOrbitRadius() == w.getOrbitRadius());
+  REQUIRE(restored.getBodyPeriod() == w.getBodyPeriod());
+  REQUIRE(restored.getEccentricity()._amplitude ==
+          w.getEccentricity()._amplitude);
+  REQUIRE(restored.getBodyGravity() == w.getBodyGravity());
+
+  auto t = c.section<double>("temperature");
+  REQUIRE(std::vector<double>(t.begin(), t.end()) == temps);
+  REQUIRE(reinterpret_cast<uintptr_t>(t.data()) % CheckpointAlignment == 0);
+
+  auto m = c.section<int32_t>("land_mask");
+  REQUIRE(std::vector<int32_t>(m.begin(), m.end()) == mask);
+
+  REQUIRE(c.hasSection("land_mask"));
+  REQUIRE_FALSE(c.hasSection("salinity"));
+  REQUIRE_THROWS_AS(c.section<double>("land_mask"), std::invalid_argument);
+  REQUIRE_THROWS_AS(c.section<double>("salinity"), std::out_of_range);
+}
+
+TEST_CASE("Checkpoint writes asynchronously via Tasker", "[checkpoint]") {
+  auto w = World(ConfigMap{});
+  std::vector<double> field(1 << 16, 1.5);
+
+  CheckpointWriter writer{w, 7};
+  writer.addSection<double>("field", field);
+  auto fu = std::move(writer).writeAsync("checkpoint_async.ckpt");
+  REQUIRE_NOTHROW(fu.get());
+
+  auto c = Checkpoint::open("checkpoint_async.ckpt");
+  REQUIRE(c.step() == 7);
+  REQUIRE(c.section<double>("field").size() == field.size());
+  REQUIRE(c.section<double>("field")[field.size() - 1] == 1.5);
+}
+
+TEST_CASE("Checkpoint async write failures reach the Future", "[checkpoint]") {
+  CheckpointWriter writer{World(ConfigMap{}), 1};
+  auto fu = std::move(writer).writeAsync("no_such_dir/checkpoint.ckpt");
+  REQUIRE_THROWS_AS(fu.get(), std::runtime_error);
+}
+
+TEST_CASE("Checkpoint refuses files that are not checkpoints",
+          "[checkpoint]") {
+  REQUIRE_THROWS(Checkpoint::open("tests/fixtures/venus.toml"));
+  REQUIRE_THROWS(Checkpoint::open("tests/fixtures/does_not_exist.ckpt"));
+}
+
+TEST_CASE("Checkpoint refuses corrupt section entries", "[checkpoint]") {
+  std::vector<double> field(4, 1.0);
+  CheckpointWriter writer{World(ConfigMap{})};
+  writer.addSection<double>("field", field);
+  writer.write("checkpoint_corrupt.ckpt");
+
+  CheckpointHeader header{};
+  {
+    std::ifstream in{"checkpoint_corrupt.ckpt", std::ios::binary};
+    in.read(reinterpret_cast<char *>(&header), sizeof(header));
+  }
+  // rewrite the only entry, then check that open() refuses it
+  auto corrupt = [&](auto &&edit) {
+    std::fstream io{"checkpoint_corrupt.ckpt",
+                    std::ios::binary | std::ios::in | std::ios::out};
+    CheckpointSectionEntry entry{};
+    io.seekg(static_cast<std::streamoff>(header.sectionTableOffset));
+    io.read(reinterpret_cast<char *>(&entry), sizeof(entry));
+    const auto good = entry;
+    edit(entry);
+    io.seekp(static_cast<std::streamoff>(header.sectionTableOffset));
+    io.write(reinterpret_cast<const char *>(&entry), sizeof(entry));
+    io.flush();
+    REQUIRE_THROWS_AS(Checkpoint::open("checkpoint_corrupt.ckpt"),
+                      std::runtime_error);
+    io.seekp(static_cast<std::streamoff>(header.sectionTableOffset));
+    io.write(reinterpret_cast<const char *>(&good), sizeof(good));
+  };
+
+  REQUIRE_NOTHROW(Checkpoint::open("checkpoint_corrupt.ckpt"));
+  corrupt([](CheckpointSectionEntry &e) { e.elementSize = 0; });
+  corrupt([](CheckpointSectionEntry &e) {
+    e.elementSize = 1;
+    e.count *= 8;
+  });
+  corrupt([](CheckpointSectionEntry &e) { e.element = 99; });
+  corrupt([](CheckpointSectionEntry &e) { e.count += 1 << 20; });
+  REQUIRE(Checkpoint::open("checkpoint_corrupt.ckpt")
+              .section<double>("field")
+              .size() == field.size());
+}
+
+TEST_CASE("Checkpoint round-trips companion stars", "[checkpoint]") {
+  auto w = World(ConfigMap::parse_from_file("tests/fixtures/binary.toml"));
+  CheckpointWriter{w}.write("checkpoint_stars.ckpt");
+
+  auto c = Checkpoint::open("checkpoint_stars.ckpt");
+  REQUIRE(c.hasSection(CheckpointStarsSection));
+  REQUIRE(c.restoreWorld().getStars() == w.getStars());
+
+  CheckpointWriter{World(ConfigMap{})}.write("checkpoint_stars.ckpt");
+  REQUIRE_FALSE(Checkpoint::open("checkpoint_stars.ckpt")
+                    .hasSection(CheckpointStarsSection));
+}
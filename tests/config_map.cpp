@@ -1,8 +1,32 @@
 #include <catch2/catch_all.hpp>
 #include <circular/config_map.hpp>
 
+#include <cmath>
+#include <fstream>
+#include <sstream>
 #include <vector>
 
+namespace {
+/// @brief Whether a and b have the same sections, keys and values.
+bool same_contents(const circular::ConfigMap &a,
+                   const circular::ConfigMap &b) {
+  if (a.get_sections() != b.get_sections()) {
+    return false;
+  }
+  for (const auto &section : a.get_sections()) {
+    if (a.get_section_keys(section) != b.get_section_keys(section)) {
+      return false;
+    }
+    for (const auto &key : a.get_section_keys(section)) {
+      if (a.get_value(section, key) != b.get_value(section, key)) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+} // namespace
+
 TEST_CASE("ConfigMap stores and gets ConfigVariants of various types",
           "[config_map]") {
   circular::VariantList l{true, 2.0, 42, "bar"};
@@ -100,4 +124,292 @@ TEST_CASE("ConfigMap parses a file with valid TOML subset", "[config_map]") {
 TEST_CASE("ConfigMap throws on invalid files", "[config_map]") {
   REQUIRE_THROWS(
       circular::ConfigMap::parse_from_file("tests/fixtures/bad.toml"));
-}
\ No newline at end of file
+}
+
+TEST_CASE("FlatMap keeps keys sorted and finds them", "[config_map]") {
+  circular::FlatMap<std::string, int> m{{"b", 2}, {"a", 1}, {"b", 3}};
+
+  // the first of equal keys wins, as for std::map
+  REQUIRE(m.size() == 2);
+  REQUIRE(m.at("b") == 2);
+
+  m["c"] = 4;
+  m.insert_or_assign("a", 5);
+  REQUIRE(m.try_emplace("c", 6).second == false);
+
+  std::vector<std::string> keys{};
+  for (const auto &[k, v] : m) {
+    keys.push_back(k);
+  }
+  REQUIRE(keys == std::vector<std::string>{"a", "b", "c"});
+  REQUIRE(m.at(std::string_view{"a"}) == 5);
+  REQUIRE(m.contains("c"));
+  REQUIRE_FALSE(m.contains("d"));
+  REQUIRE_THROWS_AS(m.at("d"), std::out_of_range);
+
+  REQUIRE(m.erase("b") == 1);
+  REQUIRE(m.erase("b") == 0);
+  m.erase(m.begin());
+  REQUIRE(m.size() == 1);
+  REQUIRE(m.begin()->first == "c");
+}
+
+TEST_CASE("ConfigValue is compact and round-trips ConfigVariants",
+          "[config_map]") {
+  STATIC_REQUIRE(sizeof(circular::ConfigValue) == 16);
+
+  std::string long_string(100, 'x');
+  circular::VariantList l{true, 2.0, 42, "short", long_string};
+  circular::VariantDict d{{"z", long_string}, {"a", 1}, {"m", "mid"}};
+  std::vector<circular::ConfigVariant> values{
+      std::monostate{}, true, -7,  3.5, "", "fourteen chars",
+      long_string,      l,    d,   circular::VariantList{},
+      circular::VariantDict{}};
+
+  for (const auto &v : values) {
+    circular::ConfigValue cv{v};
+    REQUIRE(cv.to_variant() == v);
+  }
+
+  REQUIRE(circular::ConfigValue{}.type() ==
+          circular::ConfigValue::Type::Null);
+  REQUIRE(circular::ConfigValue{long_string}.type() ==
+          circular::ConfigValue::Type::String);
+  REQUIRE(circular::ConfigValue{l}.type() ==
+          circular::ConfigValue::Type::List);
+  REQUIRE(circular::ConfigValue{d}.type() ==
+          circular::ConfigValue::Type::Dict);
+}
+
+TEST_CASE("ConfigValue copies are independent", "[config_map]") {
+  std::string long_string(64, 'y');
+  circular::VariantList l{long_string, 1};
+
+  circular::ConfigValue a{l};
+  circular::ConfigValue b{a};
+  circular::ConfigValue c{};
+  c = a;
+  a = circular::ConfigValue{circular::ConfigVariant{3}};
+
+  REQUIRE(std::get<int>(a.to_variant()) == 3);
+  REQUIRE(b.to_variant() == circular::ConfigVariant{l});
+  REQUIRE(c.to_variant() == circular::ConfigVariant{l});
+
+  circular::ConfigValue moved{std::move(b)};
+  REQUIRE(moved.to_variant() == circular::ConfigVariant{l});
+  c = c;
+  REQUIRE(c.to_variant() == circular::ConfigVariant{l});
+}
+
+TEST_CASE("ConfigMap lists section keys in sorted order", "[config_map]") {
+  circular::ConfigMap m{};
+  m.set_value("s", "zeta", 1);
+  m.set_value("s", "alpha", 2);
+  m.set_value("s", "mu", 3);
+  m.set_value("b", "x", 0);
+  m.set_value("a", "x", 0);
+
+  REQUIRE(m.get_section_keys("s") ==
+          std::vector<std::string>{"alpha", "mu", "zeta"});
+  REQUIRE(m.get_sections() == std::vector<std::string>{"a", "b", "s"});
+}
+
+TEST_CASE("ConfigMap writes TOML which parses back unchanged",
+          "[config_map]") {
+  circular::ConfigMap m{};
+  m.set_value("", "a_bool", false);
+  m.set_value("", "escapes", "quote \" backslash \\ tab\t nl\n \x01 é");
+  m.set_value("", "root_list", circular::VariantList{1, 2.5, "x", true});
+  m.set_value("", "root_dict",
+              circular::VariantDict{{"b", 1}, {"a key", "v"}});
+  m.set_value("", "", 0);
+  m.set_value("physics", "whole", 1.0);
+  m.set_value("physics", "tiny", 1e-300);
+  m.set_value("physics", "huge", -1e300);
+  m.set_value("physics", "third", 1.0 / 3.0);
+  m.set_value("physics", "infinite", -INFINITY);
+  m.set_value("physics", "int", -2147483647);
+  m.set_value("needs quotes.too", "empty_list", circular::VariantList{});
+  m.set_value("needs quotes.too", "empty_dict", circular::VariantDict{});
+  m.set_value("empty", "gone", 1);
+  m.erase_section_key("empty", "gone");
+
+  m.write_to_file("config_map_test.toml");
+  auto parsed = circular::ConfigMap::parse_from_file("config_map_test.toml");
+  REQUIRE(same_contents(m, parsed));
+  REQUIRE(parsed.has_section("empty"));
+
+  // and so does a file written by hand
+  auto good = circular::ConfigMap::parse_from_file("tests/fixtures/good.toml");
+  good.write_to_file("config_map_test.toml");
+  REQUIRE(same_contents(
+      good, circular::ConfigMap::parse_from_file("config_map_test.toml")));
+}
+
+TEST_CASE("ConfigMap writes the same TOML to strings and streams, whatever "
+          "the insertion order",
+          "[config_map]") {
+  circular::ConfigMap a{};
+  a.set_value("s", "x", 1);
+  a.set_value("s", "y", "two");
+  a.set_value("", "top", 3.0);
+  a.set_value("t", "z", circular::VariantDict{{"q", 1}, {"p", 2}});
+
+  circular::ConfigMap b{};
+  b.set_value("t", "z", circular::VariantDict{{"p", 2}, {"q", 1}});
+  b.set_value("", "top", 3.0);
+  b.set_value("s", "y", "two");
+  b.set_value("s", "x", 1);
+
+  auto text = a.write_to_string();
+  REQUIRE(text == "top = 3.0\n"
+                  "\n[s]\n"
+                  "x = 1\n"
+                  "y = \"two\"\n"
+                  "\n[t]\n"
+                  "z = { p = 2, q = 1 }\n");
+  REQUIRE(b.write_to_string() == text);
+
+  std::ostringstream out{};
+  a.write_to_stream(out);
+  REQUIRE(out.str() == text);
+}
+
+TEST_CASE("ConfigMap writes large maps through its buffer", "[config_map]") {
+  circular::ConfigMap m{};
+  for (int s = 0; s < 20; ++s) {
+    for (int k = 0; k < 500; ++k) {
+      m.set_value("section" + std::to_string(s), "key" + std::to_string(k),
+                  circular::VariantList{k, "value " + std::to_string(k)});
+    }
+  }
+
+  std::ostringstream out{};
+  m.write_to_stream(out);
+  REQUIRE(out.str().size() > (size_t{1} << 16));
+  REQUIRE(out.str() == m.write_to_string());
+
+  m.write_to_file("config_map_test.toml");
+  REQUIRE(same_contents(
+      m, circular::ConfigMap::parse_from_file("config_map_test.toml")));
+}
+
+TEST_CASE("ConfigMap refuses to write what TOML cannot express",
+          "[config_map]") {
+  circular::ConfigMap with_null{};
+  with_null.set_value("s", "l", circular::VariantList{1, std::monostate{}});
+  REQUIRE_THROWS_AS(with_null.write_to_string(), std::invalid_argument);
+
+  circular::ConfigMap clash{};
+  clash.set_value("", "s", 1);
+  clash.set_value("s", "k", 2);
+  REQUIRE_THROWS_AS(clash.write_to_string(), std::invalid_argument);
+
+  REQUIRE_THROWS_AS(clash.write_to_file("no/such/dir/config.toml"),
+                    std::runtime_error);
+}
+
+TEST_CASE("ConfigMap loads lazily what it would parse eagerly",
+          "[config_map]") {
+  auto eager = circular::ConfigMap::parse_from_file("tests/fixtures/lazy.toml");
+  auto lazy =
+      circular::ConfigMap::parse_from_file_lazily("tests/fixtures/lazy.toml");
+
+  REQUIRE(lazy.get_sections() ==
+          std::vector<std::string>{"", "atmosphere", "body", "empty",
+                                   "physics", "quoted section"});
+  REQUIRE(lazy.has_section("atmosphere"));
+  REQUIRE(same_contents(eager, lazy));
+
+  REQUIRE(std::get<std::string>(lazy.get_value("body", "notes")) ==
+          "[fake]\nnot a header\n");
+  REQUIRE(std::get<double>(lazy.get_value("physics", "gravity")) == 9.8);
+  REQUIRE(lazy.get_value("body", "orbit") ==
+          circular::ConfigVariant{circular::VariantDict{{"period", 365.25}}});
+}
+
+TEST_CASE("ConfigMap keeps sections parsed by const methods", "[config_map]") {
+  {
+    std::ofstream out{"config_map_const_test.toml"};
+    out << "x = 0\n\n[a]\nx = 1\n\n[b]\ny = 2\n\n[c]\nz = 3\n";
+  }
+  const auto eager =
+      circular::ConfigMap::parse_from_file("config_map_const_test.toml");
+  const auto lazy =
+      circular::ConfigMap::parse_from_file_lazily("config_map_const_test.toml");
+
+  // some sections parsed through const methods, the rest still pending
+  REQUIRE(std::get<int>(lazy.get_value("c", "z")) == 3);
+  REQUIRE(lazy.has_section_key("a", "x"));
+  REQUIRE(lazy.get_sections() == eager.get_sections());
+  REQUIRE(lazy.write_to_string() == eager.write_to_string());
+
+  // and a copy's writes see them
+  auto copy = lazy;
+  copy.set_value("c", "z", 4);
+  copy.erase_section_key("a", "x");
+  REQUIRE(std::get<int>(copy.get_value("c", "z")) == 4);
+  REQUIRE_FALSE(copy.has_section_key("a", "x"));
+  REQUIRE(copy.get_sections() == eager.get_sections());
+  REQUIRE(std::get<int>(lazy.get_value("c", "z")) == 3);
+  REQUIRE(same_contents(eager, lazy));
+}
+
+TEST_CASE("ConfigMap loads lazily a file with CRLF line endings",
+          "[config_map]") {
+  auto eager = circular::ConfigMap::parse_from_file("tests/fixtures/crlf.toml");
+  auto lazy =
+      circular::ConfigMap::parse_from_file_lazily("tests/fixtures/crlf.toml");
+
+  REQUIRE(lazy.get_sections() ==
+          std::vector<std::string>{"", "atmosphere", "body"});
+  REQUIRE(same_contents(eager, lazy));
+  REQUIRE(std::get<int>(lazy.get_value("atmosphere", "pressure")) == 101325);
+}
+
+TEST_CASE("ConfigMap loads lazily only the allowed sections", "[config_map]") {
+  auto m = circular::ConfigMap::parse_from_file_lazily(
+      "tests/fixtures/lazy.toml", {"atmosphere", "empty"});
+
+  REQUIRE(m.get_sections() == std::vector<std::string>{"atmosphere", "empty"});
+  REQUIRE_FALSE(m.has_section(""));
+  REQUIRE_FALSE(m.has_section("body"));
+  REQUIRE(std::get<int>(m.get_value("atmosphere", "pressure")) == 101325);
+  REQUIRE(m.get_section_keys("empty").empty());
+
+  // a copy taken before parsing parses on its own
+  auto copy = m;
+  m.set_value("atmosphere", "pressure", 0);
+  REQUIRE(std::get<int>(copy.get_value("atmosphere", "pressure")) == 101325);
+
+  m.erase_section("empty");
+  REQUIRE_THROWS_AS(m.erase_section("empty"), std::out_of_range);
+}
+
+TEST_CASE("ConfigMap reports parse errors in a lazy section when it is used",
+          "[config_map]") {
+  {
+    std::ofstream out{"config_map_lazy_test.toml"};
+    out << "[good]\nx = 1\n\n[bad]\ny = = 2\n";
+  }
+  auto m = circular::ConfigMap::parse_from_file_lazily(
+      "config_map_lazy_test.toml");
+  REQUIRE(std::get<int>(m.get_value("good", "x")) == 1);
+  REQUIRE(m.has_section("bad"));
+  REQUIRE_THROWS(m.get_value("bad", "y"));
+  // the section stays unparsed, so the error is reported every time, rather
+  // than the section vanishing and its defaults being used
+  REQUIRE_THROWS(m.get_value("bad", "y", 3));
+  REQUIRE(m.has_section("bad"));
+  REQUIRE_THROWS(
+      circular::ConfigMap::parse_from_file_lazily("config_map_lazy_test.toml")
+          .materialise_all());
+
+  auto only_good = circular::ConfigMap::parse_from_file_lazily(
+      "config_map_lazy_test.toml", {"good"});
+  REQUIRE_NOTHROW(only_good.write_to_string());
+
+  REQUIRE_THROWS_AS(
+      circular::ConfigMap::parse_from_file_lazily("no/such/file.toml"),
+      std::runtime_error);
+}
@@ -0,0 +1,105 @@
+#include <catch2/catch_all.hpp>
+
+#include <cmath>
+#include <vector>
+
+#include "../src/stat/fast_math.hpp"
+#include "../src/stat/planets.hpp"
+
+using namespace circular;
+
+namespace {
+double ulpError(double approx, long double exact) {
+  auto e = static_cast<double>(exact);
+  auto ulp = std::nextafter(std::abs(e), INFINITY) - std::abs(e);
+  return static_cast<double>(std::abs(approx - exact) / ulp);
+}
+} // namespace
+
+TEST_CASE("Fast trig kernels stay within their documented ULP bounds",
+          "[fast_math]") {
+  double sin_max = 0, cos_max = 0;
+  for (int i = -100000; i <= 100000; ++i) {
+    double x = i * 1e-4;
+    sin_max = std::max(sin_max, ulpError(math::Fast::sin(x), sinl(x)));
+    cos_max = std::max(cos_max, ulpError(math::Fast::cos(x), cosl(x)));
+  }
+  REQUIRE(sin_max <= 1.75);
+  REQUIRE(cos_max <= 1.75);
+
+  // Impl: a stride incommensurate with pi samples every phase out to 1e6
+  double far_sin_max = 0, far_cos_max = 0, tan_max = 0;
+  for (int i = -100000; i <= 100000; ++i) {
+    double x = i * 9.99991;
+    far_sin_max = std::max(far_sin_max, ulpError(math::Fast::sin(x), sinl(x)));
+    far_cos_max = std::max(far_cos_max, ulpError(math::Fast::cos(x), cosl(x)));
+    if (std::abs(std::cos(x)) > 1e-3) {
+      tan_max = std::max(tan_max, ulpError(math::Fast::tan(x), tanl(x)));
+    }
+  }
+  REQUIRE(far_sin_max <= 3.0);
+  REQUIRE(far_cos_max <= 3.0);
+  REQUIRE(tan_max <= 5.0);
+}
+
+TEST_CASE("Fast inverse trig kernels stay within their documented ULP bounds",
+          "[fast_math]") {
+  double asin_max = 0, acos_max = 0;
+  for (int i = -100000; i <= 100000; ++i) {
+    double x = i * 1e-5;
+    if (i != 0) {
+      asin_max = std::max(asin_max, ulpError(math::Fast::asin(x), asinl(x)));
+    }
+    acos_max = std::max(acos_max, ulpError(math::Fast::acos(x), acosl(x)));
+  }
+  REQUIRE(asin_max <= 3.0);
+  REQUIRE(acos_max <= 1.5);
+  REQUIRE(math::Fast::acos(1.0) == 0.0);
+  REQUIRE(math::Fast::acos(-1.0) == M_PI);
+}
+
+TEST_CASE("Astro functions agree between precision policies", "[fast_math]") {
+  REQUIRE(astro::sunMass<math::Fast>(1.3) ==
+          Catch::Approx(astro::sunMass(1.3)).epsilon(1e-14));
+  REQUIRE(astro::sunMass(1.0) == Catch::Approx(param::MassSun));
+
+  std::vector<double> lats{}, fast(181), precise(181);
+  for (int i = -90; i <= 90; ++i) {
+    lats.push_back(i * M_PI / 180.0);
+  }
+  const double decl = 0.3;
+  astro::calcDailySunExposure<math::Fast>(lats, decl, fast);
+  astro::calcDailySunExposure(lats, decl, precise);
+
+  for (size_t i = 0; i < lats.size(); ++i) {
+    REQUIRE_THAT(fast[i], Catch::Matchers::WithinAbs(precise[i], 1e-12));
+    REQUIRE_THAT(precise[i],
+                 Catch::Matchers::WithinAbs(
+                     astro::calcDailySunExposure(lats[i], decl), 1e-12));
+  }
+}
+
+TEST_CASE("Daily sun exposure in float stays close to double",
+          "[fast_math]") {
+  std::vector<double> lats{};
+  std::vector<float> lats_f{};
+  for (int i = -900; i <= 900; ++i) {
+    lats.push_back(i * M_PI / 1800.0);
+    lats_f.push_back(static_cast<float>(lats.back()));
+  }
+  std::vector<double> precise(lats.size());
+  std::vector<float> fast_f(lats.size()), precise_f(lats.size());
+
+  for (double decl : {-0.4, 0.0, 0.1, 0.41}) {
+    astro::calcDailySunExposure(lats, decl, precise);
+    astro::calcDailySunExposure<math::Fast, float>(lats_f, decl, fast_f);
+    astro::calcDailySunExposure<math::Precise, float>(lats_f, decl,
+                                                      precise_f);
+    for (size_t i = 0; i < lats.size(); ++i) {
+      // one float rounding of the latitude, and one of the result
+      REQUIRE_THAT(fast_f[i], Catch::Matchers::WithinAbs(precise[i], 1e-6));
+      REQUIRE_THAT(precise_f[i],
+                   Catch::Matchers::WithinAbs(precise[i], 1e-6));
+    }
+  }
+}
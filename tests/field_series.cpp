@@ -0,0 +1,265 @@
+#include <catch2/catch_all.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <limits>
+#include <thread>
+#include <vector>
+
+#include "../src/io/field_series.hpp"
+
+using namespace circular;
+
+namespace {
+/// @brief A smoothly varying field, as a model's diagnostics would be.
+std::vector<double> field(size_t step, size_t size) {
+  std::vector<double> values(size);
+  for (size_t i = 0; i < size; ++i) {
+    values[i] = 280.0 + 20.0 * std::sin(0.01 * static_cast<double>(i)) +
+                0.1 * std::cos(0.05 * static_cast<double>(step + i));
+  }
+  return values;
+}
+} // namespace
+
+TEST_CASE("FieldSeries round-trips steps losslessly", "[field_series]") {
+  const size_t size = 1000;
+  {
+    FieldSeriesWriter writer{"field_series_test.fld", "temperature", size,
+                             {.chunkSteps = 8}};
+    for (size_t step = 0; step < 50; ++step) {
+      writer.append(60.0 * static_cast<double>(step), field(step, size));
+    }
+    REQUIRE(writer.steps() == 50);
+    writer.close();
+    REQUIRE_THROWS_AS(writer.append(0.0, field(0, size)), std::logic_error);
+  }
+
+  FieldSeriesReader reader{"field_series_test.fld"};
+  REQUIRE(reader.name() == "temperature");
+  REQUIRE(reader.fieldSize() == size);
+  REQUIRE(reader.steps() == 50);
+  REQUIRE(reader.chunks().size() == 7);
+  // out of order, so that chunks are sought rather than streamed
+  for (size_t step : {49, 0, 17, 16, 33, 8, 7}) {
+    REQUIRE(reader.read(step) == field(step, size));
+    REQUIRE(reader.time(step) == 60.0 * static_cast<double>(step));
+  }
+  REQUIRE_THROWS_AS(reader.read(50), std::out_of_range);
+  std::vector<double> wrong(size + 1);
+  REQUIRE_THROWS_AS(reader.read(0, wrong), std::invalid_argument);
+
+  // the smooth field compresses, even losslessly
+  REQUIRE(std::filesystem::file_size("field_series_test.fld") <
+          50 * size * sizeof(double));
+}
+
+TEST_CASE("FieldSeries quantises to within the tolerance", "[field_series]") {
+  const size_t size = 4096;
+  const double tolerance = 1e-3;
+  {
+    FieldSeriesWriter writer{"field_series_quantised.fld", "t", size,
+                             {.chunkSteps = 4, .tolerance = tolerance}};
+    for (size_t step = 0; step < 12; ++step) {
+      writer.append(static_cast<double>(step), field(step, size));
+    }
+    // a step which cannot be quantised, so its chunk is kept losslessly
+    auto odd = field(12, size);
+    odd[5] = std::numeric_limits<double>::quiet_NaN();
+    odd[6] = std::numeric_limits<double>::infinity();
+    writer.append(12.0, odd);
+  }
+
+  FieldSeriesReader reader{"field_series_quantised.fld"};
+  REQUIRE(reader.steps() == 13);
+  for (size_t step = 0; step < 12; ++step) {
+    const auto expected = field(step, size);
+    const auto values = reader.read(step);
+    for (size_t i = 0; i < size; ++i) {
+      REQUIRE(std::abs(values[i] - expected[i]) <= tolerance);
+    }
+  }
+  const auto odd = reader.read(12);
+  REQUIRE(std::isnan(odd[5]));
+  REQUIRE(odd[6] == std::numeric_limits<double>::infinity());
+  REQUIRE(odd[7] == field(12, size)[7]);
+
+  // far smaller than the raw doubles
+  REQUIRE(std::filesystem::file_size("field_series_quantised.fld") <
+          13 * size * sizeof(double) / 3);
+}
+
+TEST_CASE("FieldSeries can be reopened and appended to", "[field_series]") {
+  const size_t size = 64;
+  {
+    FieldSeriesWriter writer{"field_series_append.fld", "salinity", size,
+                             {.chunkSteps = 5}};
+    for (size_t step = 0; step < 7; ++step) {
+      writer.append(static_cast<double>(step), field(step, size));
+    }
+  }
+  {
+    auto writer = FieldSeriesWriter::reopen("field_series_append.fld");
+    REQUIRE(writer.name() == "salinity");
+    REQUIRE(writer.steps() == 7);
+    for (size_t step = 7; step < 20; ++step) {
+      writer.append(static_cast<double>(step), field(step, size));
+    }
+  }
+
+  FieldSeriesReader reader{"field_series_append.fld"};
+  REQUIRE(reader.steps() == 20);
+  for (size_t step = 0; step < 20; ++step) {
+    REQUIRE(reader.read(step) == field(step, size));
+  }
+}
+
+TEST_CASE("FieldSeries recovers the complete chunks of an unclosed file",
+          "[field_series]") {
+  const size_t size = 32;
+  uint64_t end = 0;
+  {
+    FieldSeriesWriter writer{"field_series_torn.fld", "t", size,
+                             {.chunkSteps = 3}};
+    for (size_t step = 0; step < 9; ++step) {
+      writer.append(static_cast<double>(step), field(step, size));
+    }
+    writer.flush();
+    end = std::filesystem::file_size("field_series_torn.fld");
+  }
+  // lose the index, and tear the last chunk
+  std::filesystem::resize_file("field_series_torn.fld", end - 10);
+
+  FieldSeriesReader reader{"field_series_torn.fld"};
+  REQUIRE(reader.steps() == 6);
+  REQUIRE(reader.read(5) == field(5, size));
+
+  {
+    auto writer = FieldSeriesWriter::reopen("field_series_torn.fld");
+    REQUIRE(writer.steps() == 6);
+    writer.append(6.0, field(100, size));
+  }
+  FieldSeriesReader again{"field_series_torn.fld"};
+  REQUIRE(again.steps() == 7);
+  REQUIRE(again.read(6) == field(100, size));
+}
+
+TEST_CASE("FieldSeries chunk writes survive CancelBackground",
+          "[field_series]") {
+  Tasker io{{.frameWorkers = 1, .backgroundWorkers = 1}};
+  std::atomic<bool> release{false};
+  io.Submit(
+      [&]() {
+        while (!release) {
+          std::this_thread::sleep_for(std::chrono::milliseconds{1});
+        }
+      },
+      Lane::Background);
+
+  const size_t size = 16;
+  {
+    FieldSeriesWriter writer{"field_series_cancel.fld", "t", size,
+                             {.chunkSteps = 2}, io};
+    // the first chunk queues behind the blocker, and is not skipped
+    writer.append(0.0, field(0, size));
+    writer.append(1.0, field(1, size));
+    io.CancelBackground();
+    release = true;
+    for (size_t step = 2; step < 7; ++step) {
+      writer.append(static_cast<double>(step), field(step, size));
+    }
+  }
+
+  FieldSeriesReader reader{"field_series_cancel.fld"};
+  REQUIRE(reader.steps() == 7);
+  for (size_t step = 0; step < 7; ++step) {
+    REQUIRE(reader.read(step) == field(step, size));
+  }
+}
+
+TEST_CASE("FieldSeries rejects bad arguments and files", "[field_series]") {
+  REQUIRE_THROWS_AS(FieldSeriesWriter("field_series_bad.fld", "t", 0),
+                    std::invalid_argument);
+  REQUIRE_THROWS_AS(FieldSeriesWriter("field_series_bad.fld",
+                                      std::string(40, 'x'), 1),
+                    std::invalid_argument);
+  REQUIRE_THROWS_AS(FieldSeriesWriter("field_series_bad.fld", "t", 1,
+                                      {.chunkSteps = 0}),
+                    std::invalid_argument);
+  REQUIRE_THROWS_AS(FieldSeriesWriter("field_series_bad.fld", "t", 1,
+                                      {.tolerance = -1.0}),
+                    std::invalid_argument);
+
+  FieldSeriesWriter writer{"field_series_bad.fld", "t", 4};
+  std::vector<double> three(3);
+  REQUIRE_THROWS_AS(writer.append(0.0, three), std::invalid_argument);
+
+  REQUIRE_THROWS_AS(FieldSeriesReader("tests/fixtures/good.toml"),
+                    std::runtime_error);
+  REQUIRE_THROWS_AS(FieldSeriesReader("no_such_series.fld"),
+                    std::runtime_error);
+}
+
+TEST_CASE("FieldSeries bounds corrupt index entries and chunk headers",
+          "[field_series]") {
+  const size_t size = 16;
+  {
+    FieldSeriesWriter writer{"field_series_corrupt.fld", "t", size,
+                             {.chunkSteps = 4}};
+    for (size_t step = 0; step < 10; ++step) {
+      writer.append(static_cast<double>(step), field(step, size));
+    }
+  }
+  const auto fileBytes = std::filesystem::file_size("field_series_corrupt.fld");
+  std::fstream io{"field_series_corrupt.fld",
+                  std::ios::binary | std::ios::in | std::ios::out};
+  FieldSeriesTrailer trailer{};
+  io.seekg(static_cast<std::streamoff>(fileBytes - sizeof(trailer)));
+  io.read(reinterpret_cast<char *>(&trailer), sizeof(trailer));
+  REQUIRE(trailer.chunkCount == 3);
+
+  // an entry claiming more steps than fit before the index is not trusted,
+  // and the chunks are found by their headers instead
+  const auto last = static_cast<std::streamoff>(
+      trailer.indexOffset + 2 * sizeof(FieldChunkEntry));
+  FieldChunkEntry entry{};
+  io.seekg(last);
+  io.read(reinterpret_cast<char *>(&entry), sizeof(entry));
+  const auto goodEntry = entry;
+  entry.steps = uint64_t{1} << 40;
+  io.seekp(last);
+  io.write(reinterpret_cast<const char *>(&entry), sizeof(entry));
+  io.flush();
+  {
+    FieldSeriesReader reader{"field_series_corrupt.fld"};
+    REQUIRE(reader.steps() == 10);
+    REQUIRE(reader.read(9) == field(9, size));
+  }
+  io.seekp(last);
+  io.write(reinterpret_cast<const char *>(&goodEntry), sizeof(goodEntry));
+
+  // a chunk whose payload overruns the next, or is too small to decode to
+  // its steps, is refused before anything is allocated for it
+  const auto first = static_cast<std::streamoff>(sizeof(FieldSeriesHeader));
+  FieldChunkHeader header{};
+  io.seekg(first);
+  io.read(reinterpret_cast<char *>(&header), sizeof(header));
+  const auto goodHeader = header;
+  for (uint64_t payloadBytes : {uint64_t{1} << 50, uint64_t{1}}) {
+    header.payloadBytes = payloadBytes;
+    io.seekp(first);
+    io.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    io.flush();
+    FieldSeriesReader reader{"field_series_corrupt.fld"};
+    REQUIRE_THROWS_AS(reader.read(0), std::runtime_error);
+    REQUIRE(reader.read(4) == field(4, size));
+  }
+  io.seekp(first);
+  io.write(reinterpret_cast<const char *>(&goodHeader), sizeof(goodHeader));
+  io.flush();
+  REQUIRE(FieldSeriesReader{"field_series_corrupt.fld"}.read(0) ==
+          field(0, size));
+}
@@ -0,0 +1,134 @@
+#include <catch2/catch_all.hpp>
+#include <circular/field_stats.hpp>
+#include <circular/lib.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+using namespace circular;
+
+namespace {
+/// @brief A fixed permutation of 0, 1, ..., n - 1, as doubles.
+std::vector<double> shuffled(size_t n) {
+  std::vector<double> v(n);
+  // Impl: 7919 is prime, so i -> i * 7919 mod n permutes when n is not a
+  // multiple of it
+  for (size_t i = 0; i < n; ++i) {
+    v[i] = static_cast<double>((i * 7919) % n);
+  }
+  return v;
+}
+} // namespace
+
+TEST_CASE("FieldStats agrees with accumulate_vector", "[field_stats]") {
+  std::vector<double> values{};
+  for (int i = 0; i < 5000; ++i) {
+    values.push_back(std::sin(0.01 * i) * 100.0 + 273.15);
+  }
+  auto [mean, var] = accumulate_vector(values);
+
+  FieldStats s{};
+  s.add(values);
+  REQUIRE(s.count() == values.size());
+  REQUIRE_THAT(s.mean(), Catch::Matchers::WithinRel(mean, 1e-12));
+  REQUIRE_THAT(s.variance(), Catch::Matchers::WithinRel(var, 1e-10));
+
+  auto lo = std::min_element(values.begin(), values.end());
+  auto hi = std::max_element(values.begin(), values.end());
+  REQUIRE(s.min() == *lo);
+  REQUIRE(s.max() == *hi);
+  REQUIRE(s.argmin() == static_cast<size_t>(lo - values.begin()));
+  REQUIRE(s.argmax() == static_cast<size_t>(hi - values.begin()));
+}
+
+TEST_CASE("FieldStats skips NaNs and handles empty input", "[field_stats]") {
+  FieldStats s{};
+  REQUIRE(std::isnan(s.mean()));
+  REQUIRE_THROWS_AS(s.argmax(), std::out_of_range);
+
+  auto nan = std::numeric_limits<double>::quiet_NaN();
+  std::vector<double> values{nan, 3.0, nan, -1.0, 3.0};
+  s.add(values, 10);
+  REQUIRE(s.count() == 3);
+  REQUIRE(s.nanCount() == 2);
+  REQUIRE(s.min() == -1.0);
+  REQUIRE(s.argmin() == 13);
+  REQUIRE(s.argmax() == 11);
+  REQUIRE_THROWS_AS(s.quantile(0.5), std::logic_error);
+}
+
+TEST_CASE("FieldStats bins a histogram", "[field_stats]") {
+  FieldStatsOptions options{};
+  options.histogramBins = 4;
+  options.histogramMin = 0.0;
+  options.histogramMax = 4.0;
+  FieldStats s{options};
+
+  std::vector<double> values{-1.0, 0.0, 0.5, 1.0, 2.5, 3.999, 4.0, 9.0};
+  s.add(values);
+  REQUIRE(s.histogram() == std::vector<uint64_t>{2, 1, 1, 2});
+  REQUIRE(s.underflow() == 1);
+  REQUIRE(s.overflow() == 1);
+
+  options.histogramMax = options.histogramMin;
+  REQUIRE_THROWS_AS(FieldStats{options}, std::invalid_argument);
+}
+
+TEST_CASE("QuantileSketch stays small and accurate", "[field_stats]") {
+  const size_t n = 200000;
+  auto values = shuffled(n);
+
+  QuantileSketch sketch{200};
+  sketch.add(values);
+  REQUIRE(sketch.count() == n);
+  REQUIRE(sketch.retained() < 2000);
+
+  for (double q : {0.01, 0.1, 0.25, 0.5, 0.75, 0.9, 0.99}) {
+    auto exact = q * static_cast<double>(n);
+    REQUIRE_THAT(sketch.quantile(q),
+                 Catch::Matchers::WithinAbs(exact, 0.02 * n));
+  }
+  REQUIRE_THROWS_AS(sketch.quantile(1.5), std::invalid_argument);
+  REQUIRE_THROWS_AS(QuantileSketch{4}, std::invalid_argument);
+  REQUIRE(std::isnan(QuantileSketch{}.quantile(0.5)));
+}
+
+TEST_CASE("FieldStats merges parts computed in parallel", "[field_stats]") {
+  const size_t n = 300001;
+  auto values = shuffled(n);
+  values[123456] = -5.0;
+  values[7] = 1e9;
+
+  FieldStatsOptions options{};
+  options.histogramBins = 10;
+  options.histogramMin = 0.0;
+  options.histogramMax = static_cast<double>(n);
+  options.sketchK = 256;
+
+  FieldStats serial{options};
+  serial.add(values);
+
+  auto parallel = FieldStats::compute(values, options, 10000);
+  REQUIRE(parallel.count() == serial.count());
+  REQUIRE_THAT(parallel.mean(), Catch::Matchers::WithinRel(serial.mean(), 1e-12));
+  REQUIRE_THAT(parallel.variance(),
+               Catch::Matchers::WithinRel(serial.variance(), 1e-12));
+  REQUIRE(parallel.argmin() == 123456);
+  REQUIRE(parallel.argmax() == 7);
+  REQUIRE(parallel.histogram() == serial.histogram());
+  REQUIRE(parallel.underflow() == 1);
+  REQUIRE(parallel.overflow() == 1);
+  REQUIRE_THAT(parallel.quantile(0.5),
+               Catch::Matchers::WithinAbs(serial.quantile(0.5), 0.02 * n));
+
+  // the same split gives the same answer, however the workers ran
+  auto again = FieldStats::compute(values, options, 10000);
+  REQUIRE(again.quantile(0.37) == parallel.quantile(0.37));
+
+  REQUIRE(FieldStats::compute({}, options).count() == 0);
+  REQUIRE_THROWS_AS(FieldStats::compute(values, options, 0),
+                    std::invalid_argument);
+  REQUIRE_THROWS_AS(serial.merge(FieldStats{}), std::invalid_argument);
+}
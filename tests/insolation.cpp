@@ -0,0 +1,223 @@
+#include <catch2/catch_all.hpp>
+
+#include <cmath>
+#include <vector>
+
+#include "../src/stat/insolation.hpp"
+
+using namespace circular;
+
+namespace {
+/// @brief The mean exposure over [h1, h2] by the midpoint rule.
+double quadrature(double lat, double decl, double h1, double h2) {
+  const int n = 200000;
+  double sum = 0.0;
+  for (int i = 0; i < n; ++i) {
+    auto h = h1 + (h2 - h1) * (i + 0.5) / n;
+    sum += astro::calcSunExposure(lat, decl, h);
+  }
+  return sum / n;
+}
+} // namespace
+
+TEST_CASE("Instantaneous exposure is the cosine of the zenith angle",
+          "[insolation]") {
+  REQUIRE(astro::calcSunExposure(0.0, 0.0, 0.0) == Catch::Approx(1.0));
+  REQUIRE(astro::calcSunExposure(0.0, 0.0, M_PI) == 0.0);
+  REQUIRE(astro::calcSunExposure(0.5, 0.0, 0.0) ==
+          Catch::Approx(std::cos(0.5)));
+  // the interval form, for an empty interval
+  REQUIRE(astro::calcSunExposure(0.5, 0.2, 1.0, 1.0) ==
+          Catch::Approx(astro::calcSunExposure(0.5, 0.2, 1.0)));
+}
+
+TEST_CASE("Exposure over a day is the standard daily mean", "[insolation]") {
+  for (double decl : {-0.41, 0.0, 0.2, 0.41}) {
+    for (int i = -90; i <= 90; i += 5) {
+      double lat = i * M_PI / 180.0;
+      auto daily = astro::calcSunExposure(lat, decl, -M_PI, M_PI);
+      auto det = std::clamp(-std::tan(lat) * std::tan(decl), -1.0, 1.0);
+      auto H0 = std::acos(det);
+      auto expected = M_1_PI * (H0 * std::sin(lat) * std::sin(decl) +
+                                std::cos(lat) * std::cos(decl) * std::sin(H0));
+      REQUIRE_THAT(daily, Catch::Matchers::WithinAbs(expected, 1e-12));
+      // and any whole day, wherever it starts
+      REQUIRE_THAT(astro::calcSunExposure(lat, decl, 1.0, 1.0 + 2.0 * M_PI),
+                   Catch::Matchers::WithinAbs(expected, 1e-12));
+      // which is what the daily kernels compute
+      REQUIRE_THAT(astro::calcDailySunExposure(lat, decl),
+                   Catch::Matchers::WithinAbs(expected, 1e-12));
+    }
+  }
+  // at the equator at an equinox, the sun is up half the day
+  REQUIRE(astro::calcDailySunExposure(0.0, 0.0) == Catch::Approx(M_1_PI));
+}
+
+TEST_CASE("The daily exposures and insolation agree", "[insolation]") {
+  std::vector<double> lats{-M_PI_2, -1.0, -0.2, 0.0, 0.3, 1.4, M_PI_2};
+  const astro::Star star{};
+  for (double decl : {-0.41, 0.0, 0.35}) {
+    std::vector<double> exposure(lats.size()), flux(lats.size());
+    astro::calcDailySunExposure(lats, decl, exposure);
+    astro::calcDailyInsolation(lats, decl, {&star, 1}, flux);
+    for (size_t i = 0; i < lats.size(); ++i) {
+      const auto daily = astro::calcSunExposure(lats[i], decl, -M_PI, M_PI);
+      REQUIRE_THAT(exposure[i], Catch::Matchers::WithinAbs(daily, 1e-12));
+      REQUIRE_THAT(flux[i], Catch::Matchers::WithinAbs(
+                                astro::sunConstant(star) * daily, 1e-9));
+    }
+  }
+}
+
+TEST_CASE("Exposure over sub-daily and multi-day windows matches quadrature",
+          "[insolation]") {
+  struct Window {
+    double lat, decl, h1, h2;
+  };
+  std::vector<Window> windows{
+      {0.3, 0.2, -0.5, 0.5},          // around noon
+      {0.3, 0.2, 2.0, 4.5},           // across midnight
+      {-1.2, 0.4, -3.0, 3.0},         // polar night
+      {1.4, 0.4, 0.0, 1.0},           // polar day
+      {0.7, -0.1, -20.0, -13.0},      // some days ago
+      {0.1, 0.3, 100.0, 100.0 + 9.0}, // over a day and a half
+  };
+  for (const auto &w : windows) {
+    REQUIRE_THAT(astro::calcSunExposure(w.lat, w.decl, w.h1, w.h2),
+                 Catch::Matchers::WithinAbs(
+                     quadrature(w.lat, w.decl, w.h1, w.h2), 1e-8));
+  }
+}
+
+TEST_CASE("The exposure block matches the scalar function", "[insolation]") {
+  const double day = 86400.0;
+  std::vector<double> lats{}, lons{};
+  for (int i = -90; i <= 90; i += 15) {
+    lats.push_back(i * M_PI / 180.0);
+  }
+  for (int j = 0; j < 360; j += 20) {
+    lons.push_back(j * M_PI / 180.0);
+  }
+  std::vector<astro::InsolationSlice> slices{
+      {0.0, 3600.0, 0.1},
+      {3600.0, 3600.0, 0.1},
+      {-7200.0, 2.5 * day, -0.3},
+      {40.0 * day + 5000.0, 40.0 * day + 9000.0, 0.2}};
+  std::vector<double> out(slices.size() * lats.size() * lons.size());
+  std::vector<double> fast(out.size());
+
+  astro::calcSunExposure(lats, lons, slices, day, out);
+  astro::calcSunExposure<math::Fast>(lats, lons, slices, day, fast);
+
+  const double omega = 2.0 * M_PI / day;
+  size_t k = 0;
+  for (const auto &s : slices) {
+    for (auto lat : lats) {
+      for (auto lon : lons) {
+        auto expected =
+            astro::calcSunExposure(lat, s.declination, omega * s.begin + lon,
+                                   omega * s.end + lon);
+        REQUIRE_THAT(out[k], Catch::Matchers::WithinAbs(expected, 1e-12));
+        REQUIRE_THAT(fast[k], Catch::Matchers::WithinAbs(expected, 1e-12));
+        ++k;
+      }
+    }
+  }
+
+  std::vector<double> parallel(out.size());
+  astro::calcSunExposureAsync(lats, lons, slices, day, parallel, 3).get();
+  REQUIRE(parallel == out);
+}
+
+TEST_CASE("The exposure block rejects bad arguments", "[insolation]") {
+  std::vector<double> lats{0.0, 0.5}, lons{0.0};
+  std::vector<astro::InsolationSlice> slices{{0.0, 1.0, 0.0}};
+  std::vector<double> out(2), wrong(3);
+
+  REQUIRE_THROWS_AS(astro::calcSunExposure(lats, lons, slices, 1.0, wrong),
+                    std::invalid_argument);
+  REQUIRE_THROWS_AS(astro::calcSunExposure(lats, lons, slices, 0.0, out),
+                    std::invalid_argument);
+  std::vector<astro::InsolationSlice> backwards{{1.0, 0.0, 0.0}};
+  REQUIRE_THROWS_AS(astro::calcSunExposure(lats, lons, backwards, 1.0, out),
+                    std::invalid_argument);
+  REQUIRE_THROWS_AS(
+      astro::calcSunExposureAsync(lats, lons, slices, 1.0, out, 0),
+      std::invalid_argument);
+}
+
+TEST_CASE("Insolation from several stars is the sum of their exposures",
+          "[insolation]") {
+  std::vector<astro::Star> stars(2);
+  stars[0].size = 0.649;
+  stars[0].temp = 4450.0;
+  stars[1] = {0.226, 3311.0, 1.03e+11, 0.3, -0.05};
+  std::vector<double> lats{-1.5, -0.4, 0.0, 0.7, 1.2};
+  std::vector<double> lons{0.0, 1.0, 2.5, 4.0, 6.0};
+  const double day = 86400.0;
+  const double omega = 2.0 * M_PI / day;
+  std::vector<astro::InsolationSlice> slices{
+      {0.0, 0.0, 0.2}, {-3600.0, 7200.0, 0.1}, {0.0, day, -0.3}};
+
+  std::vector<double> flux(slices.size() * lats.size() * lons.size());
+  std::vector<double> fast(flux.size());
+  astro::calcInsolation(lats, lons, slices, day, stars, flux);
+  astro::calcInsolation<math::Fast>(lats, lons, slices, day, stars, fast);
+  size_t k = 0;
+  for (const auto &s : slices) {
+    for (auto lat : lats) {
+      for (auto lon : lons) {
+        double expected = 0.0;
+        for (const auto &star : stars) {
+          const auto h = lon - star.hourOffset;
+          expected += astro::sunConstant(star) *
+                      astro::calcSunExposure(
+                          lat, s.declination + star.declinationOffset,
+                          omega * s.begin + h, omega * s.end + h);
+        }
+        REQUIRE_THAT(flux[k], Catch::Matchers::WithinAbs(expected, 1e-9));
+        REQUIRE_THAT(fast[k], Catch::Matchers::WithinAbs(expected, 1e-9));
+        ++k;
+      }
+    }
+  }
+
+  std::vector<double> parallel(flux.size());
+  astro::calcInsolationAsync(lats, lons, slices, day, stars, parallel, 2)
+      .get();
+  REQUIRE(parallel == flux);
+  REQUIRE_THROWS_AS(
+      astro::calcInsolation(lats, lons, slices, 0.0, stars, flux),
+      std::invalid_argument);
+}
+
+TEST_CASE("Daily insolation from several stars sums their daily means",
+          "[insolation]") {
+  std::vector<astro::Star> stars(3);
+  stars[1].declinationOffset = 0.1;
+  stars[2] = {0.5, 4000.0, 2.0e+11, 1.0, -0.2};
+  std::vector<double> lats{-M_PI_2, -1.0, -0.2, 0.0, 0.3, 1.4, M_PI_2};
+  const double decl = 0.35;
+
+  std::vector<double> flux(lats.size());
+  std::vector<double> fast(lats.size());
+  astro::calcDailyInsolation(lats, decl, stars, flux);
+  astro::calcDailyInsolation<math::Fast>(lats, decl, stars, fast);
+  for (size_t i = 0; i < lats.size(); ++i) {
+    double expected = 0.0;
+    for (const auto &star : stars) {
+      expected += astro::sunConstant(star) *
+                  astro::calcSunExposure(
+                      lats[i], decl + star.declinationOffset, -M_PI, M_PI);
+    }
+    REQUIRE_THAT(flux[i], Catch::Matchers::WithinAbs(expected, 1e-9));
+    REQUIRE_THAT(fast[i], Catch::Matchers::WithinAbs(expected, 1e-9));
+  }
+  // the summer pole is lit all day, and the winter pole not at all
+  REQUIRE(flux.front() == 0.0);
+  REQUIRE(flux.back() > 0.0);
+
+  std::vector<double> wrong(lats.size() + 1);
+  REQUIRE_THROWS_AS(astro::calcDailyInsolation(lats, decl, stars, wrong),
+                    std::invalid_argument);
+}
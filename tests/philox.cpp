@@ -0,0 +1,93 @@
+#include <catch2/catch_all.hpp>
+
+#include <algorithm>
+#include <circular/tasker.hpp>
+#include <cmath>
+#include <vector>
+
+#include "../src/stat/philox.hpp"
+
+using namespace circular;
+
+TEST_CASE("Philox4x32-10 matches the published known answers", "[philox]") {
+  // from the Random123 distribution's kat_vectors
+  STATIC_REQUIRE(rng::philox4x32({0, 0, 0, 0}, {0, 0}) ==
+                 rng::PhiloxCounter{0x6627e8d5, 0xe169c58d, 0xbc57ac4c,
+                                    0x9b00dbd8});
+  REQUIRE(rng::philox4x32({0x243f6a88, 0x85a308d3, 0x13198a2e, 0x03707344},
+                          {0xa4093822, 0x299f31d0}) ==
+          rng::PhiloxCounter{0xd16cfe09, 0x94fdcceb, 0x5001e420, 0x24126ea1});
+  REQUIRE(rng::Philox(0).block(0, 0) == rng::philox4x32({}, {}));
+  REQUIRE(rng::Philox(0x123456789abcdef0).seed() == 0x123456789abcdef0);
+}
+
+TEST_CASE("Philox draws are a function of seed, step and index",
+          "[philox]") {
+  const rng::Philox a{42};
+  REQUIRE(a.uniform(3, 17) == rng::Philox{42}.uniform(3, 17));
+  REQUIRE(a.uniform(3, 17) != a.uniform(4, 17));
+  REQUIRE(a.uniform(3, 17) != a.uniform(3, 18));
+  REQUIRE(a.uniform(3, 17) != rng::Philox{43}.uniform(3, 17));
+
+  // batches match single draws, from any starting index
+  std::vector<double> u(301);
+  std::vector<double> z(301);
+  a.uniform(9, 5, u);
+  a.normal(9, 5, z);
+  for (size_t i = 0; i < u.size(); ++i) {
+    REQUIRE(u[i] == a.uniform(9, 5 + i));
+    REQUIRE(z[i] == a.normal(9, 5 + i));
+  }
+}
+
+TEST_CASE("Philox fills are the same however they are split", "[philox]") {
+  const rng::Philox p{2024};
+  const size_t n = 10007;
+  std::vector<double> whole(n);
+  p.normal(11, 0, whole);
+
+  std::vector<double> chunked(n);
+  for (size_t first = 0, size = 1; first < n; first += size, size += 7) {
+    size = std::min(size, n - first);
+    p.normal(11, first, std::span<double>{chunked}.subspan(first, size));
+  }
+  REQUIRE(chunked == whole);
+
+  std::vector<double> parallel(n);
+  std::vector<Future<>> parts{};
+  for (size_t first = 0; first < n; first += 333) {
+    const auto size = std::min<size_t>(333, n - first);
+    parts.push_back(Tasker::Get().Submit([&, first, size]() {
+      p.normal(11, first, std::span<double>{parallel}.subspan(first, size));
+    }));
+  }
+  when_all(std::move(parts)).get();
+  REQUIRE(parallel == whole);
+}
+
+TEST_CASE("Philox draws have the right distributions", "[philox]") {
+  const rng::Philox p{7};
+  const size_t n = 1 << 18;
+  std::vector<double> u(n);
+  std::vector<double> z(n);
+  p.uniform(0, 0, u);
+  p.normal(0, 0, z);
+
+  REQUIRE(*std::min_element(u.begin(), u.end()) >= 0.0);
+  REQUIRE(*std::max_element(u.begin(), u.end()) < 1.0);
+  REQUIRE(std::all_of(z.begin(), z.end(),
+                      [](double x) { return std::isfinite(x); }));
+
+  double uSum = 0.0;
+  double zSum = 0.0;
+  double zSquares = 0.0;
+  for (size_t i = 0; i < n; ++i) {
+    uSum += u[i];
+    zSum += z[i];
+    zSquares += z[i] * z[i];
+  }
+  // each within about five standard errors
+  REQUIRE(std::abs(uSum / n - 0.5) < 0.003);
+  REQUIRE(std::abs(zSum / n) < 0.01);
+  REQUIRE(std::abs(zSquares / n - 1.0) < 0.015);
+}
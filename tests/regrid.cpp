@@ -0,0 +1,154 @@
+#include <catch2/catch_all.hpp>
+
+#include <cmath>
+#include <numeric>
+#include <vector>
+
+#include "../src/stat/regrid.hpp"
+
+using namespace circular;
+
+namespace {
+/// @brief A smooth, lumpy field, so that regridding it is not trivial.
+std::vector<double> lumpyField(const grid::LatLonGrid &g) {
+  std::vector<double> values{};
+  for (size_t i = 0; i < g.lats(); ++i) {
+    for (size_t j = 0; j < g.lons(); ++j) {
+      const auto lat = 0.5 * (g.latEdges()[i] + g.latEdges()[i + 1]);
+      const auto lon = 0.5 * (g.lonEdges()[j] + g.lonEdges()[j + 1]);
+      values.push_back(280.0 + 30.0 * std::cos(lat) +
+                       5.0 * std::sin(3.0 * lon) * std::cos(lat));
+    }
+  }
+  return values;
+}
+} // namespace
+
+TEST_CASE("LatLonGrid cell areas cover the body", "[regrid]") {
+  const auto world = World(ConfigMap{});
+  const auto g = grid::LatLonGrid::uniform(18, 36);
+  REQUIRE(g.size() == 18 * 36);
+  const auto areas = g.cellAreas(world);
+  REQUIRE(std::accumulate(areas.begin(), areas.end(), 0.0) ==
+          Catch::Approx(world.getBodySurfaceArea()));
+
+  REQUIRE_THROWS_AS(grid::LatLonGrid({0.0}, {0.0, 1.0}),
+                    std::invalid_argument);
+  REQUIRE_THROWS_AS(grid::LatLonGrid({0.0, 2.0}, {0.0, 1.0}),
+                    std::invalid_argument);
+  REQUIRE_THROWS_AS(grid::LatLonGrid({0.0, 1.0}, {1.0, 0.5}),
+                    std::invalid_argument);
+  REQUIRE_THROWS_AS(grid::LatLonGrid({0.0, 1.0}, {0.0, 7.0}),
+                    std::invalid_argument);
+  REQUIRE_THROWS_AS(grid::LatLonGrid::uniform(0, 1), std::invalid_argument);
+}
+
+TEST_CASE("Regridding conserves area integrals", "[regrid]") {
+  const auto world = World(ConfigMap{});
+  const auto zonal = grid::LatLonGrid::uniform(9, 1);
+  const auto fine = grid::LatLonGrid::uniform(40, 72);
+  // offset by a third of a turn, so that longitudes wrap around
+  std::vector<double> lonEdges{};
+  for (int j = 0; j <= 25; ++j) {
+    lonEdges.push_back(2.0 * M_PI * (j / 25.0 - 1.0 / 3.0));
+  }
+  const auto offset = grid::LatLonGrid(grid::LatLonGrid::uniform(31, 1)
+                                           .latEdges(),
+                                       lonEdges);
+
+  for (const auto *source : {&zonal, &fine, &offset}) {
+    for (const auto *target : {&zonal, &fine, &offset}) {
+      const auto r = grid::Regridder(*source, *target, world);
+      const auto in = lumpyField(*source);
+      std::vector<double> out(target->size());
+      r.apply(in, out);
+      REQUIRE(r.targetIntegral(out) ==
+              Catch::Approx(r.sourceIntegral(in)).epsilon(1e-12));
+
+      // and a constant stays constant
+      std::vector<double> constant(source->size(), 3.5);
+      r.apply(constant, out);
+      for (auto v : out) {
+        REQUIRE(v == Catch::Approx(3.5).epsilon(1e-12));
+      }
+    }
+  }
+}
+
+TEST_CASE("Regridding to a finer grid and back recovers the field",
+          "[regrid]") {
+  const auto world = World(ConfigMap{});
+  const auto zonal = grid::LatLonGrid::uniform(9, 1);
+  const auto fine = grid::LatLonGrid::uniform(36, 12);
+  const auto up = grid::Regridder(zonal, fine, world);
+  const auto down = grid::Regridder(fine, zonal, world);
+
+  const auto in = lumpyField(zonal);
+  std::vector<double> between(fine.size());
+  std::vector<double> out(zonal.size());
+  up.apply(in, between);
+  down.apply(between, out);
+  for (size_t i = 0; i < in.size(); ++i) {
+    REQUIRE(out[i] == Catch::Approx(in[i]).epsilon(1e-12));
+  }
+  // each fine cell lies within one band
+  REQUIRE(up.nonZeros() == fine.size());
+}
+
+TEST_CASE("Regridding only weights overlapping cells", "[regrid]") {
+  const auto world = World(ConfigMap{});
+  // the northern hemisphere's eastern half, onto the whole sphere
+  const auto part = grid::LatLonGrid({0.0, M_PI_4, M_PI_2}, {0.0, M_PI});
+  const auto whole = grid::LatLonGrid::uniform(2, 2);
+  const auto r = grid::Regridder(part, whole, world);
+  std::vector<double> in{1.0, 1.0};
+  std::vector<double> out(4);
+  r.apply(in, out);
+  REQUIRE(out == std::vector<double>{0.0, 0.0, 1.0, 0.0});
+  REQUIRE(r.targetIntegral(out) == Catch::Approx(r.sourceIntegral(in)));
+}
+
+TEST_CASE("Regridding a partly covered cell takes the mean of the cover",
+          "[regrid]") {
+  const auto world = World(ConfigMap{});
+  // the lower half of the northern hemisphere's eastern half, in two cells
+  const auto part =
+      grid::LatLonGrid({0.0, M_PI / 12.0, M_PI / 6.0}, {0.0, M_PI});
+  const auto whole = grid::LatLonGrid::uniform(2, 2);
+  const auto r = grid::Regridder(part, whole, world);
+  std::vector<double> out(4);
+
+  r.apply(std::vector<double>{2.0, 2.0}, out);
+  REQUIRE(out[2] == Catch::Approx(2.0).epsilon(1e-12));
+
+  // weighted by the area of each source cell, not of the target cell
+  const auto areas = r.sourceAreas();
+  r.apply(std::vector<double>{1.0, 4.0}, out);
+  REQUIRE(out[2] == Catch::Approx((areas[0] + 4.0 * areas[1]) /
+                                  (areas[0] + areas[1]))
+                        .epsilon(1e-12));
+  REQUIRE(out[0] == 0.0);
+  REQUIRE(out[1] == 0.0);
+  REQUIRE(out[3] == 0.0);
+}
+
+TEST_CASE("Regridding in parallel matches regridding in serial",
+          "[regrid]") {
+  const auto world = World(ConfigMap{});
+  const auto source = grid::LatLonGrid::uniform(90, 180);
+  const auto target = grid::LatLonGrid::uniform(256, 512);
+  const auto r = grid::Regridder(source, target, world);
+  REQUIRE(r.blocks() > 1);
+
+  const auto in = lumpyField(source);
+  std::vector<double> serial(target.size());
+  std::vector<double> parallel(target.size());
+  r.apply(in, serial);
+  r.applyAsync(in, parallel).get();
+  REQUIRE(serial == parallel);
+
+  std::vector<double> wrong(source.size() + 1);
+  REQUIRE_THROWS_AS(r.apply(wrong, serial), std::invalid_argument);
+  REQUIRE_THROWS_AS(r.applyAsync(in, wrong), std::invalid_argument);
+  REQUIRE_THROWS_AS(r.sourceIntegral(wrong), std::invalid_argument);
+}
@@ -0,0 +1,111 @@
+#include <catch2/catch_all.hpp>
+
+#include <vector>
+
+#include "../src/stat/seawater.hpp"
+
+using namespace circular;
+
+TEST_CASE("Water density peaks a few degrees above freezing", "[seawater]") {
+  constexpr auto zero = ocean::waterDensity(param::TempZeroCelsius);
+  STATIC_REQUIRE(zero == param::DensityWaterZero);
+
+  auto at = [](double celsius) {
+    return ocean::waterDensity(param::TempZeroCelsius + celsius);
+  };
+  REQUIRE(at(3.7) > at(0.0));
+  REQUIRE(at(3.7) > at(8.0));
+  REQUIRE(at(20.0) == Catch::Approx(998.7).epsilon(1e-3));
+}
+
+TEST_CASE("Salt lowers the freezing point", "[seawater]") {
+  STATIC_REQUIRE(ocean::freezingPoint(0.0) == param::TempZeroCelsius);
+
+  // about -2 C for typical seawater
+  REQUIRE(ocean::freezingPoint(35.0) ==
+          Catch::Approx(param::TempZeroCelsius - 2.2).margin(0.1));
+  REQUIRE(ocean::freezingPoint(70.0) < ocean::freezingPoint(35.0));
+  REQUIRE(ocean::freezingPoint(1000.0) ==
+          ocean::freezingPoint(param::SalinityBrine));
+}
+
+TEST_CASE("Column kernels match the scalar functions", "[seawater]") {
+  std::vector<double> temps{260.0, 271.0, 273.15, 277.0, 300.0};
+  std::vector<double> salts{0.0, 10.0, 35.0, 100.0, 400.0};
+  std::vector<double> water{1.0, 2.0, 0.0, 3.0, 4.0};
+  std::vector<double> ice{0.5, 0.0, 1.0, 0.0, 2.0};
+  std::vector<double> out(temps.size());
+
+  ocean::waterDensity(temps, out);
+  for (size_t i = 0; i < temps.size(); ++i) {
+    REQUIRE(out[i] == ocean::waterDensity(temps[i]));
+  }
+  ocean::freezingPoint(salts, out);
+  for (size_t i = 0; i < temps.size(); ++i) {
+    REQUIRE(out[i] == ocean::freezingPoint(salts[i]));
+  }
+  ocean::enthalpy({temps, salts, water, ice}, out);
+  for (size_t i = 0; i < temps.size(); ++i) {
+    REQUIRE(out[i] == ocean::enthalpy(temps[i], salts[i], water[i], ice[i]));
+  }
+
+  std::vector<double> short_out(2);
+  REQUIRE_THROWS_AS(ocean::waterDensity(temps, short_out),
+                    std::invalid_argument);
+  REQUIRE_THROWS_AS(ocean::freezeMelt({temps, salts, water, short_out}),
+                    std::invalid_argument);
+}
+
+TEST_CASE("freezeMelt conserves enthalpy and salt", "[seawater]") {
+  // supercooled seawater, warm water over ice, cold ice, empty and fresh cells
+  std::vector<double> temps{265.0, 280.0, 250.0, 273.15, 272.0, 220.0};
+  std::vector<double> salts{35.0, 35.0, 0.0, 0.0, 0.0, 300.0};
+  std::vector<double> water{1000.0, 500.0, 0.0, 0.0, 10.0, 100.0};
+  std::vector<double> ice{0.0, 20.0, 100.0, 0.0, 0.0, 0.0};
+  ocean::WaterColumns cells{temps, salts, water, ice};
+
+  std::vector<double> h_before(temps.size());
+  std::vector<double> salt_before(temps.size());
+  ocean::enthalpy(cells, h_before);
+  for (size_t i = 0; i < temps.size(); ++i) {
+    salt_before[i] = water[i] * salts[i];
+  }
+
+  for (int step = 0; step < 5; ++step) {
+    ocean::freezeMelt(cells);
+  }
+
+  std::vector<double> h_after(temps.size());
+  ocean::enthalpy(cells, h_after);
+  for (size_t i = 0; i < temps.size(); ++i) {
+    REQUIRE(h_after[i] == Catch::Approx(h_before[i]).margin(1e-6));
+    REQUIRE(water[i] * salts[i] ==
+            Catch::Approx(salt_before[i]).margin(1e-9));
+    REQUIRE(water[i] >= 0.0);
+    REQUIRE(ice[i] >= 0.0);
+    REQUIRE(salts[i] <= param::SalinityBrine * (1.0 + 1e-12));
+  }
+
+  // the supercooled seawater froze, and settled at its new freezing point
+  REQUIRE(ice[0] > 0.0);
+  REQUIRE(salts[0] > 35.0);
+  REQUIRE(temps[0] == Catch::Approx(ocean::freezingPoint(salts[0])));
+
+  // the warm water melted all the ice, and is still above freezing
+  REQUIRE(ice[1] == 0.0);
+  REQUIRE(water[1] == Catch::Approx(520.0));
+  REQUIRE(temps[1] > ocean::freezingPoint(salts[1]));
+
+  // ice below freezing, and an empty cell, are untouched
+  REQUIRE(temps[2] == 250.0);
+  REQUIRE(ice[2] == 100.0);
+  REQUIRE(temps[3] == 273.15);
+
+  // fresh water froze at exactly 0 C
+  REQUIRE(ice[4] > 0.0);
+  REQUIRE(temps[4] == Catch::Approx(param::TempZeroCelsius));
+
+  // near-brine froze only until saturated
+  REQUIRE(salts[5] == Catch::Approx(param::SalinityBrine));
+  REQUIRE(water[5] > 0.0);
+}
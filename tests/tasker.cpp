@@ -1,13 +1,20 @@
 
 #include <catch2/catch_all.hpp>
+#include <circular/pipeline.hpp>
 #include <circular/tasker.hpp>
 #include <taskflow/taskflow.hpp>
 
 #include <chrono>
 #include <iostream>
+#include <numeric>
 #include <string>
 #include <thread>
 
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
 using namespace std::chrono_literals;
 
 /* These test cases will be more useful if Tasker becomes an interface that a
@@ -40,4 +47,524 @@ TEST_CASE("Tasker executes a tf::taskflow in order", "[tasker]") {
   fu.wait();
 
   REQUIRE(res == "ab");
-}
\ No newline at end of file
+
+  // and reports what went wrong, as Submit(task) does
+  tf::Taskflow failing;
+  failing.emplace([]() { throw std::invalid_argument{"nope"}; });
+  REQUIRE_THROWS_AS(circular::Tasker::Get().Submit(std::move(failing)).get(),
+                    std::invalid_argument);
+}
+
+TEST_CASE("Tasker reruns a persistent graph with rebound parameters",
+          "[tasker]") {
+  auto &tasker = circular::Tasker::Get();
+  auto &g = tasker.DefineGraph("test_step");
+  REQUIRE_THROWS_AS(tasker.DefineGraph("test_step"), std::invalid_argument);
+  REQUIRE(tasker.HasGraph("test_step"));
+
+  struct StepParams {
+    int increment = 1;
+  };
+  auto &params = g.Bind(StepParams{});
+  std::atomic<int> total{0};
+  std::string order{};
+  auto [a, b] = g.Flow().emplace(
+      [&]() {
+        order.append("a");
+        total += params.increment;
+      },
+      [&]() { order.append("b"); });
+  a.precede(b);
+
+  tasker.Run("test_step").wait();
+  REQUIRE(total == 1);
+  REQUIRE(order == "ab");
+
+  g.Rebind(StepParams{10});
+  tasker.RunN("test_step", 3).wait();
+  REQUIRE(total == 31);
+  REQUIRE(order == "abababab");
+
+  int runs = 0;
+  tasker.RunUntil("test_step", [&]() { return runs++ == 2; }).get();
+  REQUIRE(total == 51);
+
+  auto stats = g.Stats();
+  REQUIRE(stats.runs == 6);
+  REQUIRE(stats.min <= stats.mean());
+  REQUIRE(stats.mean() <= stats.max);
+  REQUIRE(stats.total >= stats.last);
+
+  // a task which throws ends the runs, and fails the Future
+  auto &failing = tasker.DefineGraph("test_throw");
+  failing.Flow().emplace([]() { throw std::invalid_argument{"nope"}; });
+  REQUIRE_THROWS_AS(tasker.RunN("test_throw", 2).get(), std::invalid_argument);
+  REQUIRE_FALSE(failing.Running());
+  tasker.EraseGraph("test_throw");
+
+  REQUIRE_THROWS_AS(g.Params<double>(), std::bad_any_cast);
+  tasker.EraseGraph("test_step");
+  REQUIRE_FALSE(tasker.HasGraph("test_step"));
+  REQUIRE_THROWS_AS(tasker.Graph("test_step"), std::out_of_range);
+}
+
+TEST_CASE("Tasker refuses to rebind or erase a running graph", "[tasker]") {
+  auto &tasker = circular::Tasker::Get();
+  auto &g = tasker.DefineGraph("test_slow");
+  g.Bind(0);
+  g.Flow().emplace([]() { std::this_thread::sleep_for(100ms); });
+
+  auto fu = tasker.Run("test_slow");
+  REQUIRE(g.Running());
+  REQUIRE_THROWS_AS(g.Rebind(1), std::logic_error);
+  REQUIRE_THROWS_AS(tasker.EraseGraph("test_slow"), std::logic_error);
+  fu.wait();
+
+  REQUIRE_FALSE(g.Running());
+  g.Rebind(1);
+  REQUIRE(g.Params<int>() == 1);
+  tasker.EraseGraph("test_slow");
+}
+
+TEST_CASE("Tasker runs lanes on separate workers and reports latency",
+          "[tasker]") {
+  auto &tasker = circular::Tasker::Get();
+  REQUIRE(tasker.WorkerCount(circular::Lane::Frame) >= 1);
+  REQUIRE(tasker.WorkerCount(circular::Lane::Background) >= 1);
+  tasker.ResetStats(circular::Lane::Background);
+
+  // Impl: occupy every background worker; frame work must still get through
+  std::atomic<bool> release{false};
+  std::vector<circular::Future<>> blockers{};
+  for (size_t i = 0; i < tasker.WorkerCount(circular::Lane::Background); ++i) {
+    blockers.push_back(tasker.Submit(
+        [&]() {
+          while (!release) {
+            std::this_thread::sleep_for(1ms);
+          }
+        },
+        circular::Lane::Background));
+  }
+  bool ran = false;
+  auto late = tasker.Submit([&]() { ran = true; }, circular::Lane::Background);
+
+  bool frameRan = false;
+  tasker.Submit([&]() { frameRan = true; }).wait();
+  REQUIRE(frameRan);
+
+  tasker.CancelBackground();
+  release = true;
+  for (auto &b : blockers) {
+    b.wait();
+  }
+  REQUIRE_THROWS_AS(late.get(), std::runtime_error);
+  REQUIRE_FALSE(ran);
+
+  auto stats = tasker.Stats(circular::Lane::Background);
+  REQUIRE(stats.submitted == blockers.size() + 1);
+  REQUIRE(stats.completed + stats.cancelled == stats.submitted);
+  REQUIRE(stats.cancelled >= 1);
+  REQUIRE(stats.queueMax >= stats.meanQueue());
+}
+
+TEST_CASE("Tasker tracks frame deadlines", "[tasker]") {
+  auto &tasker = circular::Tasker::Get();
+  auto missed = tasker.FramesMissed();
+
+  tasker.BeginFrame(10s);
+  REQUIRE_FALSE(tasker.ShouldYield());
+  std::atomic<bool> started{false}, release{false};
+  auto fu = tasker.Submit([&]() {
+    started = true;
+    while (!release) {
+      std::this_thread::sleep_for(1ms);
+    }
+  });
+  while (!started) {
+    std::this_thread::sleep_for(1ms);
+  }
+  REQUIRE(tasker.ShouldYield());
+  release = true;
+  fu.wait();
+  REQUIRE(tasker.EndFrame());
+  REQUIRE_FALSE(tasker.ShouldYield());
+
+  tasker.BeginFrame(1ns);
+  std::this_thread::sleep_for(1ms);
+  // past the deadline, even with no frame work
+  REQUIRE(tasker.ShouldYield());
+  REQUIRE_FALSE(tasker.EndFrame());
+  REQUIRE(tasker.FramesMissed() == missed + 1);
+  REQUIRE_THROWS_AS(tasker.EndFrame(), std::logic_error);
+}
+
+TEST_CASE("Tasker counts a cancelled queued task, and still shuts down",
+          "[tasker]") {
+  circular::Tasker io{{.frameWorkers = 1, .backgroundWorkers = 1}};
+
+  // Impl: occupy the only frame worker, so that the next task stays queued
+  std::atomic<bool> started{false}, release{false};
+  auto blocker = io.Submit([&]() {
+    started = true;
+    while (!release) {
+      std::this_thread::sleep_for(1ms);
+    }
+  });
+  while (!started) {
+    std::this_thread::sleep_for(1ms);
+  }
+  bool ran = false;
+  auto queued = io.Submit([&]() { ran = true; });
+  REQUIRE(queued.cancel());
+  release = true;
+  blocker.wait();
+  REQUIRE_THROWS_AS(queued.get(), std::runtime_error);
+
+  auto stats = io.Stats(circular::Lane::Frame);
+  REQUIRE(stats.submitted == 2);
+  REQUIRE(stats.completed == 1);
+  REQUIRE(stats.cancelled == 1);
+  io.BeginFrame(10s);
+  REQUIRE_FALSE(io.ShouldYield());
+  io.EndFrame();
+
+  io.Shutdown();
+  REQUIRE_FALSE(ran);
+}
+
+TEST_CASE("Tasker futures carry values and exceptions", "[tasker]") {
+  auto &tasker = circular::Tasker::Get();
+
+  auto answer = tasker.Submit([]() { return 6 * 7; });
+  REQUIRE(answer.get() == 42);
+  REQUIRE_FALSE(answer.valid());
+  REQUIRE_THROWS_AS(answer.wait(), std::logic_error);
+
+  auto failing = tasker.Submit([]() -> int {
+    throw std::invalid_argument{"nope"};
+  });
+  REQUIRE_THROWS_AS(failing.get(), std::invalid_argument);
+}
+
+TEST_CASE("Tasker futures chain continuations", "[tasker]") {
+  auto &tasker = circular::Tasker::Get();
+
+  auto chained = tasker.Submit([]() { return 2; })
+                     .then([](int x) { return std::to_string(x * 21); })
+                     .then([](std::string s) { return s + "!"; });
+  REQUIRE(chained.get() == "42!");
+
+  bool skipped = true;
+  auto failed = tasker.Submit([]() -> int { throw std::runtime_error{"a"}; })
+                    .then([&](int) {
+                      skipped = false;
+                      return 0;
+                    });
+  REQUIRE_THROWS_AS(failed.get(), std::runtime_error);
+  REQUIRE(skipped);
+
+  std::atomic<int> count{0};
+  tasker.Submit([&]() { ++count; }).then([&]() { ++count; }).get();
+  REQUIRE(count == 2);
+}
+
+TEST_CASE("Tasker futures combine with when_all and when_any", "[tasker]") {
+  auto &tasker = circular::Tasker::Get();
+
+  std::vector<circular::Future<int>> parts{};
+  for (int i = 0; i < 8; ++i) {
+    parts.push_back(tasker.Submit([i]() { return i * i; }));
+  }
+  auto all = circular::when_all(std::move(parts)).then([](std::vector<int> v) {
+    return std::accumulate(v.begin(), v.end(), 0);
+  });
+  REQUIRE(all.get() == 140);
+
+  std::vector<circular::Future<>> none{};
+  REQUIRE_NOTHROW(circular::when_all(std::move(none)).get());
+
+  std::vector<circular::Future<int>> mixed{};
+  mixed.push_back(tasker.Submit([]() { return 1; }));
+  mixed.push_back(tasker.Submit([]() -> int { throw std::out_of_range{"b"}; }));
+  REQUIRE_THROWS_AS(circular::when_all(std::move(mixed)).get(),
+                    std::out_of_range);
+
+  circular::Promise<int> never{};
+  auto neverFuture = never.get_future();
+  std::vector<circular::Future<int>> race{};
+  race.push_back(std::move(neverFuture));
+  race.push_back(tasker.Submit([]() { return 5; }));
+  auto [index, value] = circular::when_any(std::move(race)).get();
+  REQUIRE(index == 1);
+  REQUIRE(value == 5);
+
+  std::vector<circular::Future<int>> empty{};
+  REQUIRE_THROWS_AS(circular::when_any(std::move(empty)),
+                    std::invalid_argument);
+}
+
+TEST_CASE("Promise fulfils its Future, or breaks it", "[tasker]") {
+  circular::Promise<double> p{};
+  auto fu = p.get_future();
+  REQUIRE_THROWS_AS(p.get_future(), std::logic_error);
+  REQUIRE_FALSE(fu.ready());
+  p.set_value(1.5);
+  REQUIRE(fu.ready());
+  REQUIRE(fu.get() == 1.5);
+
+  circular::Future<> broken{};
+  {
+    circular::Promise<> q{};
+    broken = q.get_future();
+  }
+  REQUIRE_THROWS_AS(broken.get(), std::future_error);
+}
+
+TEST_CASE("Tasker streams steps through a pipeline in order", "[tasker]") {
+  auto &tasker = circular::Tasker::Get();
+  using circular::StageMode;
+
+  std::atomic<int> active{0}, maxActive{0};
+  std::vector<size_t> sourced{}, written{};
+  auto p = circular::Pipeline::Source([&](size_t step) {
+             sourced.push_back(step);
+             return static_cast<int>(step);
+           })
+               .Then(
+                   [&](int x) {
+                     auto now = ++active;
+                     auto prev = maxActive.load();
+                     while (prev < now &&
+                            !maxActive.compare_exchange_weak(prev, now)) {
+                     }
+                     std::this_thread::sleep_for(5ms);
+                     --active;
+                     return std::vector<int>{x, x * x};
+                   },
+                   StageMode::Parallel)
+               .Then([&](std::vector<int> v) {
+                 written.push_back(static_cast<size_t>(v[0]));
+               })
+               .Build();
+  REQUIRE(p.StageCount() == 3);
+
+  tasker.Run(p, 32, 4).get();
+  REQUIRE(sourced.size() == 32);
+  REQUIRE(written.size() == 32);
+  for (size_t i = 0; i < written.size(); ++i) {
+    REQUIRE(sourced[i] == i);
+    REQUIRE(written[i] == i);
+  }
+  REQUIRE(maxActive <= 4);
+  if (tasker.WorkerCount(circular::Lane::Frame) > 1) {
+    REQUIRE(maxActive > 1);
+  }
+
+  // a Pipeline can be run again
+  written.clear();
+  tasker.Run(p, 3, 1).get();
+  REQUIRE(written == std::vector<size_t>{0, 1, 2});
+  REQUIRE_NOTHROW(tasker.Run(p, 0, 1).get());
+  REQUIRE_THROWS_AS(tasker.Run(p, 1, 0), std::invalid_argument);
+}
+
+TEST_CASE("Tasker pipelines stop at the first failing stage", "[tasker]") {
+  auto &tasker = circular::Tasker::Get();
+
+  std::atomic<size_t> sunk{0};
+  auto p = circular::Pipeline::Source([](size_t step) {
+             if (step == 5) {
+               throw std::runtime_error{"bad step"};
+             }
+             return step;
+           })
+               .Then([&](size_t) { ++sunk; })
+               .Build();
+
+  REQUIRE_THROWS_AS(tasker.Run(p, 100, 3).get(), std::runtime_error);
+  REQUIRE(sunk <= 5);
+}
+
+TEST_CASE("Tasker instances are isolated and drain on shutdown", "[tasker]") {
+  REQUIRE(&circular::Tasker::Get() == &circular::Tasker::Get());
+  REQUIRE_THROWS_AS(circular::Tasker::Init({}), std::logic_error);
+
+  circular::TaskerOptions options{};
+  options.frameWorkers = 2;
+  options.backgroundWorkers = 1;
+  circular::Tasker io{options};
+  REQUIRE(io.WorkerCount(circular::Lane::Frame) == 2);
+  REQUIRE(io.WorkerCount(circular::Lane::Background) == 1);
+  REQUIRE(&io != &circular::Tasker::Get());
+
+  std::atomic<int> done{0};
+  for (int i = 0; i < 8; ++i) {
+    io.Submit(
+        [&]() {
+          std::this_thread::sleep_for(5ms);
+          ++done;
+        },
+        i % 2 ? circular::Lane::Frame : circular::Lane::Background);
+  }
+  io.Shutdown();
+  REQUIRE(done == 8);
+  REQUIRE(io.IsShutdown());
+  REQUIRE_THROWS_AS(io.Submit([]() {}), std::logic_error);
+  REQUIRE_NOTHROW(io.Shutdown());
+}
+
+TEST_CASE("Tasker shutdown drains work that running tasks submit",
+          "[tasker]") {
+  circular::Tasker io{{.frameWorkers = 1, .backgroundWorkers = 1}};
+
+  // a chain of tasks, each submitting the next to the other lane
+  std::atomic<int> hops{0};
+  std::function<void(int)> hop = [&](int left) {
+    ++hops;
+    if (left > 0) {
+      io.Submit([&hop, left]() { hop(left - 1); },
+                left % 2 ? circular::Lane::Frame : circular::Lane::Background);
+    }
+  };
+  io.Submit([&]() {
+    std::this_thread::sleep_for(5ms);
+    hop(10);
+  });
+  io.Shutdown();
+  REQUIRE(hops == 11);
+  REQUIRE_THROWS_AS(io.Submit([]() {}), std::logic_error);
+}
+
+TEST_CASE("Tasker shuts down after queued work of every kind is cancelled",
+          "[tasker]") {
+  circular::Tasker io{{.frameWorkers = 1, .backgroundWorkers = 1}};
+  auto &g = io.DefineGraph("cancelled_graph");
+  g.Flow().emplace([]() {});
+
+  // Impl: occupy both lanes' only workers, so that everything else queues
+  std::atomic<int> started{0};
+  std::atomic<bool> release{false};
+  auto block = [&]() {
+    ++started;
+    while (!release) {
+      std::this_thread::sleep_for(1ms);
+    }
+  };
+  auto frameBlocker = io.Submit(block);
+  auto backgroundBlocker = io.Submit(block, circular::Lane::Background);
+  while (started < 2) {
+    std::this_thread::sleep_for(1ms);
+  }
+
+  std::atomic<int> ran{0};
+  std::vector<circular::Future<>> queued{};
+  queued.push_back(io.Submit([&]() { ++ran; }));
+  queued.push_back(io.Submit([&]() { ++ran; }, circular::Lane::Background));
+  tf::Taskflow flow{};
+  flow.emplace([&]() { ++ran; });
+  queued.push_back(io.Submit(std::move(flow)));
+  queued.push_back(io.RunN("cancelled_graph", 3));
+  for (auto &q : queued) {
+    REQUIRE(q.cancel());
+  }
+  release = true;
+
+  io.Shutdown();
+  REQUIRE(ran == 0);
+  for (auto &q : queued) {
+    REQUIRE_THROWS_AS(q.get(), std::runtime_error);
+  }
+  for (auto lane : {circular::Lane::Frame, circular::Lane::Background}) {
+    auto stats = io.Stats(lane);
+    REQUIRE(stats.completed + stats.cancelled == stats.submitted);
+  }
+}
+
+TEST_CASE("Tasker continuations run on the Tasker which ran the work",
+          "[tasker][isolation]") {
+  // Impl: run alone (as ctest does) to check that the default Tasker is
+  // never created; with other tests, it may already exist
+  const bool hadDefault = circular::Tasker::HasDefault();
+  circular::Tasker io{{.frameWorkers = 1, .backgroundWorkers = 1}};
+  const auto id = []() { return std::this_thread::get_id(); };
+
+  const auto frame = io.Submit(id).get();
+  const auto background = io.Submit(id, circular::Lane::Background).get();
+  REQUIRE(frame != background);
+
+  REQUIRE(io.Submit([]() {}).then(id).then([](std::thread::id first) {
+            return first == std::this_thread::get_id();
+          }).get());
+  REQUIRE(io.Submit([]() {}).then(id).get() == frame);
+
+  std::vector<circular::Future<>> parts{};
+  for (int i = 0; i < 4; ++i) {
+    parts.push_back(io.Submit([]() {}, circular::Lane::Background));
+  }
+  REQUIRE(circular::when_all(std::move(parts)).then(id).get() == background);
+
+  std::vector<circular::Future<int>> race{};
+  race.push_back(io.Submit([]() { return 1; }));
+  REQUIRE(circular::when_any(std::move(race))
+              .then([](std::pair<size_t, int>) {
+                return std::this_thread::get_id();
+              })
+              .get() == frame);
+
+  if (!hadDefault) {
+    REQUIRE_FALSE(circular::Tasker::HasDefault());
+  }
+}
+
+TEST_CASE("Tasker pins workers to CPUs", "[tasker]") {
+  circular::TaskerOptions bad{};
+  bad.backgroundCpus = {-1};
+  REQUIRE_THROWS_AS(circular::Tasker{bad}, std::invalid_argument);
+
+#ifdef __linux__
+  // a CPU this process may not run on, if there is one
+  cpu_set_t mine;
+  CPU_ZERO(&mine);
+  sched_getaffinity(0, sizeof(mine), &mine);
+  for (int other = 0; other < CPU_SETSIZE; ++other) {
+    if (!CPU_ISSET(other, &mine)) {
+      bad.backgroundCpus = {other};
+      REQUIRE_THROWS_AS(circular::Tasker{bad}, std::invalid_argument);
+      break;
+    }
+  }
+#endif
+
+  // Impl: a CPU this process may run on, which need not be CPU 0
+  int cpu = 0;
+#ifdef __linux__
+  cpu_set_t allowed;
+  CPU_ZERO(&allowed);
+  pthread_getaffinity_np(pthread_self(), sizeof(allowed), &allowed);
+  while (!CPU_ISSET(cpu, &allowed)) {
+    ++cpu;
+  }
+#endif
+  circular::TaskerOptions options{};
+  options.frameWorkers = 1;
+  options.backgroundWorkers = 1;
+  options.backgroundCpus = {cpu};
+  circular::Tasker pinned{options};
+
+  auto cpus = pinned
+                  .Submit(
+                      [cpu]() {
+#ifdef __linux__
+                        cpu_set_t set;
+                        CPU_ZERO(&set);
+                        pthread_getaffinity_np(pthread_self(), sizeof(set),
+                                               &set);
+                        return CPU_COUNT(&set) == 1 && CPU_ISSET(cpu, &set);
+#else
+                        return true;
+#endif
+                      },
+                      circular::Lane::Background)
+                  .get();
+  REQUIRE(cpus);
+}
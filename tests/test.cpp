@@ -9,3 +9,19 @@ TEST_CASE("Quick check", "[main]") {
   REQUIRE(mean == 2.0);
   REQUIRE_THAT(var, Catch::Matchers::WithinAbs(0.666666, 1e-6));
 }
+
+TEST_CASE("accumulate_vector in float stays close to double", "[main]") {
+  // a large offset and many values, where a float sum would drift
+  std::vector<double> values{};
+  std::vector<float> values_f{};
+  for (int i = 0; i < 1000000; ++i) {
+    auto v = 1000.0 + 0.001 * (i % 1000);
+    values.push_back(v);
+    values_f.push_back(static_cast<float>(v));
+  }
+  auto [mean, var] = circular::accumulate_vector(values);
+  auto [mean_f, var_f] = circular::accumulate_vector(values_f);
+
+  REQUIRE_THAT(mean_f, Catch::Matchers::WithinRel(mean, 1e-6));
+  REQUIRE_THAT(var_f, Catch::Matchers::WithinRel(var, 1e-3));
+}
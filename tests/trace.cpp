@@ -0,0 +1,98 @@
+#include <catch2/catch_all.hpp>
+#include <circular/tasker.hpp>
+#include <circular/trace.hpp>
+
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+std::string slurp(const std::string &path) {
+  std::ifstream in{path};
+  std::stringstream ss;
+  ss << in.rdbuf();
+  return ss.str();
+}
+} // namespace
+
+TEST_CASE("Trace macros compile whether or not tracing is enabled",
+          "[trace]") {
+  {
+    CIRCULAR_TRACE_ZONE("test zone");
+    CIRCULAR_TRACE_COUNTER("test counter", 42.0);
+  }
+  CIRCULAR_TRACE_FRAME("test frame");
+
+  circular::trace::writeChromeTrace("trace_test.json");
+  auto json = slurp("trace_test.json");
+
+  REQUIRE(json.find("\"traceEvents\":[") != std::string::npos);
+  if (circular::trace::enabled()) {
+    REQUIRE(json.find("\"name\":\"test zone\",\"ph\":\"X\"") !=
+            std::string::npos);
+    REQUIRE(json.find("\"args\":{\"value\":42}") != std::string::npos);
+    REQUIRE(json.find("\"name\":\"test frame\",\"ph\":\"i\"") !=
+            std::string::npos);
+  } else {
+    REQUIRE(json.find("test zone") == std::string::npos);
+  }
+}
+
+TEST_CASE("Trace zones copy names which do not outlive them", "[trace]") {
+  const std::string prefix{"temporary "};
+  {
+    CIRCULAR_TRACE_ZONE(prefix + "zone");
+    // reuse the freed temporary's memory, if anything would
+    const std::string other(prefix.size() + 4, 'x');
+    static_cast<void>(other);
+  }
+  {
+    CIRCULAR_TRACE_ZONE(std::string(80, 'y'));
+  }
+  circular::trace::writeChromeTrace("trace_names.json");
+  auto json = slurp("trace_names.json");
+
+  if (circular::trace::enabled()) {
+    REQUIRE(json.find("\"name\":\"temporary zone\"") != std::string::npos);
+    REQUIRE(json.find("\"name\":\"" + std::string(54, 'y') + "\"") !=
+            std::string::npos);
+  }
+}
+
+TEST_CASE("Trace records Tasker tasks from worker threads", "[trace]") {
+  circular::Tasker::Get().Submit([]() {}).wait();
+  circular::trace::writeChromeTrace("trace_tasker.json");
+  auto json = slurp("trace_tasker.json");
+
+  if (circular::trace::enabled()) {
+    REQUIRE(json.find("\"name\":\"Tasker::Submit\"") != std::string::npos);
+  }
+  REQUIRE(circular::trace::droppedEvents() == 0);
+}
+
+TEST_CASE("Trace frees the rings of exited threads once drained", "[trace]") {
+  circular::trace::writeChromeTrace("trace_threads.json");
+  const auto before = circular::trace::threadBuffers();
+
+  std::vector<std::thread> threads{};
+  for (int i = 0; i < 8; ++i) {
+    threads.emplace_back([]() { CIRCULAR_TRACE_ZONE("short-lived"); });
+  }
+  for (auto &t : threads) {
+    t.join();
+  }
+  if (circular::trace::enabled()) {
+    REQUIRE(circular::trace::threadBuffers() == before + 8);
+  }
+
+  // their events are still written, and then their rings are gone
+  circular::trace::writeChromeTrace("trace_threads.json");
+  auto json = slurp("trace_threads.json");
+  if (circular::trace::enabled()) {
+    REQUIRE(json.find("\"name\":\"short-lived\"") != std::string::npos);
+  }
+  REQUIRE(circular::trace::threadBuffers() <= before);
+  REQUIRE(circular::trace::droppedEvents() == 0);
+}